@@ -3,6 +3,7 @@
 #include <unistdpp/pipe.h>
 
 #include <Device.h>
+#include <ImageCache.h>
 
 #include <algorithm>
 #include <csignal>
@@ -95,41 +96,26 @@ AppDescription::read(std::string_view path, std::string_view iconDir) {
   return std::optional(std::move(result));
 }
 
-std::optional<Canvas>
-AppDescription::getIcon() const {
-  struct CacheValue {
-    ImageCanvas image;
-    std::filesystem::file_time_type time;
-  };
-  static std::unordered_map<std::string, CacheValue> imageCache;
-
-  std::error_code ec;
-  auto time = std::filesystem::last_write_time(iconPath, ec);
-  if (ec) {
-    return std::nullopt;
-  }
-
-  auto it = imageCache.find(iconPath);
-  if (it != imageCache.end()) {
-    if (time == it->second.time) {
-      return it->second.image.canvas;
+std::shared_ptr<const Canvas>
+AppDescription::getIcon(Size size) const {
+  static auto imageCache = [] {
+    auto cacheDir = std::filesystem::path("/home/root/.cache");
+    if (const auto* xdgCache = getenv("XDG_CACHE_HOME");
+        xdgCache != nullptr && xdgCache[0] != 0) {
+      cacheDir = xdgCache;
+    } else if (const auto* home = getenv("HOME");
+               home != nullptr && home[0] != 0) {
+      cacheDir = std::filesystem::path(home) / ".cache";
     }
 
-    // Icon has been modified, remove from cache.
-    imageCache.erase(it);
-  }
+    // Icons are scaled and dithered once, and kept on disk across starts.
+    return ImageCache(cacheDir / "rocket" / "icons");
+  }();
 
-  std::cout << "Parsing image from: " << iconPath << std::endl;
-  auto iconImage = ImageCanvas::load(iconPath.c_str());
-  if (!iconImage.has_value()) {
-    return std::nullopt;
+  if (iconPath.empty()) {
+    return nullptr;
   }
-
-  auto canvas = iconImage->canvas;
-  std::cout << "With components: " << canvas.components() << std::endl;
-  imageCache.emplace_hint(
-    it, iconPath, CacheValue{ .image = std::move(*iconImage), .time = time });
-  return canvas;
+  return imageCache.get(iconPath, size);
 }
 
 std::vector<AppDescription>
@@ -6,10 +6,14 @@
 #include <unistdpp/pipe.h>
 
 #include <chrono>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+/// Width and height of the app icons in the launcher.
+constexpr int icon_size = 128;
+
 struct AppRunInfo {
   pid_t pid = -1;
   bool paused = false;
@@ -25,7 +29,9 @@ struct AppDescription {
   std::string icon;
 
   std::string iconPath;
-  std::optional<rmlib::Canvas> getIcon() const;
+  /// \returns The icon scaled to fit the size, or nullptr if there's none.
+  std::shared_ptr<const rmlib::Canvas> getIcon(
+    rmlib::Size size = { icon_size, icon_size }) const;
 
   static std::optional<AppDescription> read(std::string_view path,
                                             std::string_view iconDir);
@@ -55,7 +61,9 @@ public:
 
   const AppDescription& description() const { return mDescription; }
 
-  const std::optional<rmlib::Canvas>& icon() const { return iconCanvas; }
+  const std::shared_ptr<const rmlib::Canvas>& icon() const {
+    return iconCanvas;
+  }
   const std::optional<rmlib::MemoryCanvas>& savedFB() const { return savedFb; }
   void resetSavedFB() { savedFb.reset(); }
 
@@ -67,7 +75,7 @@ private:
 
   std::weak_ptr<AppRunInfo> runInfo;
 
-  std::optional<rmlib::Canvas> iconCanvas;
+  std::shared_ptr<const rmlib::Canvas> iconCanvas;
   std::optional<rmlib::MemoryCanvas> savedFb;
 
   // Indicates that the app should be removed when it exists
@@ -55,8 +55,10 @@ public:
     using namespace rmlib;
 
     const Canvas& canvas =
-      app.icon().has_value() ? *app.icon() : getMissingImage().canvas;
-    return container(GestureDetector(Column(Sized(Image(canvas), 128, 128),
+      app.icon() != nullptr ? *app.icon() : getMissingImage().canvas;
+    return container(GestureDetector(Column(Sized(Image(canvas),
+                                                  icon_size,
+                                                  icon_size),
                                             Text(app.description().name)),
                                      Gestures{}.onTap(onLaunch)),
                      Insets::all(2),
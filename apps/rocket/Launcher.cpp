@@ -119,8 +119,15 @@ LauncherState::init(rmlib::AppContext& context,
     key->grab();
   }
 
+  appContext = &context;
   fbCanvas = &context.getFbCanvas();
+  framebuffer = &context.getFramebuffer();
   inputManager = &context.getInputManager();
+  if (visible) {
+    showOverlay();
+  } else {
+    framebuffer->setOverlayVisible(false);
+  }
 
   readApps();
 
@@ -220,7 +227,11 @@ LauncherState::show() {
   }
 
   if (auto* current = getCurrentApp(); current != nullptr) {
-    current->pause(MemoryCanvas(*fbCanvas));
+    // The overlay leaves the app's screen untouched, so there's nothing to
+    // save.
+    current->pause(framebuffer->isOverlay()
+                     ? std::nullopt
+                     : std::optional(MemoryCanvas(*fbCanvas)));
     // pausing failed
     if (!current->isPaused()) {
       return;
@@ -229,6 +240,18 @@ LauncherState::show() {
 
   readApps();
   visible = true;
+  showOverlay();
+}
+
+void
+LauncherState::showOverlay() {
+  // The overlay still holds the launcher as it was last hidden, so it's only
+  // shown once the new frame is drawn into it.
+  appContext->afterFrame([this] {
+    if (visible) {
+      framebuffer->setOverlayVisible(true);
+    }
+  });
 }
 
 void
@@ -266,6 +289,7 @@ LauncherState::getCurrentApp() const {
 void
 LauncherState::switchApp(App& app) {
   visible = false;
+  framebuffer->setOverlayVisible(false);
   stopTimer();
 
   // Pause the current app.
@@ -4,6 +4,7 @@
 #include "AppWidgets.h"
 
 #include <UI.h>
+#include <UI/ListView.h>
 #include <UI/Rotate.h>
 
 class LauncherState;
@@ -19,6 +20,9 @@ class LauncherState : public rmlib::StateBase<LauncherWidget> {
   constexpr static auto default_inactivity_timeout = 20;
 
   constexpr static rmlib::Size splash_size = { 512, 512 };
+  constexpr static rmlib::Size app_cell_size = {
+    320, icon_size + 2 * rmlib::default_text_size
+  };
 
 public:
   void init(rmlib::AppContext& context, const rmlib::BuildContext& /*unused*/);
@@ -60,24 +64,29 @@ public:
   auto runningApps() const {
     using namespace rmlib;
 
-    std::vector<RunningAppWidget> widgets;
+    // Keyed, so starting or stopping an app moves the others.
+    std::vector<Keyed<RunningAppWidget>> widgets;
     for (const auto& app : apps) {
       if (app.isRunning()) {
         widgets.emplace_back(
-          app,
-          [this, &app] {
-            setState(
-              [&app](auto& self) { self.switchApp(*const_cast<App*>(&app)); });
-          },
-          [this, &app] {
-            setState([&app](auto& self) {
-              std::cout << "stopping " << app.description().name << std::endl;
-              const_cast<App*>(&app)->stop();
-              self.stopTimer();
-            });
-          },
-          app.description().path == currentAppPath,
-          invert(rotation));
+          app.description().path,
+          RunningAppWidget(
+            app,
+            [this, &app] {
+              setState([&app](auto& self) {
+                self.switchApp(*const_cast<App*>(&app));
+              });
+            },
+            [this, &app] {
+              setState([&app](auto& self) {
+                std::cout << "stopping " << app.description().name
+                          << std::endl;
+                const_cast<App*>(&app)->stop();
+                self.stopTimer();
+              });
+            },
+            app.description().path == currentAppPath,
+            invert(rotation)));
       }
     }
     return Wrap(widgets);
@@ -86,22 +95,33 @@ public:
   auto appList() const {
     using namespace rmlib;
 
-    std::vector<AppWidget> widgets;
+    std::vector<const App*> stopped;
     for (const auto& app : apps) {
       if (!app.isRunning()) {
-        widgets.emplace_back(app, [this, &app] {
-          setState(
-            [&app](auto& self) { self.switchApp(*const_cast<App*>(&app)); });
-        });
+        stopped.emplace_back(&app);
       }
     }
-    return Wrap(widgets);
+
+    // Only the page of apps on screen is built.
+    const auto count = int(stopped.size());
+    return GridView(
+      count,
+      [this, stopped = std::move(stopped)](int index) -> DynamicWidget {
+        const auto& app = *stopped[index];
+        return AppWidget(app, [this, &app] {
+          setState([&app](auto& self) {
+            self.switchApp(*const_cast<App*>(&app));
+          });
+        });
+      },
+      app_cell_size);
   }
 
   auto launcher(rmlib::AppContext& context) const {
     using namespace rmlib;
 
-    return Cleared(Column(header(context), runningApps(), appList()));
+    return Cleared(
+      Column(header(context), runningApps(), Expanded(appList())));
   }
 
   auto build(rmlib::AppContext& context,
@@ -110,11 +130,13 @@ public:
 
     const Canvas* background = nullptr;
     std::optional<Size> backgroundSize = {};
+    splash.reset();
     if (const auto* currentApp = getCurrentApp(); currentApp != nullptr) {
       if (const auto& savedFb = currentApp->savedFB(); savedFb.has_value()) {
         background = &savedFb->canvas;
-      } else if (const auto& icon = currentApp->icon(); icon.has_value()) {
-        background = &*icon;
+      } else if (splash = currentApp->description().getIcon(splash_size);
+                 splash != nullptr) {
+        background = splash.get();
         backgroundSize = splash_size;
       }
     }
@@ -157,6 +179,7 @@ private:
   void tick() const;
 
   void show();
+  void showOverlay();
   void hide(rmlib::AppContext* context);
   void toggle(rmlib::AppContext& context);
 
@@ -179,10 +202,15 @@ private:
 
   std::optional<rmlib::MemoryCanvas> backupBuffer;
 
+  /// The splash image shown by the last build, kept while it's displayed.
+  mutable std::shared_ptr<const rmlib::Canvas> splash;
+
   rmlib::TimerHandle sleepTimer;
   rmlib::TimerHandle inactivityTimer;
 
+  rmlib::AppContext* appContext = nullptr;
   const rmlib::Canvas* fbCanvas = nullptr;
+  const rmlib::fb::FrameBuffer* framebuffer = nullptr;
   rmlib::input::InputManager* inputManager = nullptr;
 
   rmlib::Rotation rotation = rmlib::Rotation::None;
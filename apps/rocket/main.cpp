@@ -8,6 +8,10 @@
 
 using namespace rmlib;
 
+namespace {
+constexpr auto rocket_overlay = 0;
+} // namespace
+
 int
 main(int argc, char* argv[]) {
   if (getenv("ROCKET_WAIT_FOR_INPUT") != nullptr) {
@@ -25,6 +29,9 @@ main(int argc, char* argv[]) {
   sd_notify(0, "READY=1");
 #endif
 
-  unistdpp::fatalOnError(runApp(LauncherWidget(), {}, /*clearOnExit=*/true));
+  unistdpp::fatalOnError(runApp(LauncherWidget(),
+                                {},
+                                /*clearOnExit=*/true,
+                                /*overlay=*/rocket_overlay));
   return EXIT_SUCCESS;
 }
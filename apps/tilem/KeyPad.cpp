@@ -2,6 +2,8 @@
 
 #include "scancodes.h"
 
+#include <GlyphCache.h>
+
 using namespace rmlib;
 using namespace rmlib::input;
 
@@ -130,14 +132,16 @@ KeypadRenderObject::drawKey(rmlib::Canvas& canvas,
   {
     const auto fontSize = std::min(
       frontLabelHeight, int(key_aspect * keyWidth / double(key.front.size())));
-    const auto fontSizes = Canvas::getTextSize(key.front, fontSize);
+    auto& glyphCache = GlyphCache::getInstance();
+    const auto textRun = glyphCache.measure(key.front, fontSize);
+    const auto fontSizes = textRun->size;
 
     const auto xOffset = (keyWidth - fontSizes.width) / 2;
     const auto yOffset =
       upperLabelHeight + ((frontLabelHeight - fontSizes.height) / 2);
     const auto position = pos + Point{ xOffset, yOffset };
 
-    canvas.drawText(key.front, position, fontSize);
+    canvas.drawGlyphs(glyphCache.layout(*textRun, fontSize), position);
   }
 
   // Draw alpha and 2nd label.
@@ -81,21 +81,22 @@ ScreenRenderObject::doDraw(Canvas& canvas) {
     float incX = float(lcd->width) / canvas.width();
     float incY = float(lcd->height) / canvas.height();
 
-    float subY = 0;
-    for (int y = 0; y < canvas.height(); y++) {
-      const uint8_t* lcdRow = &lcd->data[int(subY) * lcd->rowstride];
-      // auto* canvasPtr = canvasLinePtr;
-
-      float subX = 0;
-      for (int x = 0; x < canvas.width(); x++) {
-        const uint8_t data = lcdRow[int(subX)];
-        const uint16_t pixel = data != 0U ? black : white;
-        canvas.setPixel({ x, y }, pixel);
-
-        subX += incX;
-      }
-      subY += incY;
-    }
+    canvas.visitRotation<uint16_t>([&](auto view) {
+      float subY = 0;
+      view.forEachRow(view.rect(), [&](int /*y*/, uint16_t* canvasPtr) {
+        const uint8_t* lcdRow = &lcd->data[int(subY) * lcd->rowstride];
+
+        float subX = 0;
+        for (int x = 0; x < view.size().width; x++) {
+          const uint8_t data = lcdRow[int(subX)];
+          *canvasPtr = data != 0U ? black : white;
+          canvasPtr += view.xStep(); // NOLINT
+
+          subX += incX;
+        }
+        subY += incY;
+      });
+    });
   }
   std::swap(lcd, oldLcd);
 
@@ -4,6 +4,8 @@
 
 #include "yaft.h"
 
+#include <GlyphCache.h>
+
 using namespace rmlib;
 
 namespace {
@@ -214,7 +216,7 @@ KeyboardRenderObject::doDraw(rmlib::Canvas& canvas) {
   }
 
   if (!isPartialDraw()) {
-    result.waveform = fb::Waveform::GC16Fast;
+    result.setWaveform(fb::Waveform::GC16Fast);
   }
 
   return result;
@@ -553,19 +555,21 @@ KeyboardRenderObject::drawKey(rmlib::Point pos,
     return it->second;
   }();
 
-  const auto textSize = Canvas::getTextSize(printName, 32);
-  canvas.drawText(
-    printName,
+  auto& glyphCache = GlyphCache::getInstance();
+
+  const auto textRun = glyphCache.measure(printName, 32);
+  const auto textSize = textRun->size;
+  canvas.drawGlyphs(
+    glyphCache.layout(*textRun, 32),
     { keyRect.topLeft.x + (keyWidth / 2) - (textSize.width / 2),
-      keyRect.topLeft.y + (keyHeight / 2) - (textSize.height / 2) },
-    32);
+      keyRect.topLeft.y + (keyHeight / 2) - (textSize.height / 2) });
 
   if (!key.altName.empty()) {
-    const auto altTextSize = Canvas::getTextSize(key.altName, 26);
-    canvas.drawText(key.altName,
-                    { keyRect.topLeft.x + keyWidth - altTextSize.width - 4,
-                      keyRect.topLeft.y + 3 },
-                    26);
+    const auto altTextRun = glyphCache.measure(key.altName, 26);
+    canvas.drawGlyphs(
+      glyphCache.layout(*altTextRun, 26),
+      { keyRect.topLeft.x + keyWidth - altTextRun->size.width - 4,
+        keyRect.topLeft.y + 3 });
   }
 
   if (state.isDown()) {
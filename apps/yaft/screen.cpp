@@ -206,45 +206,53 @@ ScreenRenderObject::drawLine(rmlib::Canvas& canvas,
       }
     }
 
-    for (int h = 0; h < CELL_HEIGHT; h++) {
-      /* if UNDERLINE attribute on, swap bg/fg */
-      if ((h == (CELL_HEIGHT - 1)) &&
-          ((cell.attribute & attr_mask[ATTR_UNDERLINE]) != 0)) {
-        std::swap(bgGray, fgGray);
-      }
-
-      for (int w = 0; w < CELL_WIDTH; w++) {
-        const auto pos = isLandscape ? Point{ zStart - h, marginLeft + w }
-                                     : Point{ marginLeft + w, zStart + h };
-
-        /* set fg or bg */
-        const auto* glyph = (cell.attribute & ATTR_BOLD) != 0
-                              ? cell.glyph.boldp
-                              : cell.glyph.regularp;
-
-        const auto grayMode =
-          (glyph->bitmap[h] & (0x01 << (bdfPadding + CELL_WIDTH - 1 - w))) != 0U
-            ? fgGray
-            : bgGray;
-
-        int pixel = 0;
-        switch (grayMode) {
-          case White:
-            pixel = 0; // 0xFFFF;
-            break;
-          case Dither:
-            pixel = (h % 2) == (w % 2) ? 0x0 : 0xFFFF;
-            break;
-          case Black:
-            pixel = 0xFFFF; // 0;
-            break;
+    canvas.visitRotation<uint16_t>([&](auto view) {
+      // Next pixel of the glyph row.
+      const auto step = isLandscape ? view.yStep() : view.xStep();
+
+      for (int h = 0; h < CELL_HEIGHT; h++) {
+        /* if UNDERLINE attribute on, swap bg/fg */
+        if ((h == (CELL_HEIGHT - 1)) &&
+            ((cell.attribute & attr_mask[ATTR_UNDERLINE]) != 0)) {
+          std::swap(bgGray, fgGray);
         }
 
-        // We only care about rgb555, as we assume that format above.
-        // So do a direct assign instead of memcpy.
-        canvas.setPixel(pos, pixel);
+        const auto pos = isLandscape ? Point{ zStart - h, marginLeft }
+                                     : Point{ marginLeft, zStart + h };
+        assert(view.rect().contains(pos));
+        auto* dst = view.getPtr(pos.x, pos.y);
+
+        for (int w = 0; w < CELL_WIDTH; w++) {
+          /* set fg or bg */
+          const auto* glyph = (cell.attribute & ATTR_BOLD) != 0
+                                ? cell.glyph.boldp
+                                : cell.glyph.regularp;
+
+          const auto grayMode =
+            (glyph->bitmap[h] & (0x01 << (bdfPadding + CELL_WIDTH - 1 - w))) !=
+                0U
+              ? fgGray
+              : bgGray;
+
+          uint16_t pixel = 0;
+          switch (grayMode) {
+            case White:
+              pixel = 0; // 0xFFFF;
+              break;
+            case Dither:
+              pixel = (h % 2) == (w % 2) ? 0x0 : 0xFFFF;
+              break;
+            case Black:
+              pixel = 0xFFFF; // 0;
+              break;
+          }
+
+          // We only care about rgb555, as we assume that format above.
+          *dst = pixel;
+          dst += step; // NOLINT
+        }
       }
-    }
+    });
   }
 
   term.line_dirty[line] =
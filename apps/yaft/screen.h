@@ -27,6 +27,9 @@ public:
   ScreenRenderObject(const Screen& screen)
     : rmlib::LeafRenderObject<Screen>(screen) {
     markNeedsRebuild();
+
+    // One mouse move report a frame is plenty for the terminal.
+    setMovePolicy(rmlib::MovePolicy::Coalesce);
   }
 
   void update(const Screen& newWidget);
@@ -1,16 +1,19 @@
 #include "Canvas.h"
+#include "GlyphCache.h"
 
 #include "stb_image.h"
 #include "stb_image_write.h"
-#include "stb_truetype.h"
-
-#include <utf8.h>
 
+#include <array>
 #include <climits>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
+#include <sys/mman.h>
+
 #include <thick.h>
+#include <unistdpp/file.h>
 
 namespace rmlib {
 
@@ -19,87 +22,28 @@ constexpr auto uint8_max = std::numeric_limits<std::uint8_t>::max();
 
 constexpr uint8_t
 blend(uint8_t factor, uint8_t fg, uint8_t bg) {
-  int val = bg + (int(factor) * (int(fg) - int(bg))) / uint8_max;
-  return uint8_t(val);
+  // bg + factor * (fg - bg) / 255, rounding towards zero.
+  if (fg < bg) {
+    return bg - simd::div255(int(factor) * (bg - fg));
+  }
+  return bg + simd::div255(int(factor) * (fg - bg));
 }
 
-#ifdef BUILTIN_FONT
-#include "noto-sans-mono.h"
-#else
-constexpr auto font_path = "/usr/share/fonts/ttf/noto/NotoMono-Regular.ttf";
-#endif
-
-const stbtt_fontinfo*
-getFont() {
-  static const auto* font = [] {
-    static stbtt_fontinfo font;
-#ifndef BUILTIN_FONT
-    // TODO: unistdpp
-    constexpr auto large_number = 24 << 20;
-    static std::array<uint8_t, large_number> fontBuffer = { 0 };
-    auto* fp = fopen(font_path, "r"); // NOLINT
-    if (fp == nullptr) {
-      std::cerr << "Error opening font\n";
-    }
-    auto len = fread(fontBuffer.data(), 1, fontBuffer.size(), fp);
-    if (len == static_cast<decltype(len)>(-1)) {
-      std::cerr << "Error reading font\n";
-    }
-    const auto* data = fontBuffer.data();
-#else
-    const auto* data = NotoSansMono_Regular_ttf;
-#endif
-
-    if (stbtt_InitFont(&font, data, 0) == 0) {
-      std::cerr << "Error initializing font!\n";
-      std::exit(EXIT_FAILURE);
-    }
-
-#ifndef BUILTIN_FONT
-    fclose(fp); // NOLINT
-#endif
-    return &font;
-  }();
+/// Header of the raw image files, followed by the unpadded pixel lines.
+struct RawHeader {
+  std::array<char, 4> magic;
+  int32_t width;
+  int32_t height;
+  int32_t components;
+};
 
-  return font;
-}
+constexpr std::array<char, 4> raw_magic = { 'R', 'M', 'I', '1' };
+constexpr int32_t max_components = 4;
 } // namespace
 
 Size
 Canvas::getTextSize(std::string_view text, int size) {
-  const auto* font = getFont();
-  auto scale = stbtt_ScaleForPixelHeight(font, float(size));
-
-  int ascent = 0;
-  int descent = 0;
-  int lineGap = 0;
-  stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
-
-  // Divide the line gap to above and below.
-  float charStart = float(lineGap) * scale / 2;
-
-  float baseLine = charStart + float(ascent) * scale;
-  float charEnd = baseLine - float(descent) * scale; // descent is negative.
-  float height = charEnd + charStart;
-
-  auto utf32 = utf8::utf8to32(utf8::replace_invalid(text));
-
-  float xpos = 0;
-  for (size_t ch = 0; ch != utf32.size(); ch++) {
-    int advance = 0;
-    int lsb = 0;
-
-    int codepoint = static_cast<int>(utf32[ch]);
-    stbtt_GetCodepointHMetrics(font, codepoint, &advance, &lsb);
-
-    xpos += float(advance) * scale;
-    if (ch + 1 != utf32.size()) {
-      xpos += scale * float(stbtt_GetCodepointKernAdvance(
-                        font, codepoint, static_cast<int>(utf32[ch + 1])));
-    }
-  }
-
-  return { static_cast<int>(ceilf(xpos)), static_cast<int>(ceilf(height)) };
+  return GlyphCache::getInstance().measure(text, size)->size;
 }
 
 void
@@ -108,96 +52,59 @@ Canvas::drawText(std::string_view text,
                  int size,
                  int fg,
                  int bg,
-                 std::optional<Rect> optClipRect) { // NOLINT
-  const auto clipRect = optClipRect.has_value() ? *optClipRect : rect();
-
-  const auto* font = getFont();
-  auto scale = stbtt_ScaleForPixelHeight(font, float(size));
-
-  int ascent = 0;
-  int descent = 0;
-  int lineGap = 0;
-  stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
-
-  // Divide the line gap to above and below.
-  float charStart = float(lineGap) * scale / 2;
-  float baseLine = charStart + float(ascent) * scale;
-  float yShfit = 0; // baseLine - floorf(baseLine);
-
-  auto utf32 = utf8::utf8to32(utf8::replace_invalid(text));
-
-  std::vector<uint8_t> textBuffer;
-
-  float xpos = 0;
-  for (size_t ch = 0; ch != utf32.size(); ch++) {
-    float xShift = xpos - floorf(xpos);
+                 std::optional<Rect> clipRect) {
+  drawGlyphs(
+    GlyphCache::getInstance().layout(text, size), location, fg, bg, clipRect);
+}
 
-    int advance = 0;
-    int lsb = 0;
-    int codepoint = static_cast<int>(utf32[ch]);
-    stbtt_GetCodepointHMetrics(font, codepoint, &advance, &lsb);
+void
+Canvas::drawGlyphs(const GlyphRun& run,
+                   Point location,
+                   int fg,
+                   int bg,
+                   std::optional<Rect> optClipRect) {
+  const auto clipRect = optClipRect.has_value() ? *optClipRect : rect();
 
-    int x0 = 0;
-    int x1 = 0;
-    int y0 = 0;
-    int y1 = 0;
-    stbtt_GetCodepointBitmapBox(
-      font, codepoint, scale, scale, &x0, &y0, &x1, &y1);
+  const auto fgGrey = uint8_t(fg & uint8_max);
+  const auto bgGrey = uint8_t(bg & uint8_max);
 
-    int w = x1 - x0 + 1;
-    int h = y1 - y0 + 1;
-    int size = w * h;
-    if (static_cast<unsigned>(size) > textBuffer.size()) {
-      textBuffer.resize(size);
-    }
+  // The color for each coverage value, for rotated canvases.
+  std::array<uint16_t, uint8_max + 1> colors{};
+  for (int t = 0; t <= uint8_max; t++) {
+    colors[t] = greyToRGB565(blend(t, fgGrey, bgGrey));
+  }
 
-    stbtt_MakeCodepointBitmapSubpixel(font,
-                                      textBuffer.data(),
-                                      /*  width */ w,
-                                      /* height */ h,
-                                      /* stride */ w,
-                                      /* xscale */ scale,
-                                      /* yscale */ scale,
-                                      xShift,
-                                      yShfit,
-                                      codepoint);
-
-    const auto fg8 = fg & 0xff;
-    const auto bg8 = bg & 0xff;
-
-    // Draw the bitmap to canvas.
-    for (int y = 0; y < h; y++) {
-      for (int x = 0; x < w; x++) {
-        auto t = textBuffer[y * w + x];
-        // int pixel = bg8 + (t * (fg8 - bg8)) / 0xff;
-        auto pixel = blend(t, fg8, bg8);
-        // auto pixel = (0xff - textBuffer[y * w + x]);
-        uint16_t pixel565 = greyToRGB565(pixel);
-        // (pixel >> 3) | ((pixel >> 2) << 5) | ((pixel >> 3) << 11);
-
-        auto memY = location.y + static_cast<int>(baseLine) + y0 + y /*- 1*/;
-        auto memX = location.x + static_cast<int>(xpos) + x0 + x;
-        if (memX < clipRect.topLeft.x || clipRect.bottomRight.x < memX ||
-            memY < clipRect.topLeft.y || clipRect.bottomRight.y < memY) {
-          continue;
+  visitRotation<uint16_t>([&](auto view) {
+    // Each glyph overwrites its whole bitmap, so where character boxes
+    // overlap (e.g. 'lj') the last one wins.
+    for (const auto& [glyph, position] : run.glyphs) {
+      const auto origin = location + position;
+
+      const auto x1 = std::max(origin.x, clipRect.topLeft.x);
+      const auto y1 = std::max(origin.y, clipRect.topLeft.y);
+      const auto x2 =
+        std::min(origin.x + glyph->width - 1, clipRect.bottomRight.x);
+      const auto y2 =
+        std::min(origin.y + glyph->height - 1, clipRect.bottomRight.y);
+
+      for (int y = y1; y <= y2; y++) {
+        const auto* src =
+          &glyph->coverage[(y - origin.y) * glyph->width + (x1 - origin.x)];
+        auto* dst = view.getPtr(x1, y);
+
+        if constexpr (decltype(view)::rotation == Rotation::None) {
+          if (x2 >= x1) {
+            simd::blendCoverage(dst, src, x2 - x1 + 1, fgGrey, bgGrey);
+          }
+        } else {
+          for (int x = x1; x <= x2; x++) {
+            *dst = colors[*src++]; // NOLINT
+            dst += view.xStep();   // NOLINT
+          }
         }
-
-        auto* targetPtr = getPtr<uint16_t>(memX, memY);
-        *targetPtr = pixel565;
       }
     }
-
-    // note that this stomps the old data, so where character boxes overlap
-    // (e.g. 'lj') it's wrong because this API is really for baking character
-    // bitmaps into textures. if you want to render a sequence of characters,
-    // you really need to render each bitmap to a temp font_buffer, then "alpha
-    // blend" that into the working font_buffer
-    xpos += float(advance) * scale;
-    if (ch + 1 != utf32.size()) {
-      xpos += scale * float(stbtt_GetCodepointKernAdvance(
-                        font, codepoint, static_cast<int>(utf32[ch + 1])));
-    }
-  }
+  });
 }
 
 void
@@ -215,33 +122,54 @@ Canvas::drawLine(Point start, Point end, int val, int thickness) {
 
   int err = (dx > dy ? dx : -dy) / 2;
 
-  for (;;) {
-    setPixel(start, val);
-    if (start == end) {
-      break;
-    }
+  visit([&](auto view) {
+    const auto pixel = static_cast<typename decltype(view)::Pixel>(val);
+    for (;;) {
+      view.setPixel(start, pixel);
+      if (start == end) {
+        break;
+      }
 
-    int e2 = err;
-    if (e2 > -dx) {
-      err -= dy;
-      start.x += sx;
-    }
-    if (e2 < dy) {
-      err += dx;
-      start.y += sy;
+      int e2 = err;
+      if (e2 > -dx) {
+        err -= dy;
+        start.x += sx;
+      }
+      if (e2 < dy) {
+        err += dx;
+        start.y += sy;
+      }
     }
-  }
+  });
 }
 
 void
 Canvas::drawDisk(Point center, int radius, int val) {
-  for (int dy = -radius; dy < radius; dy++) {
-    for (int dx = -radius; dx < radius; dx++) {
-      if (dx * dx + dy * dy < radius * radius) {
-        setPixel(center + Point{ dx, dy }, val);
+  visit([&](auto view) {
+    const auto pixel = static_cast<typename decltype(view)::Pixel>(val);
+    const auto bounds = view.rect();
+
+    // Fill a span per row, the pixels with `dx * dx + dy * dy < r * r`. So
+    // `|dx| < end`, with `end` the smallest integer with `end * end >= limit`.
+    auto end = 0;
+    for (int dy = -radius; dy < radius; dy++) {
+      const auto limit = radius * radius - dy * dy;
+      while (end * end < limit) {
+        end++;
+      }
+      while (end > 0 && (end - 1) * (end - 1) >= limit) {
+        end--;
+      }
+
+      const auto y = center.y + dy;
+      const auto x1 = std::max(bounds.topLeft.x, center.x - end + 1);
+      const auto x2 = std::min(bounds.bottomRight.x, center.x + end - 1);
+      if (y < bounds.topLeft.y || y > bounds.bottomRight.y || x1 > x2) {
+        continue;
       }
+      view.set(Rect{ { x1, y }, { x2, y } }, pixel);
     }
-  }
+  });
 }
 
 constexpr uint16_t
@@ -268,7 +196,9 @@ ImageCanvas::loadRaw(const char* path) {
 }
 
 std::optional<ImageCanvas>
-ImageCanvas::load(const char* path, int background) {
+ImageCanvas::load(const char* path,
+                  int background,
+                  std::optional<DitherOptions> ditherOptions) {
   auto result = loadRaw(path);
   if (!result.has_value()) {
     return {};
@@ -277,11 +207,17 @@ ImageCanvas::load(const char* path, int background) {
   result->canvas.transform([background](auto x, auto y, uint16_t pixel) {
     return greyAlphaToRGB565(background, pixel);
   });
+  if (ditherOptions.has_value()) {
+    dither(result->canvas, *ditherOptions);
+  }
   return result;
 }
 
 std::optional<ImageCanvas>
-ImageCanvas::load(uint8_t* data, int size, int background) {
+ImageCanvas::load(uint8_t* data,
+                  int size,
+                  int background,
+                  std::optional<DitherOptions> ditherOptions) {
   int width = 0;
   int height = 0;
   int imgComponents = 0;
@@ -295,12 +231,61 @@ ImageCanvas::load(uint8_t* data, int size, int background) {
   result.transform([background](auto x, auto y, uint16_t pixel) {
     return greyAlphaToRGB565(background, pixel);
   });
+  if (ditherOptions.has_value()) {
+    dither(result, *ditherOptions);
+  }
   return ImageCanvas{ result };
 }
 
+std::optional<ImageCanvas>
+ImageCanvas::mapRaw(const char* path) {
+  auto fd = unistdpp::open(path, O_RDONLY);
+  if (!fd.has_value()) {
+    return std::nullopt;
+  }
+
+  const auto size = unistdpp::lseek(*fd, 0, SEEK_END);
+  if (!size.has_value() || *size < off_t(sizeof(RawHeader))) {
+    return std::nullopt;
+  }
+
+  // Private, so drawing on the image doesn't modify the file.
+  auto mapping = unistdpp::mmap(
+    nullptr, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, *fd, 0);
+  if (!mapping.has_value()) {
+    return std::nullopt;
+  }
+
+  auto* memory = static_cast<uint8_t*>(mapping->get());
+  RawHeader header{};
+  memcpy(&header, memory, sizeof(RawHeader));
+  if (header.magic != raw_magic || header.width <= 0 || header.height <= 0 ||
+      header.components <= 0 || header.components > max_components) {
+    return std::nullopt;
+  }
+
+  // In 64 bits, so a corrupt header can't overflow the size on 32 bit
+  // targets. The canvas indexes its pixels with ints.
+  const auto pixelSize =
+    uint64_t(header.width) * uint64_t(header.height) * header.components;
+  if (pixelSize > uint64_t(INT_MAX) ||
+      sizeof(RawHeader) + pixelSize > uint64_t(*size)) {
+    return std::nullopt;
+  }
+
+  ImageCanvas result(Canvas(memory + sizeof(RawHeader),
+                            header.width,
+                            header.height,
+                            header.components));
+  result.mapping = std::move(*mapping);
+  return result;
+}
+
 void
 ImageCanvas::release() {
-  if (canvas.memory() != nullptr) {
+  if (mapping != nullptr) {
+    mapping.reset();
+  } else if (canvas.memory() != nullptr) {
     stbi_image_free(canvas.memory());
   }
   canvas = Canvas{};
@@ -312,7 +297,10 @@ MemoryCanvas::MemoryCanvas(const Canvas& other, Rect rect) {
                                        other.components());
   canvas =
     Canvas(memory.get(), rect.width(), rect.height(), other.components());
-  canvas.copy(other);
+
+  // The snapshot is unrotated, copy handles a rotated source.
+  auto src = other;
+  canvas.copy(src.subCanvas(rect));
 }
 
 MemoryCanvas::MemoryCanvas(int width, int height, int components) {
@@ -340,4 +328,26 @@ Canvas::writeImage(const char* path) const {
   return {};
 }
 
+OptError<>
+Canvas::writeRaw(const char* path) const {
+  if (mRotation != Rotation::None) {
+    return MemoryCanvas(*this).canvas.writeRaw(path);
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  const auto header =
+    RawHeader{ raw_magic, mSize.width, mSize.height, mComponents };
+  file.write(reinterpret_cast<const char*>(&header), // NOLINT
+             sizeof(RawHeader));
+  for (int y = 0; y < mSize.height; y++) {
+    file.write(reinterpret_cast<const char*>(getLine(y)), // NOLINT
+               std::streamsize(mSize.width) * mComponents);
+  }
+
+  if (!file.good()) {
+    return Error::make("Error writing raw image");
+  }
+  return {};
+}
+
 } // namespace rmlib
@@ -0,0 +1,111 @@
+#include "Dither.h"
+
+#include "Canvas.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace rmlib {
+
+namespace {
+
+constexpr int bayer_size = 8;
+
+// clang-format off
+constexpr std::array<std::array<uint8_t, bayer_size>, bayer_size> bayer = {{
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 },
+}};
+// clang-format on
+
+/// The rounding bias for each pixel of a row, see \ref simd::quantize.
+std::array<uint16_t, bayer_size>
+getBias(DitherMode mode, int y, int levels) {
+  // RGB565 keeps 6 bits of grey, so a quantised pixel can read up to 3 below
+  // its level. Keep the thresholds above that, so quantising again doesn't
+  // change the image.
+  const int minBias = 3 * (levels - 1);
+
+  std::array<uint16_t, bayer_size> result{};
+  for (int x = 0; x < bayer_size; x++) {
+    if (mode == DitherMode::Ordered) {
+      // Spread the thresholds evenly between two levels.
+      constexpr auto cells = bayer_size * bayer_size;
+      const auto cell = (2 * bayer[y % bayer_size][x]) + 1;
+      result[x] = minBias + (cell * (255 - minBias) / (2 * cells));
+    } else {
+      result[x] = 255 / 2;
+    }
+  }
+  return result;
+}
+
+/// Floyd-Steinberg, the error of each pixel is spread to the unvisited
+/// neighbours.
+void
+diffuse(uint16_t* pixels, std::ptrdiff_t stride, Size size, int levels) {
+  const int maxLevel = levels - 1;
+  const int step = 255 / maxLevel;
+
+  // The error for the current and next line, with a pixel of padding on
+  // both sides.
+  std::vector<int> errors(size.width + 2);
+  std::vector<int> nextErrors(size.width + 2);
+
+  for (int y = 0; y < size.height; y++) {
+    auto* line = pixels + (y * stride); // NOLINT
+    std::fill(nextErrors.begin(), nextErrors.end(), 0);
+
+    for (int x = 0; x < size.width; x++) {
+      const int value = greyFromRGB565(line[x]) + (errors[x + 1] / 16);
+      const int level =
+        std::clamp(((value * maxLevel) + (255 / 2)) / 255, 0, maxLevel);
+      line[x] = greyToRGB565(level * step);
+
+      // The error to what's stored, so quantised images don't change.
+      const int error = value - greyFromRGB565(line[x]);
+      errors[x + 2] += error * 7;
+      nextErrors[x] += error * 3;
+      nextErrors[x + 1] += error * 5;
+      nextErrors[x + 2] += error;
+    }
+
+    std::swap(errors, nextErrors);
+  }
+}
+
+} // namespace
+
+void
+dither(Canvas& canvas, const DitherOptions& options) {
+  assert(canvas.components() == 2);
+  assert(options.bits == 1 || options.bits == 2 || options.bits == 4);
+  const int levels = 1 << options.bits;
+
+  // The pattern doesn't depend on the rotation, so work on the memory lines.
+  canvas.visitRotation<uint16_t>([&](auto view) {
+    const auto memSize = rotate(decltype(view)::rotation, view.size());
+
+    if (options.mode == DitherMode::ErrorDiffusion) {
+      diffuse(view.data(), view.stride(), memSize, levels);
+      return;
+    }
+
+    for (int y = 0; y < memSize.height; y++) {
+      const auto bias = getBias(options.mode, y, levels);
+      simd::quantize(view.data() + (y * view.stride()), // NOLINT
+                     memSize.width,
+                     bias.data(),
+                     levels);
+    }
+  });
+}
+
+} // namespace rmlib
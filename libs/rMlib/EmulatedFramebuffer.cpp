@@ -279,6 +279,11 @@ FrameBuffer::open(std::optional<Size> requestedSize) {
   return FrameBuffer(FrameBuffer::rM2Stuff, unistdpp::FD(emulated_fd), canvas);
 }
 
+ErrorOr<FrameBuffer>
+FrameBuffer::openOverlay(int id, int z) {
+  return Error::make("Overlays aren't supported when emulating");
+}
+
 void
 FrameBuffer::close() {
   if (fd.fd == emulated_fd) {
@@ -298,4 +303,9 @@ FrameBuffer::doUpdate(Rect region, Waveform waveform, UpdateFlags flags) const {
   updateEmulatedCanvas(canvas, region);
 }
 
+void
+FrameBuffer::setOverlayVisible(bool visible,
+                               Waveform waveform,
+                               UpdateFlags flags) const {}
+
 } // namespace rmlib::fb
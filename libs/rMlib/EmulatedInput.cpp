@@ -39,7 +39,10 @@ struct FakeInputDevice : public InputDeviceBase {
   }
 
   void flood() final {}
-  OptError<> readEvents(std::vector<Event>& out) final { return {}; }
+  OptError<> readEvents(EventRing& out) final { return {}; }
+  void decode(const input_event* events,
+              size_t count,
+              EventRing& out) final {}
 };
 } // namespace
 
@@ -54,6 +57,36 @@ InputManager::UdevDeleter<udev_monitor>::operator()(udev_monitor* ptr) {}
 void
 InputDeviceBase::EvDevDeleter::operator()(libevdev* evdev) {}
 
+/// SDL events have to be read on the main thread.
+struct InputManager::Thread {};
+
+InputManager::InputManager() = default;
+InputManager::~InputManager() = default;
+InputManager::InputManager(InputManager&& other) noexcept = default;
+InputManager&
+InputManager::operator=(InputManager&& other) noexcept = default;
+
+OptError<>
+InputManager::startThread() {
+  return Error::make("No input thread in the emulator");
+}
+
+void
+InputManager::stopThread() {}
+
+std::unique_lock<std::mutex>
+InputManager::lockDevices() {
+  return {};
+}
+
+void
+InputManager::markDevicesChanged() {
+  devicesChanged = true;
+}
+
+void
+InputManager::takeEvents(EventRing& out) {}
+
 ErrorOr<BaseDevices>
 InputManager::openAll(bool monitor) {
   if (SDL_Init(SDL_INIT_EVENTS) < 0) {
@@ -72,8 +105,24 @@ InputManager::openAll(bool monitor) {
   return baseDevices;
 }
 
-ErrorOr<std::vector<Event>> // NOLINTNEXTLINE
-InputManager::waitForInput(std::vector<pollfd>& extraFds,
+OptError<>
+InputManager::startRecording(std::string /*dir*/) {
+  return Error::make("No input recording in the emulator");
+}
+
+ErrorOr<BaseDevices>
+InputManager::openReplay(std::string_view /*dir*/, ReplaySpeed /*speed*/) {
+  return Error::make("No input replay in the emulator");
+}
+
+bool
+InputManager::isReplaying() {
+  return false;
+}
+
+OptError<> // NOLINTNEXTLINE
+InputManager::waitForInput(EventRing& out,
+                           std::vector<pollfd>& extraFds,
                            std::optional<std::chrono::milliseconds> timeout) {
   static bool down = false;
 
@@ -135,8 +184,9 @@ InputManager::waitForInput(std::vector<pollfd>& extraFds,
   PenEvent ev;
   ev.id = 1;
   ev.pressure = 1;
+  ev.time = EventClock::now();
+  keyEv.time = ev.time;
 
-  std::vector<Event> result;
   switch (event.type) {
     case SDL_QUIT:
       std::exit(0);
@@ -149,7 +199,7 @@ InputManager::waitForInput(std::vector<pollfd>& extraFds,
         auto y = event.motion.y * EMULATE_SCALE;
         ev.type = PenEvent::Move;
         ev.location = { x, y };
-        result.emplace_back(ev);
+        out.push(ev);
       }
       break;
     case SDL_MOUSEBUTTONDOWN:
@@ -159,7 +209,7 @@ InputManager::waitForInput(std::vector<pollfd>& extraFds,
         down = true;
         ev.type = PenEvent::TouchDown;
         ev.location = { x, y };
-        result.emplace_back(ev);
+        out.push(ev);
       }
       break;
     case SDL_MOUSEBUTTONUP:
@@ -169,21 +219,21 @@ InputManager::waitForInput(std::vector<pollfd>& extraFds,
         down = false;
         ev.type = PenEvent::TouchUp;
         ev.location = { x, y };
-        result.emplace_back(ev);
+        out.push(ev);
       }
       break;
 
     case SDL_KEYDOWN:
       keyEv.keyCode = event.key.keysym.scancode;
       keyEv.type = KeyEvent::Press;
-      result.emplace_back(keyEv);
+      out.push(keyEv);
       break;
     case SDL_KEYUP:
       keyEv.keyCode = event.key.keysym.scancode;
       keyEv.type = KeyEvent::Release;
-      result.emplace_back(keyEv);
+      out.push(keyEv);
       break;
   }
-  return result;
+  return {};
 }
 } // namespace rmlib::input
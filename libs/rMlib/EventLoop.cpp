@@ -0,0 +1,342 @@
+#include "EventLoop.h"
+
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+
+#include <unistdpp/file.h>
+#include <unistdpp/pipe.h>
+
+#ifdef __linux__
+#include <unistdpp/epoll.h>
+#endif
+
+namespace rmlib {
+
+namespace {
+int signalPipeFd = -1; // NOLINT
+
+/// Signals aren't blocked, as the mask would be inherited by child
+/// processes, even across exec. So the handler can run on any thread, and
+/// only writes the signal to the pipe read by the loop.
+void
+writeSignal(int signal) {
+  const auto byte = char(signal);
+  (void)::write(signalPipeFd, &byte, 1);
+}
+
+#ifdef __linux__
+// Tags for the fds of the loop itself in the epoll data.
+char timer_tag;
+char signal_tag;
+
+timespec
+toTimespec(Timer::Clock::time_point time) {
+  using namespace std::chrono;
+  const auto ns = duration_cast<nanoseconds>(time.time_since_epoch()).count();
+  constexpr auto ns_per_sec = 1000000000;
+  return timespec{ .tv_sec = time_t(ns / ns_per_sec),
+                   .tv_nsec = long(ns % ns_per_sec) };
+}
+#endif
+} // namespace
+
+struct EventLoop::Signals {
+  struct Handler {
+    Callback callback;
+    void (*previous)(int) = SIG_DFL;
+  };
+
+  std::unordered_map<int, Handler> handlers;
+  unistdpp::Pipe pipe;
+
+  Signals() = default;
+
+  ~Signals() {
+    for (const auto& [signal, handler] : handlers) {
+      std::signal(signal, handler.previous);
+    }
+    signalPipeFd = -1;
+  }
+
+  Signals(const Signals&) = delete;
+  Signals& operator=(const Signals&) = delete;
+};
+
+ErrorOr<EventLoop>
+EventLoop::create() {
+  EventLoop loop;
+  loop.signals = std::make_unique<Signals>();
+
+#ifdef __linux__
+  loop.epollFd = TRY(unistdpp::epoll_create(EPOLL_CLOEXEC));
+  loop.timerFd = TRY(unistdpp::timerfd_create(
+    CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)); // NOLINT
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = &timer_tag;
+  TRY(unistdpp::epoll_ctl(
+    loop.epollFd, EPOLL_CTL_ADD, loop.timerFd.fd, &event));
+
+  // Ready when any fd in the epoll set is.
+  loop.pollFds.emplace_back(
+    unistdpp::waitFor(loop.epollFd, unistdpp::Wait::Read));
+  loop.pollEntries.emplace_back(nullptr);
+#endif
+
+  return loop;
+}
+
+EventLoop::EventLoop(EventLoop&&) noexcept = default;
+EventLoop& EventLoop::operator=(EventLoop&&) noexcept = default;
+EventLoop::~EventLoop() = default;
+
+OptError<>
+EventLoop::addFd(int fd, Callback callback) {
+  removeFd(fd);
+
+  auto entry = std::make_unique<Entry>(Entry{ fd, std::move(callback) });
+
+  // Regular files can't be added to epoll, they're always readable anyway.
+  // So poll those, like without epoll.
+  auto needsPoll = true;
+#ifdef __linux__
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = entry.get();
+  if (auto res = unistdpp::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+      res.has_value()) {
+    needsPoll = false;
+  } else if (res.error() != std::errc::operation_not_permitted) {
+    return tl::unexpected(res.error());
+  }
+#endif
+
+  if (needsPoll) {
+    pollFds.emplace_back(pollfd{ .fd = fd, .events = POLLIN, .revents = 0 });
+    pollEntries.emplace_back(entry.get());
+  }
+
+  entries.emplace(fd, std::move(entry));
+  return {};
+}
+
+void
+EventLoop::removeFd(int fd) {
+  auto it = entries.find(fd);
+  if (it == entries.end()) {
+    return;
+  }
+
+#ifdef __linux__
+  (void)unistdpp::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+  // Events of this dispatch can still point to the entry, so keep it until
+  // the dispatch is done.
+  it->second->removed = true;
+  removedEntries.emplace_back(std::move(it->second));
+  entries.erase(it);
+
+  if (!dispatching) {
+    removeEntries();
+  }
+}
+
+void
+EventLoop::removeEntries() {
+  for (std::size_t i = 0; i < pollEntries.size();) {
+    if (pollEntries[i] != nullptr && pollEntries[i]->removed) {
+      pollEntries.erase(pollEntries.begin() + long(i));
+      pollFds.erase(pollFds.begin() + long(i));
+    } else {
+      i++;
+    }
+  }
+  removedEntries.clear();
+}
+
+TimerHandle
+EventLoop::addTimer(std::chrono::microseconds duration,
+                    Callback callback,
+                    std::optional<std::chrono::microseconds> repeat) {
+  auto [timer, handle] =
+    Timer::makeTimer(duration, std::move(callback), repeat);
+  timers.emplace(std::move(timer));
+
+  if (auto err = armTimer(); !err.has_value()) {
+    std::cerr << "Error arming timer: " << err.error().msg << "\n";
+  }
+  return std::move(handle);
+}
+
+OptError<>
+EventLoop::addSignal(int signal, Callback callback) {
+  auto [it, added] = signals->handlers.try_emplace(signal);
+  it->second.callback = std::move(callback);
+  if (!added) {
+    return {};
+  }
+
+  if (!signals->pipe.readPipe.isValid()) {
+    auto pipe = TRY(unistdpp::pipe());
+    for (const auto* fd : { &pipe.readPipe, &pipe.writePipe }) {
+      TRY(unistdpp::setNonBlocking(*fd));
+      TRY(unistdpp::fcntl<int>(*fd, F_SETFD, FD_CLOEXEC));
+    }
+
+#ifdef __linux__
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &signal_tag;
+    TRY(unistdpp::epoll_ctl(
+      epollFd, EPOLL_CTL_ADD, pipe.readPipe.fd, &event));
+#else
+    pollFds.emplace_back(
+      unistdpp::waitFor(pipe.readPipe, unistdpp::Wait::Read));
+    pollEntries.emplace_back(nullptr);
+#endif
+
+    signals->pipe = std::move(pipe);
+    signalPipeFd = signals->pipe.writePipe.fd;
+  }
+  it->second.previous = std::signal(signal, writeSignal);
+
+  return {};
+}
+
+std::optional<std::chrono::microseconds>
+EventLoop::getTimeout(std::optional<std::chrono::microseconds> timeout) const {
+#ifdef __linux__
+  // The timerfd wakes up the epoll fd.
+  return timeout;
+#else
+  if (timers.empty()) {
+    return timeout;
+  }
+
+  const auto next =
+    std::max(std::chrono::microseconds(0), timers.top()->getDuration());
+  return timeout.has_value() ? std::min(*timeout, next) : next;
+#endif
+}
+
+void
+EventLoop::runTimers() {
+  while (!timers.empty()) {
+    std::shared_ptr<Timer> top = timers.top();
+    if (!top->check()) {
+      break;
+    }
+
+    timers.pop();
+    if (top->repeats()) {
+      top->reset();
+      timers.emplace(std::move(top));
+    }
+  }
+}
+
+OptError<>
+EventLoop::armTimer() {
+#ifdef __linux__
+  const auto next = timers.empty()
+                      ? std::nullopt
+                      : std::optional(timers.top()->getTriggerTime());
+  if (next == armedTime) {
+    return {};
+  }
+
+  // A zero time disarms the timer.
+  itimerspec spec{};
+  if (next.has_value()) {
+    spec.it_value = toTimespec(*next);
+  }
+  TRY(unistdpp::timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr));
+  armedTime = next;
+#endif
+  return {};
+}
+
+OptError<>
+EventLoop::dispatchSignals() {
+  const auto call = [this](int signal) {
+    if (auto it = signals->handlers.find(signal);
+        it != signals->handlers.end()) {
+      it->second.callback();
+    }
+  };
+
+  while (true) {
+    auto signal = signals->pipe.readPipe.readAll<char>();
+    if (!signal.has_value()) {
+      break;
+    }
+    call(*signal);
+  }
+  return {};
+}
+
+OptError<>
+EventLoop::dispatch() {
+  dispatching = true;
+
+  for (std::size_t i = 0; i < pollFds.size(); i++) {
+    if (!unistdpp::canRead(pollFds[i])) {
+      continue;
+    }
+    pollFds[i].revents = 0;
+
+    auto* entry = pollEntries[i];
+    if (entry != nullptr) {
+      if (!entry->removed) {
+        entry->callback();
+      }
+      continue;
+    }
+
+#ifdef __linux__
+    const auto count = TRY(unistdpp::epoll_wait(
+      epollFd, readyEvents.data(), int(readyEvents.size()), 0));
+
+    for (int event = 0; event < count; event++) {
+      auto* ptr = readyEvents[event].data.ptr; // NOLINT
+      if (ptr == &timer_tag) {
+        (void)timerFd.readAll<uint64_t>();
+        armedTime.reset();
+        runTimers();
+      } else if (ptr == &signal_tag) {
+        TRY(dispatchSignals());
+      } else if (auto* epollEntry = static_cast<Entry*>(ptr);
+                 !epollEntry->removed) {
+        epollEntry->callback();
+      }
+    }
+#else
+    TRY(dispatchSignals());
+#endif
+  }
+
+#ifndef __linux__
+  runTimers();
+#endif
+
+  dispatching = false;
+  removeEntries();
+  return armTimer();
+}
+
+OptError<>
+EventLoop::wait(std::optional<std::chrono::microseconds> timeout) {
+  // Rounded up, so a timer isn't polled for before it's due.
+  const auto waitTime = getTimeout(timeout);
+  TRY(unistdpp::poll(
+    pollFds,
+    waitTime.has_value()
+      ? std::optional(std::chrono::ceil<std::chrono::milliseconds>(*waitTime))
+      : std::nullopt));
+  return dispatch();
+}
+
+} // namespace rmlib
@@ -0,0 +1,176 @@
+#include "FontManager.h"
+
+#include "stb_truetype.h"
+
+#include <unistdpp/file.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rmlib {
+
+namespace {
+#ifdef BUILTIN_FONT
+#include "noto-sans-mono.h"
+#else
+constexpr auto font_path = "/usr/share/fonts/ttf/noto/NotoMono-Regular.ttf";
+#endif
+
+constexpr auto bold_font_path =
+  "/usr/share/fonts/ttf/noto/NotoSansMono-Bold.ttf";
+
+/// Tried in order for codepoints the main fonts don't have.
+constexpr std::array fallback_font_paths = {
+  "/usr/share/fonts/ttf/noto/NotoSansCJK-Regular.ttc",
+  "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+};
+
+unistdpp::Result<unistdpp::MmapPtr>
+mapFile(const std::filesystem::path& path) {
+  const auto fd = TRY(unistdpp::open(path.c_str(), O_RDONLY));
+  const auto size = TRY(unistdpp::lseek(fd, 0, SEEK_END));
+  return unistdpp::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+}
+
+size_t
+getResidentBytes(const unistdpp::MmapPtr& mapping) {
+  const auto pageSize = size_t(sysconf(_SC_PAGESIZE));
+  const auto pages = (mapping.get_deleter().size + pageSize - 1) / pageSize;
+
+  std::vector<unsigned char> residency(pages);
+  if (mincore(mapping.get(), mapping.get_deleter().size, residency.data()) !=
+      0) {
+    return 0;
+  }
+
+  size_t result = 0;
+  for (auto page : residency) {
+    result += (page & 1) != 0 ? pageSize : 0;
+  }
+  // The last page is partially mapped.
+  return std::min(result, mapping.get_deleter().size);
+}
+} // namespace
+
+FontManager&
+FontManager::getInstance() {
+  static FontManager manager;
+  return manager;
+}
+
+FontManager::FontManager() {
+#ifdef BUILTIN_FONT
+  auto& regular = chains[int(FontStyle::Regular)].emplace_back();
+  regular.data = NotoSansMono_Regular_ttf;
+#else
+  addFace(FontStyle::Regular, font_path);
+#endif
+
+  // Without a bold font, fall back to the regular one.
+  addFace(FontStyle::Bold, bold_font_path);
+#ifdef BUILTIN_FONT
+  auto& boldFallback = chains[int(FontStyle::Bold)].emplace_back();
+  boldFallback.data = NotoSansMono_Regular_ttf;
+#else
+  addFace(FontStyle::Bold, font_path);
+#endif
+
+  for (const auto* path : fallback_font_paths) {
+    addFace(FontStyle::Regular, path);
+    addFace(FontStyle::Bold, path);
+  }
+}
+
+FontManager::~FontManager() = default;
+
+void
+FontManager::addFace(FontStyle style, std::filesystem::path path) {
+  auto& face = chains[int(style)].emplace_back();
+  face.path = std::move(path);
+}
+
+const stbtt_fontinfo*
+FontManager::load(Face& face) {
+  if (face.failed || face.info != nullptr) {
+    return face.info.get();
+  }
+
+  // Faces in several chains share the mapping.
+  for (const auto& chain : chains) {
+    for (const auto& other : chain) {
+      if (face.data == nullptr && other.mapping != nullptr &&
+          other.path == face.path) {
+        face.data = other.data;
+      }
+    }
+  }
+
+  if (face.data == nullptr) {
+    auto mapping = mapFile(face.path);
+    if (!mapping.has_value()) {
+      face.failed = true;
+      return nullptr;
+    }
+
+    face.mapping = std::move(*mapping);
+    face.data = static_cast<const uint8_t*>(face.mapping.get());
+  }
+
+  auto info = std::make_unique<stbtt_fontinfo>();
+  const auto offset = stbtt_GetFontOffsetForIndex(face.data, 0);
+  if (offset < 0 || stbtt_InitFont(info.get(), face.data, offset) == 0) {
+    std::cerr << "Error initializing font: " << face.path << "\n";
+    face.failed = true;
+    return nullptr;
+  }
+
+  face.info = std::move(info);
+  return face.info.get();
+}
+
+const stbtt_fontinfo*
+FontManager::getPrimaryFace(FontStyle style) {
+  for (auto& face : chains[int(style)]) {
+    if (const auto* info = load(face); info != nullptr) {
+      return info;
+    }
+  }
+
+  std::cerr << "Error: no font available!\n";
+  std::exit(EXIT_FAILURE);
+}
+
+const stbtt_fontinfo*
+FontManager::getFace(uint32_t codepoint, FontStyle style) {
+  for (auto& face : chains[int(style)]) {
+    const auto* info = load(face);
+    if (info != nullptr && stbtt_FindGlyphIndex(info, int(codepoint)) != 0) {
+      return info;
+    }
+  }
+  return getPrimaryFace(style);
+}
+
+FontStats
+FontManager::getStats() const {
+  FontStats stats;
+  for (const auto& chain : chains) {
+    for (const auto& face : chain) {
+      if (face.info == nullptr) {
+        continue;
+      }
+
+      stats.faces++;
+      if (face.mapping != nullptr) {
+        stats.mappedBytes += face.mapping.get_deleter().size;
+        stats.residentBytes += getResidentBytes(face.mapping);
+      }
+    }
+  }
+  return stats;
+}
+
+} // namespace rmlib
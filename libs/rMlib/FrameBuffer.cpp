@@ -3,6 +3,12 @@
 
 #include <unistdpp/file.h>
 #include <unistdpp/ioctl.h>
+#include <unistdpp/shared_mem.h>
+#include <unistdpp/socket.h>
+
+// rm2fb
+#include <Message.h>
+#include <SharedBuffer.h>
 
 #include <array>
 #include <cassert>
@@ -26,6 +32,22 @@
 namespace rmlib::fb {
 namespace {
 constexpr auto fb_path = "/dev/fb0";
+constexpr mode_t overlay_mode = 0666;
+
+int
+toMxcfbWaveform(Waveform waveform) {
+  switch (waveform) {
+    case Waveform::DU:
+      return WAVEFORM_MODE_DU;
+    case Waveform::A2:
+      return WAVEFORM_MODE_A2;
+    default:
+    case Waveform::GC16:
+      return WAVEFORM_MODE_GC16;
+    case Waveform::GC16Fast:
+      return WAVEFORM_MODE_GL16;
+  }
+}
 } // namespace
 
 ErrorOr<FrameBuffer::Type>
@@ -85,6 +107,63 @@ FrameBuffer::open(std::optional<Size> requestedSize) {
   return FrameBuffer(fbType, std::move(fd), canvas);
 }
 
+ErrorOr<FrameBuffer>
+FrameBuffer::openOverlay(int id, int z) {
+  if (TRY(detectType()) != rM2Stuff) {
+    return Error::make("Overlays are only supported by rm2fb");
+  }
+
+  if (id < 0 || id >= max_overlays) {
+    return Error::make("Invalid overlay: " + std::to_string(id));
+  }
+
+  auto addr =
+    TRY(unistdpp::Address::fromHostPort("127.0.0.1", rm2fb_tcp_port));
+  auto sock = TRY(unistdpp::socket(AF_INET, SOCK_STREAM, 0));
+  TRY(unistdpp::connect(sock, addr));
+  TRY(sendMessage(sock, ClientMsg(SetUpdateStream{ .enabled = false })));
+
+  auto fd = TRY(unistdpp::shm_open(
+    getOverlayName(id).c_str(), O_RDWR | O_CREAT, overlay_mode));
+  TRY(unistdpp::ftruncate(fd, fb_size));
+
+  auto* memory = static_cast<uint8_t*>(
+    mmap(nullptr, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.fd, 0));
+  if (memory == MAP_FAILED) {
+    return Error::make("Error mapping overlay");
+  }
+
+  Canvas canvas(
+    memory, fb_width, fb_height, fb_width * fb_pixel_size, fb_pixel_size);
+  auto result = FrameBuffer(rM2Stuff, std::move(fd), canvas);
+  result.overlaySock = std::move(sock);
+  result.overlayId = id;
+  result.overlayZ = z;
+  return result;
+}
+
+void
+FrameBuffer::setOverlayVisible(bool visible,
+                               Waveform waveform,
+                               UpdateFlags flags) const {
+  if (!isOverlay()) {
+    return;
+  }
+
+  const auto msg = OverlaySet{
+    .id = overlayId,
+    .z = overlayZ,
+    .x1 = 0,
+    .y1 = 0,
+    .x2 = canvas.width() - 1,
+    .y2 = canvas.height() - 1,
+    .waveform = toMxcfbWaveform(waveform) | UpdateParams::ioctl_waveform_flag,
+    .flags = static_cast<int>(flags),
+    .visible = visible,
+  };
+  (void)sendMessage(overlaySock, ClientMsg(msg));
+}
+
 void
 FrameBuffer::close() {
   if (canvas.memory() != nullptr && fd.isValid()) {
@@ -102,19 +181,24 @@ FrameBuffer::doUpdate(Rect region, Waveform waveform, UpdateFlags flags) const {
   update.update_region.width = region.width();
   update.update_region.height = region.height();
 
-  update.waveform_mode = [&] {
-    switch (waveform) {
-      case Waveform::DU:
-        return WAVEFORM_MODE_DU;
-      case Waveform::A2:
-        return WAVEFORM_MODE_A2;
-      default:
-      case Waveform::GC16:
-        return WAVEFORM_MODE_GC16;
-      case Waveform::GC16Fast:
-        return WAVEFORM_MODE_GL16;
-    }
-  }();
+  update.waveform_mode = toMxcfbWaveform(waveform);
+
+  if (isOverlay()) {
+    const auto params = UpdateParams{
+      .y1 = region.topLeft.y,
+      .x1 = region.topLeft.x,
+      .y2 = region.topLeft.y + region.height() - 1,
+      .x2 = region.topLeft.x + region.width() - 1,
+      .flags = static_cast<int>(flags),
+      .waveform =
+        int(update.waveform_mode) | UpdateParams::ioctl_waveform_flag,
+      .temperatureOverride = 0,
+      .extraMode = 0,
+    };
+    const auto msg = OverlayUpdate{ .id = overlayId, .params = params };
+    (void)sendMessage(overlaySock, ClientMsg(msg));
+    return;
+  }
 
   if (type == rM2Stuff) {
     update.update_mode = RM2_UPDATE_MODE;
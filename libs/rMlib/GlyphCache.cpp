@@ -0,0 +1,161 @@
+#include "GlyphCache.h"
+
+#include "stb_truetype.h"
+
+#include <utf8.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace rmlib {
+
+GlyphCache&
+GlyphCache::getInstance() {
+  static GlyphCache cache;
+  return cache;
+}
+
+std::shared_ptr<const Glyph>
+GlyphCache::get(uint32_t codepoint,
+                int size,
+                float subpixelOffset,
+                FontStyle style) {
+  auto key = Key{ codepoint, size, 0, style };
+  static_assert(sizeof(key.subpixelOffset) == sizeof(subpixelOffset));
+  memcpy(&key.subpixelOffset, &subpixelOffset, sizeof(subpixelOffset));
+
+  if (const auto* glyph = glyphs.find(key)) {
+    return *glyph;
+  }
+
+  const auto* font = FontManager::getInstance().getFace(codepoint, style);
+  const auto scale = stbtt_ScaleForPixelHeight(font, float(size));
+
+  auto glyph = std::make_shared<Glyph>();
+
+  int advance = 0;
+  int lsb = 0;
+  stbtt_GetCodepointHMetrics(font, int(codepoint), &advance, &lsb);
+  glyph->advance = float(advance) * scale;
+
+  int x0 = 0;
+  int x1 = 0;
+  int y0 = 0;
+  int y1 = 0;
+  stbtt_GetCodepointBitmapBox(
+    font, int(codepoint), scale, scale, &x0, &y0, &x1, &y1);
+
+  glyph->offset = { x0, y0 };
+  glyph->width = x1 - x0 + 1;
+  glyph->height = y1 - y0 + 1;
+  glyph->coverage.resize(glyph->width * glyph->height);
+  stbtt_MakeCodepointBitmapSubpixel(font,
+                                    glyph->coverage.data(),
+                                    /*  width */ glyph->width,
+                                    /* height */ glyph->height,
+                                    /* stride */ glyph->width,
+                                    /* xscale */ scale,
+                                    /* yscale */ scale,
+                                    subpixelOffset,
+                                    /* yshift */ 0,
+                                    int(codepoint));
+
+  return glyphs.insert(key, std::move(glyph));
+}
+
+std::shared_ptr<const TextRun>
+GlyphCache::measure(std::string_view text, int size, FontStyle style) {
+  const auto key = RunKey{ std::hash<std::string_view>{}(text), size, style };
+  const auto* cached = runs.find(key);
+  if (cached != nullptr && (*cached)->text == text) {
+    return *cached;
+  }
+
+  auto& fonts = FontManager::getInstance();
+  const auto* font = fonts.getPrimaryFace(style);
+  const auto scale = stbtt_ScaleForPixelHeight(font, float(size));
+
+  int ascent = 0;
+  int descent = 0;
+  int lineGap = 0;
+  stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
+
+  // Divide the line gap to above and below.
+  const float charStart = float(lineGap) * scale / 2;
+  const float baseLine = charStart + float(ascent) * scale;
+  const float charEnd = baseLine - float(descent) * scale; // descent < 0.
+  const float height = charEnd + charStart;
+
+  auto run = std::make_shared<TextRun>();
+  run->text = text;
+  run->codepoints = utf8::utf8to32(utf8::replace_invalid(text));
+  run->positions.reserve(run->codepoints.size());
+  run->baseLine = baseLine;
+
+  const auto& codepoints = run->codepoints;
+
+  float xpos = 0;
+  const auto* face =
+    codepoints.empty() ? font : fonts.getFace(codepoints.front(), style);
+  for (size_t ch = 0; ch != codepoints.size(); ch++) {
+    run->positions.push_back(xpos);
+
+    int advance = 0;
+    int lsb = 0;
+    const auto codepoint = static_cast<int>(codepoints[ch]);
+    const auto faceScale = stbtt_ScaleForPixelHeight(face, float(size));
+    stbtt_GetCodepointHMetrics(face, codepoint, &advance, &lsb);
+    xpos += float(advance) * faceScale;
+
+    if (ch + 1 == codepoints.size()) {
+      break;
+    }
+
+    // Only kern pairs within a face.
+    const auto* nextFace = fonts.getFace(codepoints[ch + 1], style);
+    if (nextFace == face) {
+      const auto next = static_cast<int>(codepoints[ch + 1]);
+      xpos += faceScale *
+              float(stbtt_GetCodepointKernAdvance(face, codepoint, next));
+    }
+    face = nextFace;
+  }
+
+  run->size = { static_cast<int>(ceilf(xpos)),
+                static_cast<int>(ceilf(height)) };
+
+  return runs.insert(key, std::move(run));
+}
+
+GlyphRun
+GlyphCache::layout(std::string_view text, int size, FontStyle style) {
+  return layout(*measure(text, size, style), size, style);
+}
+
+GlyphRun
+GlyphCache::layout(const TextRun& textRun, int size, FontStyle style) {
+  GlyphRun run;
+  run.glyphs.reserve(textRun.codepoints.size());
+
+  for (size_t ch = 0; ch != textRun.codepoints.size(); ch++) {
+    const auto xpos = textRun.positions[ch];
+    auto glyph =
+      get(textRun.codepoints[ch], size, xpos - floorf(xpos), style);
+
+    const auto position = Point{ static_cast<int>(xpos),
+                                 static_cast<int>(textRun.baseLine) } +
+                          glyph->offset;
+
+    run.glyphs.push_back({ std::move(glyph), position });
+  }
+
+  return run;
+}
+
+void
+GlyphCache::clear() {
+  glyphs.clear();
+  runs.clear();
+}
+
+} // namespace rmlib
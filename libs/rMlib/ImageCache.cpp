@@ -0,0 +1,174 @@
+#include "ImageCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace rmlib {
+
+namespace {
+
+/// Keeps the owner of the pixels alive with the canvas.
+template<typename T>
+std::shared_ptr<const Canvas>
+share(T owner) {
+  auto ptr = std::make_shared<T>(std::move(owner));
+  return { ptr, &ptr->canvas };
+}
+
+/// Averages the source pixels covered by each destination pixel, or picks
+/// the nearest one when enlarging.
+MemoryCanvas
+scaleToFit(const Canvas& src, Size size) {
+  const auto scale = std::min(float(size.width) / float(src.width()),
+                              float(size.height) / float(src.height()));
+  const auto dstSize =
+    Size{ std::max(1, int(std::lround(float(src.width()) * scale))),
+          std::max(1, int(std::lround(float(src.height()) * scale))) };
+
+  MemoryCanvas result(dstSize.width, dstSize.height, 2);
+  if (dstSize == src.size()) {
+    result.canvas.copy(src);
+    return result;
+  }
+
+  const auto range = [](int i, int srcSize, int dstSize) {
+    const auto start = i * srcSize / dstSize;
+    const auto end = std::max(start + 1, (i + 1) * srcSize / dstSize);
+    return std::pair{ start, end };
+  };
+
+  result.canvas.transform([&](int x, int y, uint16_t /*unused*/) {
+    const auto [x1, x2] = range(x, src.width(), dstSize.width);
+    const auto [y1, y2] = range(y, src.height(), dstSize.height);
+
+    int sum = 0;
+    for (int sy = y1; sy < y2; sy++) {
+      for (int sx = x1; sx < x2; sx++) {
+        sum += greyFromRGB565(src.getPixel(sx, sy));
+      }
+    }
+    return greyToRGB565(sum / ((x2 - x1) * (y2 - y1)));
+  });
+  return result;
+}
+
+std::string
+toHex(size_t hash) {
+  std::stringstream ss;
+  ss << std::hex << std::setw(sizeof(size_t) * 2) << std::setfill('0')
+     << hash << '-';
+  return ss.str();
+}
+
+/// The cache files of an image start with a hash of its path and the dither
+/// options, followed by a hash of its version and the size.
+std::string
+getCachePrefix(const std::filesystem::path& path, const DitherOptions& dither) {
+  auto hash = std::hash<std::string>{}(path.string());
+  hash = hash * 31 + std::hash<int>{}(dither.bits);
+  hash = hash * 31 + std::hash<int>{}(int(dither.mode));
+  return toHex(hash);
+}
+
+std::string
+getCacheVersion(std::filesystem::file_time_type time, uintmax_t fileSize) {
+  auto hash = std::hash<int64_t>{}(time.time_since_epoch().count());
+  hash = hash * 31 + std::hash<uintmax_t>{}(fileSize);
+  return toHex(hash);
+}
+
+/// Removes the files of older versions of the image, in any size.
+void
+removeStale(const std::filesystem::path& directory,
+            const std::string& prefix,
+            const std::string& current) {
+  std::error_code ec;
+  for (auto it = std::filesystem::directory_iterator(directory, ec);
+       !ec && it != std::filesystem::directory_iterator();
+       it.increment(ec)) {
+    const auto name = it->path().filename().string();
+    if (name.compare(0, prefix.size(), prefix) == 0 &&
+        name.compare(0, current.size(), current) != 0) {
+      std::error_code removeEc;
+      std::filesystem::remove(it->path(), removeEc);
+    }
+  }
+}
+
+} // namespace
+
+ImageCache::ImageCache(std::filesystem::path directory,
+                       size_t memoryBudget,
+                       DitherOptions dither)
+  : directory(std::move(directory)), dither(dither), memory(memoryBudget) {}
+
+std::shared_ptr<const Canvas>
+ImageCache::get(const std::filesystem::path& path, Size size) {
+  std::error_code ec;
+  const auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return nullptr;
+  }
+  const auto fileSize = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return nullptr;
+  }
+
+  const auto key = Key{ path.string(), size };
+  if (const auto* entry = memory.find(key);
+      entry != nullptr && entry->time == time && entry->fileSize == fileSize) {
+    return entry->canvas;
+  }
+
+  auto canvas = load(path, size, time, fileSize);
+  if (canvas == nullptr) {
+    return nullptr;
+  }
+
+  const auto cost =
+    size_t(canvas->width()) * canvas->height() * canvas->components();
+  memory.insert(key, Entry{ canvas, time, fileSize }, cost);
+  return canvas;
+}
+
+std::shared_ptr<const Canvas>
+ImageCache::load(const std::filesystem::path& path,
+                 Size size,
+                 std::filesystem::file_time_type time,
+                 uintmax_t fileSize) {
+  const auto prefix = getCachePrefix(path, this->dither);
+  const auto version = prefix + getCacheVersion(time, fileSize);
+  const auto cachePath = directory / (version + std::to_string(size.width) +
+                                      'x' + std::to_string(size.height) +
+                                      ".raw");
+  if (auto image = ImageCanvas::mapRaw(cachePath.c_str()); image.has_value()) {
+    return share(std::move(*image));
+  }
+
+  std::cout << "Decoding image: " << path << std::endl;
+  auto image = ImageCanvas::load(path.c_str());
+  if (!image.has_value()) {
+    return nullptr;
+  }
+
+  auto scaled = scaleToFit(image->canvas, size);
+  rmlib::dither(scaled.canvas, this->dither);
+
+  // Write a temporary file first, so a partial file is never mapped.
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+  const auto tmpPath = cachePath.string() + ".tmp";
+  if (auto err = scaled.canvas.writeRaw(tmpPath.c_str()); !err.has_value()) {
+    std::cerr << "Error caching image: " << err.error().msg << "\n";
+  } else {
+    std::filesystem::rename(tmpPath, cachePath, ec);
+    removeStale(directory, prefix, version);
+  }
+
+  return share(std::move(scaled));
+}
+
+} // namespace rmlib
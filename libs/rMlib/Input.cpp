@@ -2,7 +2,9 @@
 
 #include "Device.h"
 
+#include <unistdpp/epoll.h>
 #include <unistdpp/file.h>
+#include <unistdpp/ioctl.h>
 #include <unistdpp/poll.h>
 
 #include <libevdev/libevdev.h>
@@ -13,10 +15,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <bitset>
+#include <climits>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <memory>
-#include <unordered_set>
+#include <thread>
 
 namespace rmlib::input {
 
@@ -68,37 +74,118 @@ getKeyFlood() {
   return floodBuffer;
 }
 
+/// Events read per read() call.
+constexpr auto read_batch_size = 64;
+
+/// Key events in a single report.
+constexpr auto max_report_keys = 16;
+
+constexpr auto recording_extension = ".ev";
+constexpr auto recording_mode = 0644;
+
+constexpr auto usec_per_sec = 1000000;
+
+EventClock::time_point
+getEventTime(const input_event& event) {
+  return EventClock::time_point(
+    std::chrono::seconds(event.input_event_sec) +
+    std::chrono::microseconds(event.input_event_usec));
+}
+
+void
+setEventTime(input_event& event, EventClock::time_point time) {
+  const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    time.time_since_epoch())
+                    .count();
+  event.input_event_sec = us / usec_per_sec;
+  event.input_event_usec = us % usec_per_sec;
+}
+
+bool
+isReport(const input_event& event) {
+  return event.type == EV_SYN && event.code == SYN_REPORT;
+}
+
 template<typename Device>
 struct InputDevice : public InputDeviceBase {
   using InputDeviceBase::InputDeviceBase;
 
-  OptError<> readEvents(std::vector<Event>& out) final {
-    auto* devThis = static_cast<Device*>(this);
+  /// Reads no more events than fit the ring, the rest stay in the evdev
+  /// buffer until the next call.
+  OptError<> readEvents(EventRing& out) final {
+    std::array<input_event, read_batch_size> buffer;
+
+    // Decoding gives at most an event per input event, apart from resyncs
+    // after a drop, for which the ring drops moves.
+    while (!out.full()) {
+      const auto readSize =
+        std::min(buffer.size(), EventRing::capacity - out.size()) *
+        sizeof(input_event);
+      auto size = unistdpp::read(fd, buffer.data(), readSize);
+      if (!size.has_value()) {
+        if (size.error() == std::errc::resource_unavailable_try_again) {
+          return {};
+        }
+        return tl::unexpected(size.error());
+      }
+
+      if (recording.isValid()) {
+        if (auto err = recording.writeAll(buffer.data(), *size);
+            !err.has_value()) {
+          std::cerr << "Recording " << path << ": "
+                    << unistdpp::to_string(err.error()) << "\n";
+          recording.close();
+        }
+      }
 
-    int rc = 0;
-    do {
+      decode(buffer.data(), *size / sizeof(input_event), out);
+      if (size_t(*size) < readSize) {
+        return {};
+      }
+    }
+    return {};
+  }
 
-      auto event = input_event{};
-      rc = libevdev_next_event(evdev.get(), LIBEVDEV_READ_FLAG_NORMAL, &event);
+  void decode(const input_event* events, size_t count, EventRing& out) final {
+    auto* devThis = static_cast<Device*>(this);
 
-      if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
-        auto evs = TRY(devThis->handleEvent(event));
-        out.insert(out.end(), evs.begin(), evs.end());
-      } else if (rc == LIBEVDEV_READ_STATUS_SYNC) {
+    for (size_t i = 0; i < count; i++) {
+      const auto& event = events[i]; // NOLINT
+      if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+        dropped = true;
+        continue;
+      }
 
-        while (rc == LIBEVDEV_READ_STATUS_SYNC) {
-          auto evs = TRY(devThis->handleEvent(event));
-          out.insert(out.end(), evs.begin(), evs.end());
+      // Events are reported with the time of the report that ends them.
+      if (isReport(event)) {
+        reportTime = getEventTime(event);
+      }
 
-          rc =
-            libevdev_next_event(evdev.get(), LIBEVDEV_READ_FLAG_SYNC, &event);
+      // The events up to the next report are incomplete, get the state of
+      // the device instead.
+      if (dropped) {
+        if (isReport(event)) {
+          dropped = false;
+          devThis->resync(out);
         }
+        continue;
       }
-    } while (rc == LIBEVDEV_READ_STATUS_SYNC ||
-             rc == LIBEVDEV_READ_STATUS_SUCCESS);
 
-    return {};
+      devThis->handleEvent(event, out);
+    }
   }
+
+  RecordingHeader getRecordingHeader() const final {
+    RecordingHeader header;
+    header.kind = Device::kind;
+    if constexpr (Device::kind != RecordingHeader::Key) {
+      header.transform = static_cast<const Device*>(this)->transform;
+    }
+    return header;
+  }
+
+  bool dropped = false;
+  EventClock::time_point reportTime;
 };
 
 struct TouchDevice : public InputDevice<TouchDevice> {
@@ -108,18 +195,22 @@ struct TouchDevice : public InputDevice<TouchDevice> {
               Transform transform)
     : InputDevice(std::move(fd), std::move(evdev), std::move(path))
     , transform(transform) {}
-  ErrorOr<std::vector<TouchEvent>> handleEvent(input_event /*event*/);
-  TouchEvent& getSlot() { return slots.at(slot); }
+  void handleEvent(const input_event& event, EventRing& out);
+  void report(EventRing& out);
+  void resync(EventRing& out);
 
   void flood() final {
     const auto* buf = getTouchFlood();
     (void)fd.writeAll(buf, touch_flood_size * sizeof(input_event));
   }
 
+  static constexpr auto kind = RecordingHeader::Touch;
+
   Transform transform;
   int slot = 0;
   std::array<TouchEvent, max_num_slots> slots;
-  std::unordered_set<int> changedSlots;
+  std::bitset<max_num_slots> changedSlots;
+  std::bitset<max_num_slots> activeSlots;
 };
 
 struct PenDevice : public InputDevice<PenDevice> {
@@ -129,39 +220,56 @@ struct PenDevice : public InputDevice<PenDevice> {
             Transform transform)
     : InputDevice(std::move(fd), std::move(evdev), std::move(path))
     , transform(transform) {}
-  ErrorOr<std::vector<PenEvent>> handleEvent(input_event /*event*/);
+  void handleEvent(const input_event& event, EventRing& out);
+  void report(EventRing& out);
+  void resync(EventRing& out);
 
   void flood() final {
     const auto* buf = getTouchFlood();
     (void)fd.writeAll(buf, touch_flood_size * sizeof(input_event));
   }
 
+  static constexpr auto kind = RecordingHeader::Pen;
+
   Transform transform;
   PenEvent penEvent;
+  bool touching = false;
 };
 
 struct KeyDevice : public InputDevice<KeyDevice> {
   KeyDevice(unistdpp::FD fd, EvDevPtr evdev, std::string path)
     : InputDevice(std::move(fd), std::move(evdev), std::move(path)) {}
-  ErrorOr<std::vector<KeyEvent>> handleEvent(input_event /*event*/);
+  void handleEvent(const input_event& event, EventRing& out);
+
+  /// Key repeats follow soon enough, don't guess the missed ones.
+  void resync(EventRing& /*out*/) { numKeyEvents = 0; }
 
   void flood() final {
     const auto* buf = getKeyFlood();
     (void)fd.writeAll(buf, key_flood_size * sizeof(input_event));
   }
 
-  std::vector<KeyEvent> keyEvents;
+  static constexpr auto kind = RecordingHeader::Key;
+
+  std::array<KeyEvent, max_report_keys> keyEvents;
+  size_t numKeyEvents = 0;
 };
 
-ErrorOr<std::vector<PenEvent>>
-PenDevice::handleEvent(input_event event) {
-  if (event.type == EV_SYN && event.code == SYN_REPORT) {
-    auto ev = penEvent;
-    ev.location = transform * penEvent.location;
-    std::vector<PenEvent> events{ ev };
+void
+PenDevice::report(EventRing& out) {
+  auto ev = penEvent;
+  ev.location = transform * penEvent.location;
+  ev.time = reportTime;
+  out.push(ev);
+
+  penEvent.type = PenEvent::Move;
+}
 
-    penEvent.type = PenEvent::Move;
-    return events;
+void
+PenDevice::handleEvent(const input_event& event, EventRing& out) {
+  if (event.type == EV_SYN && event.code == SYN_REPORT) {
+    report(out);
+    return;
   }
 
   if (event.type == EV_ABS) {
@@ -182,81 +290,173 @@ PenDevice::handleEvent(input_event event) {
         penEvent.type = PenEvent::ToolLeave;
       }
     } else if (event.code == BTN_TOUCH) {
-      if (event.value == KeyEvent::Press) {
+      touching = event.value == KeyEvent::Press;
+      if (touching) {
         penEvent.type = PenEvent::TouchDown;
       } else {
         penEvent.type = PenEvent::TouchUp;
       }
     }
   }
-
-  return std::vector<PenEvent>{};
 }
 
-ErrorOr<std::vector<TouchEvent>>
-TouchDevice::handleEvent(input_event event) {
-  if (event.type == EV_SYN && event.code == SYN_REPORT) {
-    std::vector<TouchEvent> events;
-    for (auto slotIdx : changedSlots) {
-      auto slot = slots.at(slotIdx);
-      slot.location = transform * slot.location;
-      events.push_back(slot);
+void
+PenDevice::resync(EventRing& out) {
+  for (auto [code, value] : { std::pair{ ABS_X, &penEvent.location.x },
+                              std::pair{ ABS_Y, &penEvent.location.y },
+                              std::pair{ ABS_DISTANCE, &penEvent.distance },
+                              std::pair{ ABS_PRESSURE, &penEvent.pressure } }) {
+    input_absinfo info{};
+    if (unistdpp::ioctl<input_absinfo*>(fd, EVIOCGABS(code), &info)) {
+      *value = info.value;
+    }
+  }
+
+  std::array<uint8_t, (KEY_MAX / CHAR_BIT) + 1> keys{};
+  if (unistdpp::ioctl<uint8_t*>(fd, EVIOCGKEY(keys.size()), keys.data())) {
+    const auto isTouching =
+      (keys[BTN_TOUCH / CHAR_BIT] & (1 << (BTN_TOUCH % CHAR_BIT))) != 0;
+    if (isTouching != touching) {
+      touching = isTouching;
+      penEvent.type = touching ? PenEvent::TouchDown : PenEvent::TouchUp;
+    }
+  }
+
+  report(out);
+}
 
-      slots.at(slotIdx).type = TouchEvent::Move;
+void
+TouchDevice::report(EventRing& out) {
+  for (int idx = 0; idx < max_num_slots && changedSlots.any(); idx++) {
+    if (!changedSlots.test(idx)) {
+      continue;
     }
-    changedSlots.clear();
-    return events;
+    changedSlots.reset(idx);
+
+    auto& slot = slots[idx];
+    auto ev = slot;
+    ev.location = transform * slot.location;
+    ev.time = reportTime;
+    out.push(ev);
+
+    slot.type = TouchEvent::Move;
+  }
+}
+
+void
+TouchDevice::handleEvent(const input_event& event, EventRing& out) {
+  if (event.type == EV_SYN && event.code == SYN_REPORT) {
+    report(out);
+    return;
   }
 
   if (event.type == EV_ABS && event.code == ABS_MT_SLOT) {
     slot = event.value;
-    getSlot().slot = event.value;
   }
-  changedSlots.insert(slot);
+
+  // Ignore slots we can't track.
+  if (slot < 0 || slot >= max_num_slots) {
+    return;
+  }
+  auto& slotEv = slots[slot];
+  slotEv.slot = slot;
+  changedSlots.set(slot);
 
   if (event.type == EV_ABS) {
     if (event.code == ABS_MT_TRACKING_ID) {
-      auto& slot = getSlot();
       if (event.value == -1) {
-        slot.type = TouchEvent::Up;
-        // setType = true;
+        slotEv.type = TouchEvent::Up;
+        activeSlots.reset(slot);
       } else {
-        slot.type = TouchEvent::Down;
-        slot.id = event.value;
-        // setType = true;
+        slotEv.type = TouchEvent::Down;
+        slotEv.id = event.value;
+        activeSlots.set(slot);
       }
     } else if (event.code == ABS_MT_POSITION_X) {
-      auto& slot = getSlot();
-      slot.location.x = event.value;
+      slotEv.location.x = event.value;
     } else if (event.code == ABS_MT_POSITION_Y) {
-      auto& slot = getSlot();
-      slot.location.y = event.value;
+      slotEv.location.y = event.value;
     } else if (event.code == ABS_MT_PRESSURE) {
-      auto& slot = getSlot();
-      slot.pressure = event.value;
+      slotEv.pressure = event.value;
+    }
+  }
+}
+
+void
+TouchDevice::resync(EventRing& out) {
+  // The layout of `struct input_mt_request_layout`, the code followed by
+  // the value of each slot.
+  std::array<int32_t, max_num_slots + 1> request{};
+  const auto getSlots = [&](int code) {
+    request[0] = code;
+    return unistdpp::ioctl<int32_t*>(
+             fd, EVIOCGMTSLOTS(sizeof(request)), request.data())
+      .has_value();
+  };
+
+  if (!getSlots(ABS_MT_TRACKING_ID)) {
+    return;
+  }
+
+  for (int idx = 0; idx < max_num_slots; idx++) {
+    const auto id = request[idx + 1];
+    auto& slotEv = slots[idx];
+    slotEv.slot = idx;
+
+    // Touches that ended, or were replaced by a new one.
+    if (activeSlots.test(idx) && id != slotEv.id) {
+      slotEv.type = TouchEvent::Up;
+      changedSlots.set(idx);
+      activeSlots.reset(idx);
+    }
+    if (activeSlots.test(idx) || id == -1) {
+      continue;
+    }
+
+    // New touches, but first report the end of the previous one.
+    if (changedSlots.test(idx)) {
+      report(out);
+    }
+    slotEv.type = TouchEvent::Down;
+    slotEv.id = id;
+    changedSlots.set(idx);
+    activeSlots.set(idx);
+  }
+
+  for (auto [code, member] : { std::pair{ ABS_MT_POSITION_X, &Point::x },
+                               std::pair{ ABS_MT_POSITION_Y, &Point::y } }) {
+    if (!getSlots(code)) {
+      continue;
+    }
+    for (int idx = 0; idx < max_num_slots; idx++) {
+      if (activeSlots.test(idx)) {
+        slots[idx].location.*member = request[idx + 1];
+        changedSlots.set(idx);
+      }
     }
   }
 
-  return std::vector<TouchEvent>{};
+  report(out);
 }
 
-ErrorOr<std::vector<KeyEvent>>
-KeyDevice::handleEvent(input_event event) {
+void
+KeyDevice::handleEvent(const input_event& event, EventRing& out) {
   if (event.type == EV_KEY) {
+    if (numKeyEvents == keyEvents.size()) {
+      return;
+    }
 
-    KeyEvent keyEvent{};
+    auto& keyEvent = keyEvents[numKeyEvents++];
     keyEvent.type = static_cast<decltype(keyEvent.type)>(event.value);
     keyEvent.keyCode = event.code;
-    keyEvents.push_back(keyEvent);
 
   } else if (event.type == EV_SYN && event.code == SYN_REPORT) {
-
-    auto ret = keyEvents;
-    keyEvents.clear();
-    return ret;
+    for (size_t i = 0; i < numKeyEvents; i++) {
+      keyEvents[i].time = reportTime;
+      out.push(keyEvents[i]);
+    }
+    numKeyEvents = 0;
   }
-
-  return std::vector<KeyEvent>{};
 }
 
 std::unique_ptr<InputDeviceBase>
@@ -287,6 +487,104 @@ makeDevice(unistdpp::FD fd,
     std::move(fd), std::move(evdev), std::move(path));
 }
 
+std::unique_ptr<InputDeviceBase>
+makeDecoder(const RecordingHeader& header, std::string path) {
+  switch (header.kind) {
+    case RecordingHeader::Touch:
+      return std::make_unique<TouchDevice>(
+        unistdpp::FD{}, nullptr, std::move(path), header.transform);
+    case RecordingHeader::Pen:
+      return std::make_unique<PenDevice>(
+        unistdpp::FD{}, nullptr, std::move(path), header.transform);
+    case RecordingHeader::Key:
+      break;
+  }
+  return std::make_unique<KeyDevice>(unistdpp::FD{}, nullptr, std::move(path));
+}
+
+timespec
+toTimespec(EventClock::time_point time) {
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    time.time_since_epoch())
+                    .count();
+  constexpr auto ns_per_sec = 1000000000;
+  return timespec{ .tv_sec = time_t(ns / ns_per_sec),
+                   .tv_nsec = long(ns % ns_per_sec) };
+}
+
+/// Feeds a recording to the decoder of the recorded device. The fd is a
+/// timer, which is readable when the next report is due.
+struct ReplayDevice : public InputDeviceBase {
+  ReplayDevice(unistdpp::FD timer,
+               std::string path,
+               Recording recording,
+               ReplaySpeed speed)
+    : InputDeviceBase(std::move(timer), nullptr, path)
+    , decoder(makeDecoder(recording.header, std::move(path)))
+    , replay(std::move(recording), speed, EventClock::now()) {}
+
+  OptError<> readEvents(EventRing& out) final {
+    (void)fd.readAll<uint64_t>();
+
+    replay.next(EventClock::now(),
+                [&](const RecordedEvent* recorded, size_t count) {
+                  buffer.resize(count);
+                  for (size_t i = 0; i < count; i++) {
+                    buffer[i] = toInputEvent(recorded[i]); // NOLINT
+                  }
+                  decoder->decode(buffer.data(), count, out);
+                });
+
+    return arm();
+  }
+
+  /// Sets the timer to the next report, or disarms it at the end.
+  OptError<> arm() const {
+    itimerspec spec{};
+    auto flags = 0;
+    if (const auto time = replay.getNextTime(); time.has_value()) {
+      if (replay.getSpeed() == ReplaySpeed::Fast) {
+        spec.it_value.tv_nsec = 1;
+      } else {
+        spec.it_value = toTimespec(*time);
+        flags = TFD_TIMER_ABSTIME;
+      }
+    }
+    TRY(unistdpp::timerfd_settime(fd, flags, &spec, nullptr));
+    return {};
+  }
+
+  void decode(const input_event* events, size_t count, EventRing& out) final {
+    decoder->decode(events, count, out);
+  }
+
+  void flood() final {}
+
+  bool isReplaying() const final { return !replay.isDone(); }
+
+  static input_event toInputEvent(const RecordedEvent& recorded) {
+    input_event event{};
+    event.type = recorded.type;
+    event.code = recorded.code;
+    event.value = recorded.value;
+    setEventTime(event, recorded.getTime());
+    return event;
+  }
+
+  std::unique_ptr<InputDeviceBase> decoder;
+  Replay replay;
+
+  /// The events of the report being decoded.
+  std::vector<input_event> buffer;
+};
+
+std::string
+getRecordingPath(const std::string& dir, const std::string& devicePath) {
+  return std::filesystem::path(dir) /
+         (std::filesystem::path(devicePath).filename().string() +
+          recording_extension);
+}
+
 void
 handeDevice(InputManager& mgr, udev_device& dev) {
   const auto* devnode = udev_device_get_devnode(&dev);
@@ -324,11 +622,18 @@ InputDeviceBase::EvDevDeleter::operator()(libevdev* evdev) {
 
 const char*
 InputDeviceBase::getName() const {
+  // Replayed devices have no evdev.
+  if (evdev == nullptr) {
+    return path.c_str();
+  }
   return libevdev_get_name(evdev.get());
 }
 
 void
 InputDeviceBase::grab() const {
+  if (evdev == nullptr) {
+    return;
+  }
   int res = libevdev_grab(evdev.get(), LIBEVDEV_GRAB);
   if (res < 0) {
     std::cerr << "Grab failed: " << strerror(-res) << "\n";
@@ -337,9 +642,208 @@ InputDeviceBase::grab() const {
 
 void
 InputDeviceBase::ungrab() const {
+  if (evdev == nullptr) {
+    return;
+  }
   libevdev_grab(evdev.get(), LIBEVDEV_UNGRAB);
 }
 
+OptError<>
+InputDeviceBase::startRecording(const std::string& file) {
+  auto header = getRecordingHeader();
+  header.eventSize = sizeof(input_event);
+  header.startTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                       EventClock::now().time_since_epoch())
+                       .count();
+
+  auto out = TRY(unistdpp::create(file.c_str(),
+                                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                  recording_mode));
+  TRY(out.writeAll(header));
+  recording = std::move(out);
+  return {};
+}
+
+struct InputManager::Thread {
+  EventQueue queue;
+
+  /// Written by the input thread when it queued events.
+  unistdpp::FD wakeFd;
+
+  /// Written by the UI thread to stop the input thread, or when the devices
+  /// changed.
+  unistdpp::FD controlFd;
+
+  /// Guards the devices, and the devices of the input manager while the
+  /// input thread reads them.
+  std::mutex mutex;
+  std::vector<InputDeviceBase*> devices;
+  bool devicesChanged = true;
+
+  std::atomic<bool> stopping = false;
+  std::thread thread;
+
+  Thread() = default;
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+
+  ~Thread() {
+    stopping = true;
+    wake();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  void wake() const { (void)controlFd.writeAll(uint64_t(1)); }
+
+  void run() {
+    // Only used by the input thread.
+    std::vector<InputDeviceBase*> order;
+    std::vector<pollfd> pollFds;
+    EventRing ring;
+
+    while (!stopping) {
+      {
+        std::lock_guard lock(mutex);
+        if (devicesChanged) {
+          order = devices;
+          devicesChanged = false;
+        }
+      }
+
+      pollFds.clear();
+      pollFds.emplace_back(unistdpp::waitFor(controlFd, unistdpp::Wait::Read));
+      for (const auto* device : order) {
+        pollFds.emplace_back(
+          unistdpp::waitFor(device->fd, unistdpp::Wait::Read));
+      }
+
+      if (auto res = unistdpp::poll(pollFds); !res.has_value()) {
+        if (res.error() != std::errc::interrupted) {
+          std::cerr << "Input thread poll: " << unistdpp::to_string(res.error())
+                    << "\n";
+        }
+        continue;
+      }
+
+      if (unistdpp::canRead(pollFds.front())) {
+        (void)controlFd.readAll<uint64_t>();
+        continue;
+      }
+
+      {
+        std::lock_guard lock(mutex);
+
+        // The ready devices may be gone.
+        if (devicesChanged) {
+          continue;
+        }
+
+        for (std::size_t i = 0; i < order.size(); i++) {
+          if (!unistdpp::canRead(pollFds[i + 1])) {
+            continue;
+          }
+          if (auto err = order[i]->readEvents(ring); !err.has_value()) {
+            std::cerr << "Input thread: " << err.error().msg << "\n";
+          }
+        }
+      }
+
+      if (ring.empty()) {
+        continue;
+      }
+
+      const auto now = EventQueue::Clock::now();
+      while (!ring.empty()) {
+        queue.push(ring.pop(), now);
+      }
+      (void)wakeFd.writeAll(uint64_t(1));
+    }
+  }
+};
+
+InputManager::InputManager() = default;
+InputManager::~InputManager() = default;
+InputManager::InputManager(InputManager&& other) noexcept = default;
+InputManager&
+InputManager::operator=(InputManager&& other) noexcept = default;
+
+OptError<>
+InputManager::startThread() {
+  if (thread != nullptr) {
+    return {};
+  }
+
+  constexpr auto flags = EFD_CLOEXEC | EFD_NONBLOCK;
+  auto newThread = std::make_unique<Thread>();
+  newThread->wakeFd = TRY(unistdpp::eventfd(0, flags));
+  newThread->controlFd = TRY(unistdpp::eventfd(0, flags));
+  for (auto& [_, device] : devices) {
+    (void)_;
+    newThread->devices.emplace_back(device.get());
+  }
+
+  newThread->thread = std::thread([t = newThread.get()] { t->run(); });
+  thread = std::move(newThread);
+  return {};
+}
+
+void
+InputManager::stopThread() {
+  thread.reset();
+  devicesChanged = true;
+}
+
+std::unique_lock<std::mutex>
+InputManager::lockDevices() {
+  if (thread == nullptr) {
+    return {};
+  }
+  return std::unique_lock(thread->mutex);
+}
+
+void
+InputManager::markDevicesChanged() {
+  devicesChanged = true;
+  if (thread == nullptr) {
+    return;
+  }
+
+  thread->devices.clear();
+  for (auto& [_, device] : devices) {
+    (void)_;
+    thread->devices.emplace_back(device.get());
+  }
+  thread->devicesChanged = true;
+  thread->wake();
+}
+
+void
+InputManager::takeEvents(EventRing& out) {
+  const auto now = EventQueue::Clock::now();
+  stats.maxQueueDepth = std::max(stats.maxQueueDepth, thread->queue.size());
+
+  // Leave what doesn't fit in the queue, instead of dropping the oldest.
+  while (!out.full()) {
+    auto entry = thread->queue.pop();
+    if (!entry.has_value()) {
+      break;
+    }
+
+    const auto latency =
+      std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                            entry->readTime);
+    stats.events++;
+    stats.totalLatency += latency;
+    stats.maxLatency = std::max(stats.maxLatency, latency);
+
+    out.push(entry->event);
+  }
+
+  stats.dropped = thread->queue.dropped();
+}
+
 ErrorOr<InputDeviceBase*>
 InputManager::open(std::string_view input) {
   if (auto it = devices.find(input); it != devices.end()) {
@@ -357,6 +861,11 @@ InputManager::open(std::string_view input) {
     return InputDeviceBase::EvDevPtr(dev);
   }());
 
+  // Timestamps on the clock of EventClock, instead of the wall clock.
+  if (libevdev_set_clock_id(dev.get(), CLOCK_MONOTONIC) != 0) {
+    std::cerr << "No monotonic timestamps for '" << input << "'\n";
+  }
+
   auto base = device::getBaseDevice(libevdev_get_name(dev.get()));
   auto baseTransform = [&]() -> Transform {
     if (!base) {
@@ -370,8 +879,20 @@ InputManager::open(std::string_view input) {
   auto* devicePtr = device.get();
 
   std::cout << "Got device: " << device->getName() << "\n";
+  if (!recordDir.empty()) {
+    if (auto err =
+          device->startRecording(getRecordingPath(recordDir, device->path));
+        !err.has_value()) {
+      std::cerr << err.error().msg << "\n";
+    }
+  }
+
   auto* devPtr = device.get();
-  devices.emplace(devicePtr->path, std::move(device));
+  {
+    auto lock = lockDevices();
+    devices.emplace(devicePtr->path, std::move(device));
+    markDevicesChanged();
+  }
 
   if (base) {
     switch (base->type) {
@@ -444,30 +965,134 @@ InputManager::openAll(bool monitor) {
   return baseDevices;
 }
 
-ErrorOr<std::vector<Event>>
-InputManager::waitForInput(std::vector<pollfd>& extraFds,
-                           std::optional<std::chrono::milliseconds> timeout) {
-  const auto inputFdsSize = extraFds.size();
-
-  std::vector<InputDeviceBase*> deviceOrder;
+OptError<>
+InputManager::startRecording(std::string dir) {
+  auto lock = lockDevices();
   for (auto& [_, device] : devices) {
-    (void)_;
-    deviceOrder.emplace_back(device.get());
-    extraFds.emplace_back(unistdpp::waitFor(device->fd, unistdpp::Wait::Read));
+    TRY(device->startRecording(getRecordingPath(dir, device->path)));
+  }
+  recordDir = std::move(dir);
+  return {};
+}
+
+ErrorOr<BaseDevices>
+InputManager::openReplay(std::string_view dir, ReplaySpeed speed) {
+  std::vector<std::filesystem::path> files;
+  std::error_code err;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, err)) {
+    if (entry.path().extension() == recording_extension) {
+      files.emplace_back(entry.path());
+    }
+  }
+  if (err) {
+    return Error::make("Opening '" + std::string(dir) + "': " + err.message());
+  }
+  std::sort(files.begin(), files.end());
+
+  for (const auto& file : files) {
+    auto recording = TRY(readRecording(file));
+    const auto kind = recording.header.kind;
+
+    auto timer = TRY(unistdpp::timerfd_create(
+      CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)); // NOLINT
+    auto device = std::make_unique<ReplayDevice>(
+      std::move(timer), file.string(), std::move(recording), speed);
+    TRY(device->arm());
+
+    auto*& base = [&]() -> InputDeviceBase*& {
+      switch (kind) {
+        case RecordingHeader::Touch:
+          return baseDevices.touch;
+        case RecordingHeader::Pen:
+          return baseDevices.pen;
+        case RecordingHeader::Key:
+          break;
+      }
+      return baseDevices.key;
+    }();
+    if (base == nullptr) {
+      base = device.get();
+    }
+
+    std::cout << "Replaying: " << file.string() << "\n";
+    auto lock = lockDevices();
+    devices.emplace(device->path, std::move(device));
+    markDevicesChanged();
   }
 
+  return baseDevices;
+}
+
+bool
+InputManager::isReplaying() {
+  auto lock = lockDevices();
+  return std::any_of(devices.begin(), devices.end(), [](const auto& device) {
+    return device.second->isReplaying();
+  });
+}
+
+OptError<>
+InputManager::waitForInput(EventRing& out,
+                           std::vector<pollfd>& extraFds,
+                           std::optional<std::chrono::milliseconds> timeout) {
+  if (devicesChanged && thread == nullptr) {
+    deviceOrder.clear();
+    for (auto& [_, device] : devices) {
+      (void)_;
+      deviceOrder.emplace_back(device.get());
+    }
+    devicesChanged = false;
+  }
+
+  // The extra fds, followed by the devices or the wake fd of the input
+  // thread, and the udev monitor.
+  pollFds.assign(extraFds.begin(), extraFds.end());
+  if (thread != nullptr) {
+    pollFds.emplace_back(
+      unistdpp::waitFor(thread->wakeFd, unistdpp::Wait::Read));
+
+    // Don't wait for more if the last events didn't fit the ring.
+    if (!thread->queue.empty()) {
+      timeout = std::chrono::milliseconds(0);
+    }
+  } else {
+    for (const auto* device : deviceOrder) {
+      pollFds.emplace_back(
+        unistdpp::waitFor(device->fd, unistdpp::Wait::Read));
+    }
+  }
   if (udevMonitorFd.isValid()) {
-    extraFds.emplace_back(
+    pollFds.emplace_back(
       unistdpp::waitFor(udevMonitorFd, unistdpp::Wait::Read));
   }
 
-  auto ret = TRY(unistdpp::poll(extraFds, timeout));
+  auto ret = TRY(unistdpp::poll(pollFds, timeout));
+  for (std::size_t i = 0; i < extraFds.size(); i++) {
+    extraFds[i].revents = pollFds[i].revents;
+  }
+
+  if (thread != nullptr) {
+    if (unistdpp::canRead(pollFds[extraFds.size()])) {
+      (void)thread->wakeFd.readAll<uint64_t>();
+    }
+    takeEvents(out);
+  }
+
   if (ret == 0) {
     // timeout
-    return std::vector<Event>{};
+    return {};
+  }
+
+  if (thread == nullptr) {
+    for (std::size_t i = 0; i < deviceOrder.size(); i++) {
+      if (unistdpp::canRead(pollFds[i + extraFds.size()])) {
+        TRY(deviceOrder[i]->readEvents(out));
+      }
+    }
   }
 
-  if (udevMonitorFd.isValid() && unistdpp::canRead(extraFds.back())) {
+  // Last, as it can remove devices.
+  if (udevMonitorFd.isValid() && unistdpp::canRead(pollFds.back())) {
     udev_device* dev = udev_monitor_receive_device(udevMonitor.get());
     if (dev != nullptr) {
       handeDevice(*this, *dev);
@@ -475,17 +1100,6 @@ InputManager::waitForInput(std::vector<pollfd>& extraFds,
     }
   }
 
-  // Return the first device we see.
-  std::vector<Event> result;
-  for (std::size_t i = 0; i < deviceOrder.size(); i++) {
-    auto& device = *deviceOrder[i];
-    if (unistdpp::canRead(extraFds[i + inputFdsSize])) {
-      TRY(device.readEvents(result));
-    }
-  }
-
-  extraFds.resize(inputFdsSize);
-
-  return result;
+  return {};
 }
 } // namespace rmlib::input
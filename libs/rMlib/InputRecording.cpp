@@ -0,0 +1,106 @@
+#include "Input.h"
+
+#include <unistdpp/file.h>
+
+#include <cstring>
+#include <string_view>
+
+namespace rmlib::input {
+
+namespace {
+
+constexpr auto usec_per_sec = 1000000;
+
+/// The layout of `input_event` on 32 and 64 bit systems.
+template<typename Time>
+struct RawEvent {
+  Time sec;
+  Time usec;
+  uint16_t type;
+  uint16_t code;
+  int32_t value;
+};
+
+template<typename Time>
+std::vector<RecordedEvent>
+parseEvents(std::string_view data) {
+  std::vector<RecordedEvent> events(data.size() / sizeof(RawEvent<Time>));
+  for (size_t i = 0; i < events.size(); i++) {
+    RawEvent<Time> raw{};
+    memcpy(&raw, &data[i * sizeof(raw)], sizeof(raw));
+
+    auto& event = events[i];
+    event.sec = raw.sec;
+    event.usec = raw.usec;
+    event.type = raw.type;
+    event.code = raw.code;
+    event.value = raw.value;
+  }
+  return events;
+}
+
+} // namespace
+
+EventClock::time_point
+RecordedEvent::getTime() const {
+  return EventClock::time_point(std::chrono::seconds(sec) +
+                                std::chrono::microseconds(usec));
+}
+
+void
+RecordedEvent::setTime(EventClock::time_point time) {
+  const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    time.time_since_epoch())
+                    .count();
+  sec = us / usec_per_sec;
+  usec = us % usec_per_sec;
+}
+
+ErrorOr<Recording>
+readRecording(const std::string& path) {
+  const auto data = TRY(unistdpp::readFile(path));
+
+  Recording recording;
+  if (data.size() < sizeof(RecordingHeader)) {
+    return Error::make("Truncated recording: " + path);
+  }
+  memcpy(&recording.header, data.data(), sizeof(RecordingHeader));
+  if (recording.header.magic != RecordingHeader::magic_value) {
+    return Error::make("Not a recording: " + path);
+  }
+
+  const auto events = std::string_view(data).substr(sizeof(RecordingHeader));
+  switch (recording.header.eventSize) {
+    case sizeof(RawEvent<uint32_t>):
+      recording.events = parseEvents<uint32_t>(events);
+      break;
+    case sizeof(RawEvent<int64_t>):
+      recording.events = parseEvents<int64_t>(events);
+      break;
+    default:
+      return Error::make("Unknown event size in recording: " + path);
+  }
+  return recording;
+}
+
+Replay::Replay(Recording recording,
+               ReplaySpeed speed,
+               EventClock::time_point start)
+  : events(std::move(recording.events)), speed(speed) {
+  const auto recordStart = EventClock::time_point(
+    std::chrono::microseconds(recording.header.startTime));
+  for (auto& event : events) {
+    const auto offset = event.getTime() - recordStart;
+    event.setTime(start + std::max(offset, EventClock::duration(0)));
+  }
+}
+
+std::optional<EventClock::time_point>
+Replay::getNextTime() const {
+  if (isDone()) {
+    return std::nullopt;
+  }
+  return events[nextEvent].getTime();
+}
+
+} // namespace rmlib::input
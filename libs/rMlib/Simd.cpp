@@ -0,0 +1,377 @@
+#include "Simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RMLIB_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define RMLIB_SSE2
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#endif
+
+namespace rmlib::simd {
+
+namespace {
+
+constexpr uint16_t
+greyToRGB565(int grey) {
+  // NOLINTNEXTLINE
+  return (grey >> 3) | ((grey >> 2) << 5) | ((grey >> 3) << 11);
+}
+
+/// Writes the transpose of the 8x8 block, so `dst[j][i] = src[i][j]`.
+void
+transpose8x8(const uint16_t* src,
+             std::ptrdiff_t srcStride,
+             uint16_t* dst,
+             std::ptrdiff_t dstStride) {
+#if defined(RMLIB_NEON)
+  const auto row = [&](int i) { return vld1q_u16(src + i * srcStride); };
+  const auto t01 = vtrnq_u16(row(0), row(1));
+  const auto t23 = vtrnq_u16(row(2), row(3));
+  const auto t45 = vtrnq_u16(row(4), row(5));
+  const auto t67 = vtrnq_u16(row(6), row(7));
+
+  const auto trn32 = [](uint16x8_t a, uint16x8_t b) {
+    return vtrnq_u32(vreinterpretq_u32_u16(a), vreinterpretq_u32_u16(b));
+  };
+  const auto u02 = trn32(t01.val[0], t23.val[0]);
+  const auto u13 = trn32(t01.val[1], t23.val[1]);
+  const auto u46 = trn32(t45.val[0], t67.val[0]);
+  const auto u57 = trn32(t45.val[1], t67.val[1]);
+
+  const auto store = [&](int j, uint32x4_t a, uint32x4_t b, bool high) {
+    const auto a16 = vreinterpretq_u16_u32(a);
+    const auto b16 = vreinterpretq_u16_u32(b);
+    vst1q_u16(dst + j * dstStride,
+              high ? vcombine_u16(vget_high_u16(a16), vget_high_u16(b16))
+                   : vcombine_u16(vget_low_u16(a16), vget_low_u16(b16)));
+  };
+  store(0, u02.val[0], u46.val[0], false);
+  store(1, u13.val[0], u57.val[0], false);
+  store(2, u02.val[1], u46.val[1], false);
+  store(3, u13.val[1], u57.val[1], false);
+  store(4, u02.val[0], u46.val[0], true);
+  store(5, u13.val[0], u57.val[0], true);
+  store(6, u02.val[1], u46.val[1], true);
+  store(7, u13.val[1], u57.val[1], true);
+#elif defined(RMLIB_SSE2)
+  const auto row = [&](int i) {
+    return _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(src + i * srcStride)); // NOLINT
+  };
+  const auto t0 = _mm_unpacklo_epi16(row(0), row(1));
+  const auto t1 = _mm_unpackhi_epi16(row(0), row(1));
+  const auto t2 = _mm_unpacklo_epi16(row(2), row(3));
+  const auto t3 = _mm_unpackhi_epi16(row(2), row(3));
+  const auto t4 = _mm_unpacklo_epi16(row(4), row(5));
+  const auto t5 = _mm_unpackhi_epi16(row(4), row(5));
+  const auto t6 = _mm_unpacklo_epi16(row(6), row(7));
+  const auto t7 = _mm_unpackhi_epi16(row(6), row(7));
+
+  const auto u0 = _mm_unpacklo_epi32(t0, t2);
+  const auto u1 = _mm_unpackhi_epi32(t0, t2);
+  const auto u2 = _mm_unpacklo_epi32(t1, t3);
+  const auto u3 = _mm_unpackhi_epi32(t1, t3);
+  const auto u4 = _mm_unpacklo_epi32(t4, t6);
+  const auto u5 = _mm_unpackhi_epi32(t4, t6);
+  const auto u6 = _mm_unpacklo_epi32(t5, t7);
+  const auto u7 = _mm_unpackhi_epi32(t5, t7);
+
+  const auto store = [&](int j, __m128i value) {
+    auto* row = reinterpret_cast<__m128i*>(dst + j * dstStride); // NOLINT
+    _mm_storeu_si128(row, value);
+  };
+  store(0, _mm_unpacklo_epi64(u0, u4));
+  store(1, _mm_unpackhi_epi64(u0, u4));
+  store(2, _mm_unpacklo_epi64(u1, u5));
+  store(3, _mm_unpackhi_epi64(u1, u5));
+  store(4, _mm_unpacklo_epi64(u2, u6));
+  store(5, _mm_unpackhi_epi64(u2, u6));
+  store(6, _mm_unpacklo_epi64(u3, u7));
+  store(7, _mm_unpackhi_epi64(u3, u7));
+#else
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 8; j++) {
+      dst[j * dstStride + i] = src[i * srcStride + j];
+    }
+  }
+#endif
+}
+
+/// Copies the row in reverse, so `dst[-x] = src[x]`.
+void
+copyReversed(uint16_t* dst, const uint16_t* src, int count) {
+  int x = 0;
+#if defined(RMLIB_NEON)
+  for (; x + 8 <= count; x += 8) {
+    const auto rev = vrev64q_u16(vld1q_u16(src + x));
+    vst1q_u16(dst - x - 7,
+              vcombine_u16(vget_high_u16(rev), vget_low_u16(rev)));
+  }
+#elif defined(RMLIB_SSE2)
+  for (; x + 8 <= count; x += 8) {
+    auto value =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)); // NOLINT
+    value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    value = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst - x - 7), // NOLINT
+                     value);
+  }
+#endif
+  for (; x < count; x++) {
+    dst[-x] = src[x];
+  }
+}
+
+} // namespace
+
+void
+fill(uint16_t* dst, size_t count, uint16_t value) {
+  size_t i = 0;
+#if defined(RMLIB_NEON)
+  const auto values = vdupq_n_u16(value);
+  for (; i + 8 <= count; i += 8) {
+    vst1q_u16(dst + i, values);
+  }
+#elif defined(RMLIB_SSE2)
+#ifdef __AVX2__
+  const auto values256 = _mm256_set1_epi16(static_cast<int16_t>(value));
+  for (; i + 16 <= count; i += 16) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), // NOLINT
+                        values256);
+  }
+#endif
+  const auto values = _mm_set1_epi16(static_cast<int16_t>(value));
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), values); // NOLINT
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = value;
+  }
+}
+
+void
+blendCoverage(uint16_t* dst,
+              const uint8_t* coverage,
+              size_t count,
+              uint8_t fg,
+              uint8_t bg) {
+  // bg + t * (fg - bg) / 255, with the division rounding towards zero. So
+  // blend the absolute difference, and add or subtract it.
+  const bool negative = fg < bg;
+  const int diff = negative ? bg - fg : fg - bg;
+
+  size_t i = 0;
+#if defined(RMLIB_NEON)
+  const auto bgs = vdupq_n_u16(bg);
+  const auto ones = vdupq_n_u16(1);
+  for (; i + 8 <= count; i += 8) {
+    const auto x = vmulq_n_u16(vmovl_u8(vld1_u8(coverage + i)), diff);
+    const auto q =
+      vshrq_n_u16(vaddq_u16(vaddq_u16(x, ones), vshrq_n_u16(x, 8)), 8);
+    const auto grey = negative ? vsubq_u16(bgs, q) : vaddq_u16(bgs, q);
+
+    const auto r5 = vshrq_n_u16(grey, 3);
+    const auto g6 = vshrq_n_u16(grey, 2);
+    const auto rgb =
+      vorrq_u16(vorrq_u16(r5, vshlq_n_u16(g6, 5)), vshlq_n_u16(r5, 11));
+    vst1q_u16(dst + i, rgb);
+  }
+#elif defined(RMLIB_SSE2)
+  const auto zero = _mm_setzero_si128();
+  const auto bgs = _mm_set1_epi16(bg);
+  const auto diffs = _mm_set1_epi16(static_cast<int16_t>(diff));
+  const auto ones = _mm_set1_epi16(1);
+  for (; i + 8 <= count; i += 8) {
+    const auto* src = reinterpret_cast<const __m128i*>(coverage + i); // NOLINT
+    const auto t = _mm_unpacklo_epi8(_mm_loadl_epi64(src), zero);
+    const auto x = _mm_mullo_epi16(t, diffs);
+    const auto q = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(x, ones), _mm_srli_epi16(x, 8)), 8);
+    const auto grey =
+      negative ? _mm_sub_epi16(bgs, q) : _mm_add_epi16(bgs, q);
+
+    const auto r5 = _mm_srli_epi16(grey, 3);
+    const auto g6 = _mm_srli_epi16(grey, 2);
+    const auto rgb = _mm_or_si128(
+      _mm_or_si128(r5, _mm_slli_epi16(g6, 5)), _mm_slli_epi16(r5, 11));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), rgb); // NOLINT
+  }
+#endif
+  for (; i < count; i++) {
+    const auto q = div255(coverage[i] * diff);
+    dst[i] = greyToRGB565(negative ? bg - q : bg + q);
+  }
+}
+
+void
+quantize(uint16_t* dst, size_t count, const uint16_t* bias, int levels) {
+  assert(levels >= 2 && 255 % (levels - 1) == 0);
+  const int maxLevel = levels - 1;
+  const int step = 255 / maxLevel;
+
+  size_t i = 0;
+#if defined(RMLIB_NEON)
+  const auto biases = vld1q_u16(bias);
+  const auto ones = vdupq_n_u16(1);
+  const auto greenMask = vdupq_n_u16(0x3f);
+  for (; i + 8 <= count; i += 8) {
+    const auto grey =
+      vshlq_n_u16(vandq_u16(vshrq_n_u16(vld1q_u16(dst + i), 5), greenMask), 2);
+    const auto x = vmlaq_n_u16(biases, grey, maxLevel);
+    const auto level =
+      vshrq_n_u16(vaddq_u16(vaddq_u16(x, ones), vshrq_n_u16(x, 8)), 8);
+    const auto result = vmulq_n_u16(level, step);
+
+    const auto r5 = vshrq_n_u16(result, 3);
+    const auto g6 = vshrq_n_u16(result, 2);
+    const auto rgb =
+      vorrq_u16(vorrq_u16(r5, vshlq_n_u16(g6, 5)), vshlq_n_u16(r5, 11));
+    vst1q_u16(dst + i, rgb);
+  }
+#elif defined(RMLIB_SSE2)
+  const auto biases =
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias)); // NOLINT
+  const auto maxLevels = _mm_set1_epi16(static_cast<int16_t>(maxLevel));
+  const auto steps = _mm_set1_epi16(static_cast<int16_t>(step));
+  const auto ones = _mm_set1_epi16(1);
+  const auto greenMask = _mm_set1_epi16(0x3f);
+  for (; i + 8 <= count; i += 8) {
+    auto* ptr = reinterpret_cast<__m128i*>(dst + i); // NOLINT
+    const auto grey = _mm_slli_epi16(
+      _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128(ptr), 5), greenMask), 2);
+    const auto x = _mm_add_epi16(_mm_mullo_epi16(grey, maxLevels), biases);
+    const auto level = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(x, ones), _mm_srli_epi16(x, 8)), 8);
+    const auto result = _mm_mullo_epi16(level, steps);
+
+    const auto r5 = _mm_srli_epi16(result, 3);
+    const auto g6 = _mm_srli_epi16(result, 2);
+    const auto rgb = _mm_or_si128(
+      _mm_or_si128(r5, _mm_slli_epi16(g6, 5)), _mm_slli_epi16(r5, 11));
+    _mm_storeu_si128(ptr, rgb);
+  }
+#endif
+  for (; i < count; i++) {
+    const int grey = ((dst[i] >> 5) & 0x3f) << 2; // NOLINT
+    const auto level = div255(grey * maxLevel + bias[i % 8]);
+    dst[i] = greyToRGB565(level * step);
+  }
+}
+
+size_t
+compare(const uint16_t* a, const uint16_t* b, size_t count) {
+  size_t i = 0;
+#if defined(RMLIB_NEON)
+  for (; i + 8 <= count; i += 8) {
+    const auto eq = vceqq_u16(vld1q_u16(a + i), vld1q_u16(b + i));
+    const auto eq64 = vreinterpret_u64_u16(
+      vand_u16(vget_low_u16(eq), vget_high_u16(eq)));
+    if (vget_lane_u64(eq64, 0) != ~uint64_t(0)) {
+      break;
+    }
+  }
+#elif defined(RMLIB_SSE2)
+#ifdef __AVX2__
+  for (; i + 16 <= count; i += 16) {
+    const auto eq = _mm256_cmpeq_epi16(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),  // NOLINT
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))); // NOLINT
+    if (static_cast<uint32_t>(_mm256_movemask_epi8(eq)) != ~uint32_t(0)) {
+      break;
+    }
+  }
+#endif
+  for (; i + 8 <= count; i += 8) {
+    const auto eq = _mm_cmpeq_epi16(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),  // NOLINT
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))); // NOLINT
+    if (_mm_movemask_epi8(eq) != 0xffff) { // NOLINT
+      break;
+    }
+  }
+#endif
+  // Find the exact pixel in the block that differs.
+  for (; i < count; i++) {
+    if (a[i] != b[i]) {
+      return i;
+    }
+  }
+  return count;
+}
+
+void
+copyStrided(uint16_t* dst,
+            std::ptrdiff_t dstXStep,
+            std::ptrdiff_t dstYStep,
+            const uint16_t* src,
+            std::ptrdiff_t srcStride,
+            int width,
+            int height) {
+  if (dstXStep == 1 || dstXStep == -1) {
+    for (int y = 0; y < height; y++) {
+      auto* dstRow = dst + y * dstYStep;
+      const auto* srcRow = src + y * srcStride;
+      if (dstXStep == 1) {
+        memcpy(dstRow, srcRow, width * sizeof(uint16_t));
+      } else {
+        copyReversed(dstRow, srcRow, width);
+      }
+    }
+    return;
+  }
+
+  assert(dstYStep == 1 || dstYStep == -1);
+
+  // Transpose in 8x8 blocks. Mirroring the rows is done by reading the
+  // source rows from the bottom.
+  constexpr int block = 8;
+  const int blockWidth = width - (width % block);
+  const int blockHeight = height - (height % block);
+  const auto copyBlock = [&](int x, int y) {
+    if (dstYStep == 1) {
+      transpose8x8(
+        src + y * srcStride + x, srcStride, dst + x * dstXStep + y, dstXStep);
+    } else {
+      transpose8x8(src + (y + block - 1) * srcStride + x,
+                   -srcStride,
+                   dst + x * dstXStep - (y + block - 1),
+                   dstXStep);
+    }
+  };
+
+  // The blocks are visited in tiles, so the source and destination lines of a
+  // tile stay in the cache. Otherwise each band of source rows touches a
+  // destination line per pixel.
+  constexpr int tile = 32;
+  for (int tileY = 0; tileY < blockHeight; tileY += tile) {
+    const int tileYEnd = std::min(tileY + tile, blockHeight);
+    for (int tileX = 0; tileX < blockWidth; tileX += tile) {
+      const int tileXEnd = std::min(tileX + tile, blockWidth);
+      for (int y = tileY; y < tileYEnd; y += block) {
+        for (int x = tileX; x < tileXEnd; x += block) {
+          copyBlock(x, y);
+        }
+      }
+    }
+  }
+
+  // The edges that don't fill a block.
+  for (int y = 0; y < height; y++) {
+    for (int x = y < blockHeight ? blockWidth : 0; x < width; x++) {
+      dst[x * dstXStep + y * dstYStep] = src[y * srcStride + x];
+    }
+  }
+}
+
+} // namespace rmlib::simd
+
@@ -0,0 +1,323 @@
+#include "StrokeRasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace rmlib {
+
+namespace {
+
+struct Vec {
+  float x;
+  float y;
+};
+
+constexpr Vec
+operator-(Vec a, Vec b) {
+  return { a.x - b.x, a.y - b.y };
+}
+
+constexpr float
+dot(Vec a, Vec b) {
+  return a.x * b.x + a.y * b.y;
+}
+
+constexpr uint8_t
+blend(uint8_t factor, uint8_t fg, uint8_t bg) {
+  if (fg < bg) {
+    return bg - simd::div255(int(factor) * (bg - fg));
+  }
+  return bg + simd::div255(int(factor) * (fg - bg));
+}
+
+/// The convex hull of two discs, the swept area of a pen moving from `a` to
+/// `b` while its radius changes from `ra` to `rb`.
+struct Capsule {
+  Vec a;
+  Vec b;
+  float ra;
+  float rb;
+
+  Capsule(Vec a, Vec b, float ra, float rb) : a(a), b(b), ra(ra), rb(rb) {
+    // When one disc contains the other the hull is the larger disc.
+    const auto d = b - a;
+    const auto len = std::sqrt(dot(d, d));
+    if (len <= std::abs(ra - rb)) {
+      if (ra < rb) {
+        this->a = b;
+        this->ra = rb;
+      }
+      this->b = this->a;
+      this->rb = this->ra;
+    }
+  }
+
+  bool isDisk() const { return a.x == b.x && a.y == b.y; }
+
+  /// \returns The signed distance of the point to the edge, negative inside.
+  float distance(Vec p) const {
+    if (isDisk()) {
+      const auto d = p - a;
+      return std::sqrt(dot(d, d)) - ra;
+    }
+
+    // In the frame of the segment, mirrored so the point is on one side.
+    const auto pb = b - a;
+    const auto pa = p - a;
+    const auto h = dot(pb, pb);
+    const auto qx = std::abs(pa.x * pb.y - pa.y * pb.x) / h;
+    const auto qy = dot(pa, pb) / h;
+
+    // The direction of the tangent line, scaled like q.
+    const auto dr = ra - rb;
+    const auto cx = std::sqrt(h - dr * dr);
+    const auto cy = dr;
+
+    const auto k = cx * qy - cy * qx;
+    const auto n = qx * qx + qy * qy;
+    if (k < 0) {
+      return std::sqrt(h * n) - ra;
+    }
+    if (k > cx) {
+      return std::sqrt(h * (n + 1 - 2 * qy)) - rb;
+    }
+    return cx * qx + cy * qy - ra;
+  }
+};
+
+/// Finds the span of a grown capsule on each scanline. The hull is the union
+/// of both discs and the quad between their tangent points, all convex, so
+/// the span is the extent of the three intersections.
+class SpanFinder {
+public:
+  SpanFinder(const Capsule& capsule, float grow)
+    : a(capsule.a)
+    , b(capsule.b)
+    , ra(capsule.ra + grow)
+    , rb(capsule.rb + grow)
+    , hasQuad(!capsule.isDisk()) {
+    if (!hasQuad) {
+      return;
+    }
+
+    const auto d = b - a;
+    const auto len = std::sqrt(dot(d, d));
+    const auto dir = Vec{ d.x / len, d.y / len };
+    const auto sin = (capsule.ra - capsule.rb) / len;
+    const auto cos = std::sqrt(std::max(0.0F, 1 - sin * sin));
+
+    // The tangent points on both sides, at the same angle on each disc.
+    const auto left =
+      Vec{ dir.x * sin - dir.y * cos, dir.y * sin + dir.x * cos };
+    const auto right =
+      Vec{ dir.x * sin + dir.y * cos, dir.y * sin - dir.x * cos };
+    quad = { Vec{ a.x + ra * left.x, a.y + ra * left.y },
+             Vec{ b.x + rb * left.x, b.y + rb * left.y },
+             Vec{ b.x + rb * right.x, b.y + rb * right.y },
+             Vec{ a.x + ra * right.x, a.y + ra * right.y } };
+  }
+
+  bool empty() const { return ra < 0 || rb < 0; }
+
+  float top() const { return std::min(a.y - ra, b.y - rb); }
+  float bottom() const { return std::max(a.y + ra, b.y + rb); }
+
+  /// \returns The first and last pixel of the span on the row, the first is
+  /// larger when the row doesn't cross the capsule.
+  std::pair<int, int> span(float y) const {
+    auto lo = std::numeric_limits<float>::max();
+    auto hi = std::numeric_limits<float>::lowest();
+
+    const auto addDisk = [&](Vec c, float r) {
+      const auto dy = y - c.y;
+      const auto w2 = r * r - dy * dy;
+      if (w2 >= 0) {
+        const auto w = std::sqrt(w2);
+        lo = std::min(lo, c.x - w);
+        hi = std::max(hi, c.x + w);
+      }
+    };
+    addDisk(a, ra);
+    addDisk(b, rb);
+
+    if (hasQuad) {
+      for (size_t i = 0; i < quad.size(); i++) {
+        const auto& p = quad[i];
+        const auto& q = quad[(i + 1) % quad.size()];
+        if ((p.y - y) * (q.y - y) > 0 || p.y == q.y) {
+          continue;
+        }
+        const auto x = p.x + (y - p.y) * (q.x - p.x) / (q.y - p.y);
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+      }
+    }
+
+    if (lo > hi) {
+      return { 0, -1 };
+    }
+    return { int(std::ceil(lo)), int(std::floor(hi)) };
+  }
+
+private:
+  Vec a;
+  Vec b;
+  float ra;
+  float rb;
+
+  bool hasQuad;
+  std::array<Vec, 4> quad;
+};
+
+/// Pixel centers are at integer coordinates, like \ref Canvas::drawDisk.
+/// With anti-aliasing a pixel is covered by `0.5 - distance`, so the fully
+/// covered pixels are the capsule shrunk by half a pixel and the touched
+/// ones the capsule grown by half a pixel. Only the pixels in between are
+/// blended.
+///
+/// The `joint` is the disc already drawn by the previous segment. Its edge
+/// pixels are only blended by the coverage it lacks, so the joint isn't
+/// darker than the rest of the stroke.
+template<typename View>
+Rect
+drawCapsule(const View& view,
+            const Capsule& capsule,
+            const std::optional<Capsule>& joint,
+            uint16_t color,
+            uint8_t grey,
+            bool antiAlias) {
+  constexpr auto aa_margin = 0.5F;
+
+  const auto outer = SpanFinder(capsule, antiAlias ? aa_margin : 0);
+  const auto inner = SpanFinder(capsule, antiAlias ? -aa_margin : 0);
+  const auto bounds = view.rect();
+
+  const auto y1 = std::max(bounds.topLeft.y, int(std::ceil(outer.top())));
+  const auto y2 =
+    std::min(bounds.bottomRight.y, int(std::floor(outer.bottom())));
+
+  Rect dirty;
+  const auto markDirty = [&dirty](int x1, int x2, int y) {
+    dirty |= Rect{ { x1, y }, { x2, y } };
+  };
+
+  for (int y = y1; y <= y2; y++) {
+    const auto fy = float(y);
+    auto [xo1, xo2] = outer.span(fy);
+    xo1 = std::max(xo1, bounds.topLeft.x);
+    xo2 = std::min(xo2, bounds.bottomRight.x);
+    if (xo1 > xo2) {
+      continue;
+    }
+
+    if (!antiAlias) {
+      view.set(Rect{ { xo1, y }, { xo2, y } }, color);
+      markDirty(xo1, xo2, y);
+      continue;
+    }
+
+    auto [xi1, xi2] =
+      inner.empty() ? std::pair{ xo2 + 1, xo2 } : inner.span(fy);
+    xi1 = std::max(xi1, xo1);
+    xi2 = std::min(xi2, xo2);
+    if (xi1 > xi2) {
+      // Nothing fully covered, blend the whole span.
+      xi1 = xo2 + 1;
+      xi2 = xo2;
+    }
+
+    auto first = xi1;
+    auto last = xi2;
+    const auto blendEdge = [&](int x) {
+      auto cover =
+        std::min(aa_margin - capsule.distance({ float(x), fy }), 1.0F);
+      if (joint.has_value()) {
+        const auto drawn = std::clamp(
+          aa_margin - joint->distance({ float(x), fy }), 0.0F, 1.0F);
+        if (cover <= drawn) {
+          return;
+        }
+        cover = (cover - drawn) / (1 - drawn);
+      }
+      if (cover <= 0) {
+        return;
+      }
+      const auto factor = uint8_t(std::lround(cover * 255));
+      auto* pixel = view.getPtr(x, y);
+      *pixel = greyToRGB565(blend(factor, grey, greyFromRGB565(*pixel)));
+      first = std::min(first, x);
+      last = std::max(last, x);
+    };
+
+    for (int x = xo1; x < xi1; x++) {
+      blendEdge(x);
+    }
+    if (xi1 <= xi2) {
+      view.set(Rect{ { xi1, y }, { xi2, y } }, color);
+    }
+    for (int x = xi2 + 1; x <= xo2; x++) {
+      blendEdge(x);
+    }
+
+    if (first <= last) {
+      markDirty(first, last, y);
+    }
+  }
+
+  return dirty;
+}
+
+} // namespace
+
+StrokeRasterizer::StrokeRasterizer(uint8_t grey, bool antiAlias)
+  : grey(grey), color(greyToRGB565(grey)), antiAlias(antiAlias) {}
+
+Rect
+StrokeRasterizer::addPoint(Canvas& canvas, StrokePoint point) {
+  const auto result = lastPoint.has_value()
+                        ? draw(canvas, *lastPoint, point, /* joined */ true)
+                        : drawDisk(canvas, point);
+  lastPoint = point;
+  return result;
+}
+
+Rect
+StrokeRasterizer::drawDisk(Canvas& canvas, StrokePoint point) {
+  return drawSegment(canvas, point, point);
+}
+
+Rect
+StrokeRasterizer::drawSegment(Canvas& canvas,
+                              StrokePoint from,
+                              StrokePoint to) {
+  return draw(canvas, from, to, /* joined */ false);
+}
+
+Rect
+StrokeRasterizer::draw(Canvas& canvas,
+                       StrokePoint from,
+                       StrokePoint to,
+                       bool joined) {
+  assert(canvas.components() == 2);
+
+  const auto start = Vec{ from.x, from.y };
+  const auto startRadius = std::max(0.0F, from.width / 2);
+  const auto capsule = Capsule(
+    start, { to.x, to.y }, startRadius, std::max(0.0F, to.width / 2));
+
+  std::optional<Capsule> joint;
+  if (joined) {
+    joint.emplace(start, start, startRadius, startRadius);
+  }
+
+  Rect result;
+  canvas.visitRotation<uint16_t>([&](auto view) {
+    result = drawCapsule(view, capsule, joint, color, grey, antiAlias);
+  });
+  return result;
+}
+
+} // namespace rmlib
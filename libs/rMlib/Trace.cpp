@@ -0,0 +1,229 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace rmlib::trace {
+
+namespace details {
+bool enabled = false; // NOLINT
+} // namespace details
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+  const char* phase;
+  const char* name;
+  int id;
+  const char* reason;
+
+  Clock::time_point start;
+  Clock::duration duration{};
+
+  /// The innermost enclosing event of the same phase, or -1.
+  int parent;
+
+  /// The first object doing work in its subtree, counted in the summary.
+  bool isRoot = false;
+
+  /// Work below a root.
+  bool isCovered = false;
+};
+
+struct Tracer {
+  std::ofstream out;
+  Clock::time_point start;
+  int frame = 0;
+
+  std::vector<Event> events;
+  std::vector<int> openEvents;
+};
+
+std::unique_ptr<Tracer> tracer; // NOLINT
+
+/// Escapes the characters that would end a JSON string.
+void
+writeString(std::ostream& out, const char* str) {
+  out << '"';
+  for (; *str != '\0'; str++) {
+    if (*str == '"' || *str == '\\') {
+      out << '\\';
+    }
+    out << *str;
+  }
+  out << '"';
+}
+
+double
+toMs(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void
+writeEvent(std::ostream& out, const Event& event) {
+  const auto toUs = [](Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+
+  out << "{\"name\":";
+  writeString(out, event.name != nullptr ? event.name : event.phase);
+  out << ",\"cat\":";
+  writeString(out, event.phase);
+  out << ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+      << toUs(event.start - tracer->start)
+      << ",\"dur\":" << toUs(event.duration);
+
+  if (event.name != nullptr) {
+    out << ",\"args\":{\"id\":" << event.id;
+    if (event.reason != nullptr) {
+      out << ",\"reason\":";
+      writeString(out, event.reason);
+    }
+    out << "}";
+  }
+  out << "},\n";
+}
+
+std::string
+summarize(const std::vector<Event>& events, int frame) {
+  // The number of events below each root.
+  std::vector<int> covered(events.size());
+  for (const auto& event : events) {
+    if (!event.isCovered) {
+      continue;
+    }
+    auto root = event.parent;
+    while (!events[root].isRoot) {
+      root = events[root].parent;
+    }
+    covered[root]++;
+  }
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2) << "Frame " << frame << ":";
+  bool hasWork = false;
+  for (const auto& event : events) {
+    if (event.name == nullptr) {
+      out << " " << event.phase << " " << toMs(event.duration) << " ms";
+    }
+    hasWork |= event.isRoot;
+  }
+  if (!hasWork) {
+    return {};
+  }
+  out << "\n";
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const auto& event = events[i];
+    if (!event.isRoot) {
+      continue;
+    }
+    out << "  " << event.phase << " " << event.name << "#" << event.id << " ("
+        << event.reason;
+    if (covered[i] != 0) {
+      out << ", " << covered[i] << " below";
+    }
+    out << ") " << toMs(event.duration) << " ms\n";
+  }
+  return out.str();
+}
+
+} // namespace
+
+namespace details {
+
+int
+begin(const char* phase, const char* name, int id, const char* reason) {
+  auto& events = tracer->events;
+
+  auto parent = -1;
+  for (auto it = tracer->openEvents.rbegin(); it != tracer->openEvents.rend();
+       ++it) {
+    if (std::strcmp(events[*it].phase, phase) == 0) {
+      parent = *it;
+      break;
+    }
+  }
+
+  // Work done because the children need it isn't a reason by itself.
+  const auto hasReason =
+    name != nullptr && reason != nullptr && std::strcmp(reason, "child") != 0;
+  const auto inRoot =
+    parent >= 0 && (events[parent].isRoot || events[parent].isCovered);
+
+  const auto index = int(events.size());
+  auto& event = events.emplace_back(
+    Event{ phase, name, id, reason, Clock::now(), {}, parent });
+  event.isRoot = hasReason && !inRoot;
+  event.isCovered = name != nullptr && inRoot;
+
+  tracer->openEvents.emplace_back(index);
+  return index;
+}
+
+void
+end(int event) {
+  // Stopped while the scope was open.
+  if (tracer == nullptr || size_t(event) >= tracer->events.size()) {
+    return;
+  }
+
+  auto& ev = tracer->events[event];
+  ev.duration = Clock::now() - ev.start;
+  tracer->openEvents.pop_back();
+}
+
+} // namespace details
+
+OptError<>
+start(const char* path) {
+  auto newTracer = std::make_unique<Tracer>();
+  newTracer->out.open(path, std::ios::trunc);
+  if (!newTracer->out.is_open()) {
+    return Error::make(std::string("Opening trace '") + path + "' failed");
+  }
+
+  // The closing bracket is optional, so the trace is valid at any point.
+  newTracer->out << "[\n";
+  newTracer->start = Clock::now();
+
+  tracer = std::move(newTracer);
+  details::enabled = true;
+  return {};
+}
+
+void
+stop() {
+  details::enabled = false;
+  tracer.reset();
+}
+
+std::string
+endFrame() {
+  if (tracer == nullptr) {
+    return {};
+  }
+
+  // Scopes still open are part of the next frame.
+  if (!tracer->openEvents.empty()) {
+    return {};
+  }
+
+  for (const auto& event : tracer->events) {
+    writeEvent(tracer->out, event);
+  }
+  tracer->out.flush();
+
+  auto summary = summarize(tracer->events, tracer->frame++);
+  tracer->events.clear();
+  return summary;
+}
+
+} // namespace rmlib::trace
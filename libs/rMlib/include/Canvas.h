@@ -1,22 +1,31 @@
 #pragma once
 
+#include "Dither.h"
 #include "Error.h"
 #include "MathUtil.h"
+#include "Simd.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <memory>
 #include <optional>
 #include <string_view>
+#include <type_traits>
 
 #include <iostream>
 
+#include <unistdpp/mmap.h>
+
 namespace rmlib {
 namespace fb {
 struct FrameBuffer;
 }
 
+struct GlyphRun;
+
 constexpr auto default_text_size = 48;
 
 constexpr auto white = 0xFFFF;
@@ -43,6 +52,178 @@ greyFromRGB565(uint16_t rgb) {
 bool
 getGlyph(uint32_t code, uint8_t* bitmap, int height, int* width);
 
+/// A view of canvas memory with the pixel type and rotation known at compile
+/// time. Accessing a pixel is a multiply-add, without rotating the point or
+/// switching on the pixel format. Rows are iterated with precomputed strides.
+///
+/// Use \ref Canvas::visit to get the view matching a canvas.
+template<typename PixelT, Rotation Rot>
+class CanvasView {
+public:
+  using Pixel = PixelT;
+  static constexpr Rotation rotation = Rot;
+
+  CanvasView(uint8_t* memory, Size size, int lineSize)
+    : pixels(reinterpret_cast<PixelT*>(memory)) // NOLINT
+    , mSize(size)
+    , lineStride(lineSize / std::ptrdiff_t(sizeof(PixelT))) {
+    assert(lineSize % sizeof(PixelT) == 0);
+
+    // The memory location of the top left pixel, see rotate().
+    const auto sizePoint = size.toPoint();
+    if constexpr (Rot == Rotation::None) {
+      origin = pixels;
+    } else if constexpr (Rot == Rotation::Clockwise) {
+      origin = pixels + (sizePoint.x * lineStride);
+    } else if constexpr (Rot == Rotation::CounterClockwise) {
+      origin = pixels + sizePoint.y;
+    } else {
+      origin = pixels + (sizePoint.y * lineStride) + sizePoint.x;
+    }
+  }
+
+  Size size() const { return mSize; }
+  Rect rect() const { return { { 0, 0 }, mSize.toPoint() }; }
+
+  /// The unrotated memory, with \ref stride pixels per line.
+  PixelT* data() const { return pixels; }
+  std::ptrdiff_t stride() const { return lineStride; }
+
+  /// Pointer increment to the next pixel in a row.
+  std::ptrdiff_t xStep() const {
+    if constexpr (Rot == Rotation::None) {
+      return 1;
+    } else if constexpr (Rot == Rotation::Clockwise) {
+      return -lineStride;
+    } else if constexpr (Rot == Rotation::CounterClockwise) {
+      return lineStride;
+    } else {
+      return -1;
+    }
+  }
+
+  /// Pointer increment to the next row.
+  std::ptrdiff_t yStep() const {
+    if constexpr (Rot == Rotation::None) {
+      return lineStride;
+    } else if constexpr (Rot == Rotation::Clockwise) {
+      return 1;
+    } else if constexpr (Rot == Rotation::CounterClockwise) {
+      return -1;
+    } else {
+      return -lineStride;
+    }
+  }
+
+  PixelT* getPtr(int x, int y) const {
+    return origin + (x * xStep()) + (y * yStep()); // NOLINT
+  }
+
+  PixelT getPixel(int x, int y) const {
+    assert(rect().contains(Point{ x, y }));
+    return *getPtr(x, y);
+  }
+
+  void setPixel(Point p, PixelT value) const {
+    assert(rect().contains(p));
+    *getPtr(p.x, p.y) = value;
+  }
+
+  /// Calls `f(y, row)` for each row in the rect, where `row` points to the
+  /// first pixel of the row. The next pixel is \ref xStep further.
+  template<typename Func>
+  void forEachRow(Rect r, Func&& f) const {
+    assert(rect().contains(r));
+    auto* row = getPtr(r.topLeft.x, r.topLeft.y);
+    for (int y = r.topLeft.y; y <= r.bottomRight.y; y++) {
+      f(y, row);
+      row += yStep(); // NOLINT
+    }
+  }
+
+  void set(Rect r, PixelT value) const {
+    assert(rect().contains(r));
+
+    // The order doesn't matter, so fill the memory lines for any rotation.
+    const auto memRect = rotate(mSize, Rot, r);
+    for (int y = memRect.topLeft.y; y <= memRect.bottomRight.y; y++) {
+      auto* line = pixels + (y * lineStride) + memRect.topLeft.x; // NOLINT
+      if constexpr (std::is_same_v<PixelT, uint16_t>) {
+        simd::fill(line, memRect.width(), value);
+      } else {
+        std::fill_n(line, memRect.width(), value);
+      }
+    }
+  }
+
+  template<typename Func>
+  void transform(const Func& f, Rect r) const {
+    forEachRow(r, [&](int y, PixelT* row) {
+      for (int x = r.topLeft.x; x <= r.bottomRight.x; x++, row += xStep()) {
+        *row = f(x, y, *row);
+      }
+    });
+  }
+
+  template<typename Func>
+  void forEach(const Func& f, Rect r) const {
+    forEachRow(r, [&](int y, const PixelT* row) {
+      for (int x = r.topLeft.x; x <= r.bottomRight.x; x++, row += xStep()) {
+        f(x, y, *row);
+      }
+    });
+  }
+
+  /// Copies a view of the same size, with any rotation.
+  template<Rotation SrcRot>
+  void copy(const CanvasView<PixelT, SrcRot>& src) const {
+    assert(src.size() == size());
+
+    if constexpr (SrcRot == Rot) {
+      // The memory layout is the same, so copy whole memory lines.
+      const auto memSize = rotate(Rot, mSize);
+      for (int n = 0; n < memSize.height; n++) {
+        memcpy(pixels + (n * lineStride), // NOLINT
+               src.data() + (n * src.stride()),
+               memSize.width * sizeof(PixelT));
+      }
+    } else if constexpr (std::is_same_v<PixelT, uint16_t>) {
+      // Walk the source memory lines, and find the direction of their pixels
+      // in this view.
+      constexpr bool transposed =
+        SrcRot == Rotation::Clockwise || SrcRot == Rotation::CounterClockwise;
+      constexpr int xSign =
+        SrcRot == Rotation::None || SrcRot == Rotation::CounterClockwise ? 1
+                                                                         : -1;
+      constexpr int ySign =
+        SrcRot == Rotation::None || SrcRot == Rotation::Clockwise ? 1 : -1;
+
+      const auto xDst = xSign * xStep();
+      const auto yDst = ySign * yStep();
+      const auto start = Point{ xSign < 0 ? mSize.width - 1 : 0,
+                                ySign < 0 ? mSize.height - 1 : 0 };
+      const auto srcMemSize = rotate(SrcRot, mSize);
+
+      simd::copyStrided(getPtr(start.x, start.y),
+                        transposed ? yDst : xDst,
+                        transposed ? xDst : yDst,
+                        src.data(),
+                        src.stride(),
+                        srcMemSize.width,
+                        srcMemSize.height);
+    } else {
+      transform([&src](int x, int y, PixelT) { return *src.getPtr(x, y); },
+                rect());
+    }
+  }
+
+private:
+  PixelT* pixels;
+  PixelT* origin;
+  Size mSize;
+  std::ptrdiff_t lineStride;
+};
+
 // TODO: drop compoments, hardcode to 2 / uint16_t in rgb565 format.
 class Canvas {
 public:
@@ -78,25 +259,58 @@ public:
     }
   }
 
+  /// Calls the function with the \ref CanvasView matching the pixel format
+  /// and rotation of this canvas.
   template<typename Func>
-  void transform(Func&& f, Rect r) {
-    assert(rect().contains(r));
+  void visit(Func&& f) const {
     switch (mComponents) {
       case 1:
-        transformImpl<uint8_t>(std::forward<Func>(f), r);
+        visitRotation<uint8_t>(std::forward<Func>(f));
         break;
       case 2:
-        transformImpl<uint16_t>(std::forward<Func>(f), r);
+        visitRotation<uint16_t>(std::forward<Func>(f));
+        break;
+      case 4:
+        visitRotation<uint32_t>(std::forward<Func>(f));
         break;
-      case 3:
+      default:
         assert(false && "TODO");
         break;
-      case 4:
-        transformImpl<uint32_t>(std::forward<Func>(f), r);
+    }
+  }
+
+  /// Like \ref visit, but only resolves the rotation. The pixel type must
+  /// match the components.
+  template<typename PixelT, typename Func>
+  void visitRotation(Func&& f) const {
+    switch (mRotation) {
+      case Rotation::None:
+        f(view<PixelT, Rotation::None>());
+        break;
+      case Rotation::Clockwise:
+        f(view<PixelT, Rotation::Clockwise>());
+        break;
+      case Rotation::Inverted:
+        f(view<PixelT, Rotation::Inverted>());
+        break;
+      case Rotation::CounterClockwise:
+        f(view<PixelT, Rotation::CounterClockwise>());
         break;
     }
   }
 
+  template<typename PixelT, Rotation Rot>
+  CanvasView<PixelT, Rot> view() const {
+    assert(sizeof(PixelT) == mComponents && Rot == mRotation);
+    return { mMemory, mSize, mLineSize };
+  }
+
+  template<typename Func>
+  void transform(Func&& f, Rect r) {
+    assert(rect().contains(r));
+    visit([&f, &r](auto view) { view.transform(f, r); });
+  }
+
   template<typename Func>
   void transform(Func&& f) {
     transform(std::forward<Func>(f), rect());
@@ -105,12 +319,7 @@ public:
   template<typename Func>
   void forEach(const Func& func, Rect r) const {
     assert(rect().contains(r.bottomRight) && rect().contains(r.topLeft));
-    for (int y = r.topLeft.y; y <= r.bottomRight.y; y++) {
-      for (int x = r.topLeft.x; x <= r.bottomRight.x; x++) {
-        auto value = getPixel(x, y);
-        func(x, y, value);
-      }
-    }
+    visit([&func, &r](auto view) { view.forEach(func, r); });
   }
 
   template<typename Func>
@@ -120,7 +329,9 @@ public:
 
   void set(Rect r, int value) {
     assert(rect().contains(r));
-    transform([value](auto x, auto y, auto v) { return value; }, r);
+    visit([&r, value](auto view) {
+      view.set(r, static_cast<typename decltype(view)::Pixel>(value));
+    });
   }
 
   void set(int value) { set(rect(), value); }
@@ -134,6 +345,14 @@ public:
                 int bg = white,
                 std::optional<Rect> clipRect = std::nullopt);
 
+  /// Draws the glyphs, see \ref GlyphCache::layout. Faster than drawText
+  /// when the same text is drawn repeatedly.
+  void drawGlyphs(const GlyphRun& run,
+                  Point location,
+                  int fg = black,
+                  int bg = white,
+                  std::optional<Rect> clipRect = std::nullopt);
+
   void drawLine(Point start, Point end, int val, int thickness = 1);
   void drawDisk(Point center, int radius, int val);
 
@@ -185,9 +404,7 @@ public:
     }
 
     for (int n = 0; n < numLines(); n++) {
-      const auto* line = getLine(n);
-      const auto* otherLine = other.getLine(n);
-      if (memcmp(line, otherLine, lineWidth() * mComponents) != 0) {
+      if (!compareLine(other, n)) {
         std::cout << "Diff at line " << n << "\n";
         return false;
       }
@@ -196,21 +413,36 @@ public:
     return true;
   }
 
+  /// Copies the canvas of the same size, which can have another rotation.
   void copy(const Canvas& src) {
     assert(components() == src.components());
-    assert(rotation() == src.rotation());
     assert(size() == src.size());
 
-    const auto linewidth = lineWidth();
-    for (int n = 0; n < numLines(); n++) {
-      const auto* srcLine = src.getLine(n);
-      auto* destLine = getLine(n);
-      memcpy(destLine, srcLine, linewidth * mComponents);
+    visit([&src](auto view) {
+      src.visitRotation<typename decltype(view)::Pixel>(
+        [&view](auto srcView) { view.copy(srcView); });
+    });
+  }
+
+  /// Copies the image with its top left at the given point, clipped to this
+  /// canvas. The image can have another rotation.
+  void drawImage(const Canvas& image, Point location) {
+    const auto dstRect =
+      Rect{ location, location + image.size().toPoint() } & rect();
+    if (dstRect.width() <= 0 || dstRect.height() <= 0) {
+      return;
     }
+
+    auto src = image;
+    subCanvas(dstRect).copy(src.subCanvas(dstRect + (Point{} - location)));
   }
 
   OptError<> writeImage(const char* path) const;
 
+  /// Writes the pixels in the uncompressed format read by
+  /// \ref ImageCanvas::mapRaw.
+  OptError<> writeRaw(const char* path) const;
+
   bool operator==(const Canvas& other) const {
     return mMemory == other.mMemory && mSize == other.mSize &&
            mComponents == other.mComponents && mLineSize == other.mLineSize &&
@@ -237,6 +469,18 @@ private:
   uint8_t* memory() const { return mMemory; }
 
   uint8_t* getLine(int n) const { return mMemory + (n * mLineSize); }
+
+  bool compareLine(const Canvas& other, int n) const {
+    if (mComponents != sizeof(uint16_t)) {
+      return memcmp(getLine(n), other.getLine(n), lineWidth() * mComponents) ==
+             0;
+    }
+
+    const auto* line = reinterpret_cast<const uint16_t*>(getLine(n)); // NOLINT
+    const auto* otherLine =
+      reinterpret_cast<const uint16_t*>(other.getLine(n)); // NOLINT
+    return simd::compare(line, otherLine, lineWidth()) == size_t(lineWidth());
+  }
   int lineWidth() const { return rotate(mRotation, mSize).width; }
   int numLines() const { return rotate(mRotation, mSize).height; }
 
@@ -258,16 +502,6 @@ private:
                                 (lp.x * mComponents));
   }
 
-  template<typename ValueType, typename Func>
-  void transformImpl(const Func& f, Rect r) {
-    for (int y = r.topLeft.y; y <= r.bottomRight.y; y++) {
-      for (int x = r.topLeft.x; x <= r.bottomRight.x; x++) {
-        auto* ptr = getPtr<ValueType>(x, y);
-        *ptr = f(x, y, *ptr);
-      }
-    }
-  }
-
   uint8_t* mMemory = nullptr;
   int mLineSize = 0;
   int mComponents = 0;
@@ -277,19 +511,31 @@ private:
 
 struct ImageCanvas {
   static std::optional<ImageCanvas> loadRaw(const char* path);
-  static std::optional<ImageCanvas> load(const char* path,
-                                         int background = white);
-  static std::optional<ImageCanvas> load(uint8_t* data,
-                                         int size,
-                                         int background = white);
-
-  ImageCanvas(ImageCanvas&& other) noexcept : canvas(other.canvas) {
+  /// Loads the image, blended on the background. When dither options are
+  /// given the image is quantised once here, instead of on every draw.
+  static std::optional<ImageCanvas> load(
+    const char* path,
+    int background = white,
+    std::optional<DitherOptions> dither = std::nullopt);
+  static std::optional<ImageCanvas> load(
+    uint8_t* data,
+    int size,
+    int background = white,
+    std::optional<DitherOptions> dither = std::nullopt);
+
+  /// Maps an image written by \ref Canvas::writeRaw. Nothing is decoded or
+  /// copied, the pages are loaded when the image is drawn.
+  static std::optional<ImageCanvas> mapRaw(const char* path);
+
+  ImageCanvas(ImageCanvas&& other) noexcept
+    : canvas(other.canvas), mapping(std::move(other.mapping)) {
     other.canvas = Canvas{};
   }
 
   ImageCanvas& operator=(ImageCanvas&& other) noexcept {
     release();
     std::swap(other.canvas, this->canvas);
+    std::swap(other.mapping, this->mapping);
     return *this;
   }
 
@@ -304,6 +550,9 @@ private:
   ImageCanvas(Canvas canvas) : canvas(std::move(canvas)) {}
 
   void release();
+
+  /// Owns the memory of mapped images, others are allocated by stb_image.
+  unistdpp::MmapPtr mapping;
 };
 
 struct MemoryCanvas {
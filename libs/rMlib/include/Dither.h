@@ -0,0 +1,31 @@
+#pragma once
+
+namespace rmlib {
+
+class Canvas;
+
+enum class DitherMode {
+  /// Rounds each pixel to the nearest level.
+  None,
+
+  /// 8x8 Bayer matrix. Vectorised, and stable when part of the image
+  /// changes, so suited for UI images.
+  Ordered,
+
+  /// Floyd-Steinberg. Better for photos, but serial per line.
+  ErrorDiffusion,
+};
+
+/// Quantisation matching the panel: 4 bits gives the 16 grey levels of the
+/// GC16 waveforms, 1 bit gives the black and white that DU and A2 can show.
+struct DitherOptions {
+  int bits = 4;
+  DitherMode mode = DitherMode::Ordered;
+};
+
+/// Quantises the RGB565 canvas in place to evenly spaced grey levels.
+/// Supports 1, 2 and 4 bits.
+void
+dither(Canvas& canvas, const DitherOptions& options);
+
+} // namespace rmlib
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Error.h"
+
+#include <UI/Timer.h>
+
+#include <unistdpp/poll.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace rmlib {
+
+/// Calls callbacks for readable fds, timers and signals. Registrations are
+/// kept between waits, so a wait costs the same however many there are.
+///
+/// On Linux this is an epoll instance, with a timerfd armed for the next
+/// timer. Its fd is polled next to the input devices, see
+/// \ref AppContext::waitForInput. Elsewhere, for the emulator, it falls
+/// back to polling all fds. Signal handlers write to a pipe read by the
+/// loop.
+class EventLoop {
+public:
+  static ErrorOr<EventLoop> create();
+
+  EventLoop(EventLoop&&) noexcept;
+  EventLoop& operator=(EventLoop&&) noexcept;
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  /// Calls the callback whenever the fd is readable, until it's removed.
+  OptError<> addFd(int fd, Callback callback);
+  void removeFd(int fd);
+
+  TimerHandle addTimer(
+    std::chrono::microseconds duration,
+    Callback callback,
+    std::optional<std::chrono::microseconds> repeat = std::nullopt);
+
+  /// Calls the callback when the process receives the signal, instead of
+  /// the signal handler. Until the loop is destroyed.
+  OptError<> addSignal(int signal, Callback callback);
+
+  /// The fds to wait for. One becomes readable when \ref dispatch has work.
+  std::vector<pollfd>& getPollFds() { return pollFds; }
+
+  /// \returns How long to wait at most, the timeout or until the next timer
+  /// when they aren't waited for by an fd.
+  std::optional<std::chrono::microseconds> getTimeout(
+    std::optional<std::chrono::microseconds> timeout) const;
+
+  /// Calls the callbacks of everything that's ready, without waiting.
+  OptError<> dispatch();
+
+  /// Waits until something is ready or the timeout, and dispatches it.
+  OptError<> wait(std::optional<std::chrono::microseconds> timeout);
+
+private:
+  struct Entry {
+    int fd;
+    Callback callback;
+    bool removed = false;
+  };
+
+  EventLoop() = default;
+
+  void removeEntries();
+  void runTimers();
+  OptError<> armTimer();
+  OptError<> dispatchSignals();
+
+  std::unordered_map<int, std::unique_ptr<Entry>> entries;
+
+  /// Entries removed during \ref dispatch, freed after it.
+  std::vector<std::unique_ptr<Entry>> removedEntries;
+
+  std::vector<pollfd> pollFds;
+
+  /// Parallel to \ref pollFds, null for the fds of the loop itself.
+  std::vector<Entry*> pollEntries;
+
+  bool dispatching = false;
+
+  TimerQueue timers;
+
+  /// Restores the signal handlers when destroyed.
+  struct Signals;
+  std::unique_ptr<Signals> signals;
+
+#ifdef __linux__
+  unistdpp::FD epollFd;
+  unistdpp::FD timerFd;
+
+  std::optional<Timer::Clock::time_point> armedTime;
+  std::array<epoll_event, 16> readyEvents{};
+#endif
+};
+
+} // namespace rmlib
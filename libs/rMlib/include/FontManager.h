@@ -0,0 +1,74 @@
+#pragma once
+
+#include <unistdpp/mmap.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+struct stbtt_fontinfo;
+
+namespace rmlib {
+
+enum class FontStyle { Regular, Bold };
+
+/// Font memory of this process.
+struct FontStats {
+  /// Faces that are loaded.
+  size_t faces = 0;
+
+  /// Bytes of font files mapped. The pages are read-only and shared with
+  /// other processes through the page cache.
+  size_t mappedBytes = 0;
+
+  /// Bytes of the mapped files that are in memory.
+  size_t residentBytes = 0;
+};
+
+/// Resolves codepoints to font faces. Each style has a chain of faces, the
+/// first face that has a glyph for the codepoint is used. Font files are
+/// mapped read-only when first needed, files that don't exist are skipped.
+class FontManager {
+public:
+  static FontManager& getInstance();
+
+  FontManager();
+  ~FontManager();
+
+  FontManager(const FontManager&) = delete;
+  FontManager& operator=(const FontManager&) = delete;
+
+  /// Adds a font file to the end of the chain of the style.
+  void addFace(FontStyle style, std::filesystem::path path);
+
+  /// \returns The first face of the chain, which provides the line metrics.
+  const stbtt_fontinfo* getPrimaryFace(FontStyle style = FontStyle::Regular);
+
+  /// \returns The face to draw the codepoint with. The primary face if no
+  /// face has the glyph, so it draws its missing glyph box.
+  const stbtt_fontinfo* getFace(uint32_t codepoint,
+                                FontStyle style = FontStyle::Regular);
+
+  FontStats getStats() const;
+
+private:
+  struct Face {
+    std::filesystem::path path;
+
+    /// The font data, from the mapping or built into the binary.
+    const uint8_t* data = nullptr;
+    unistdpp::MmapPtr mapping;
+    std::unique_ptr<stbtt_fontinfo> info;
+
+    /// Loading failed, don't try again.
+    bool failed = false;
+  };
+
+  const stbtt_fontinfo* load(Face& face);
+
+  std::array<std::vector<Face>, 2> chains;
+};
+
+} // namespace rmlib
@@ -5,6 +5,11 @@
 
 #include <unistdpp/unistdpp.h>
 
+#ifdef EMULATE
+/// Emulates the framebuffer without showing a window.
+extern bool rmlibDisableWindow; // NOLINT
+#endif
+
 namespace rmlib::fb {
 
 // Waveform ints that match rm2 'actual' updates
@@ -18,6 +23,11 @@ struct FrameBuffer {
   /// Opens the framebuffer.
   static ErrorOr<FrameBuffer> open(std::optional<Size> requestedSize = {});
 
+  /// Opens an rm2fb overlay plane as framebuffer. Overlays are drawn on top
+  /// of the shared framebuffer, without modifying it. Only supported when
+  /// running on our own rm2fb. The overlay starts hidden.
+  static ErrorOr<FrameBuffer> openOverlay(int id, int z = 0);
+
   FrameBuffer(FrameBuffer&& other) = default;
 
   FrameBuffer(const FrameBuffer&) = delete;
@@ -63,6 +73,13 @@ struct FrameBuffer {
     doUpdate(canvas.rect(), Waveform::GC16Fast, UpdateFlags::None);
   }
 
+  /// Shows or hides the overlay, does nothing if this isn't an overlay.
+  void setOverlayVisible(bool visible,
+                         Waveform waveform = Waveform::GC16Fast,
+                         UpdateFlags flags = UpdateFlags::None) const;
+
+  bool isOverlay() const { return overlayId >= 0; }
+
   // members
   Type type;
   unistdpp::FD fd;
@@ -75,6 +92,11 @@ private:
   void close();
 
   static ErrorOr<Type> detectType();
+
+  // Connection to the rm2fb server, only used for overlays.
+  unistdpp::FD overlaySock;
+  int overlayId = -1;
+  int overlayZ = 0;
 };
 
 } // namespace rmlib::fb
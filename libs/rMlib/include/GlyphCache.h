@@ -0,0 +1,150 @@
+#pragma once
+
+#include "FontManager.h"
+#include "LruCache.h"
+#include "MathUtil.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rmlib {
+
+/// A rasterised glyph, with its coverage bitmap and metrics.
+struct Glyph {
+  /// Offset of the bitmap from the pen position on the baseline.
+  Point offset;
+  int width = 0;
+  int height = 0;
+
+  /// Horizontal advance in pixels, without kerning.
+  float advance = 0;
+
+  /// Coverage per pixel, 0 is transparent, 255 is fully covered.
+  std::vector<uint8_t> coverage;
+};
+
+/// A line of text, with each glyph positioned relative to the top left of
+/// the line.
+struct GlyphRun {
+  struct Entry {
+    std::shared_ptr<const Glyph> glyph;
+    Point position;
+  };
+
+  std::vector<Entry> glyphs;
+};
+
+/// A shaped line of text: the codepoints with their pen positions and the
+/// bounding size, but without any rasterised glyphs.
+struct TextRun {
+  /// The measured text, to detect hash collisions.
+  std::string text;
+
+  std::u32string codepoints;
+  /// Horizontal pen position of each codepoint, including kerning.
+  std::vector<float> positions;
+
+  float baseLine = 0;
+  Size size;
+};
+
+/// Bounded LRU cache of rasterised glyphs, keyed by codepoint, pixel size,
+/// subpixel offset and style. Also caches the measured text runs, keyed by
+/// text hash, pixel size and style. Glyphs come from the faces of the
+/// \ref FontManager.
+class GlyphCache {
+public:
+  static constexpr size_t default_capacity = 512;
+  static constexpr size_t default_run_capacity = 256;
+
+  using Stats = CacheStats;
+
+  explicit GlyphCache(size_t capacity = default_capacity,
+                      size_t runCapacity = default_run_capacity)
+    : glyphs(capacity), runs(runCapacity) {}
+
+  /// The cache used by \ref Canvas::drawText.
+  static GlyphCache& getInstance();
+
+  /// \returns The glyph, rasterised with the given horizontal subpixel
+  /// offset.
+  std::shared_ptr<const Glyph> get(uint32_t codepoint,
+                                   int size,
+                                   float subpixelOffset,
+                                   FontStyle style = FontStyle::Regular);
+
+  /// \returns The shaped UTF-8 text, measured once per text and size.
+  std::shared_ptr<const TextRun> measure(
+    std::string_view text,
+    int size,
+    FontStyle style = FontStyle::Regular);
+
+  /// Rasterises and positions all glyphs of the UTF-8 text.
+  GlyphRun layout(std::string_view text,
+                  int size,
+                  FontStyle style = FontStyle::Regular);
+
+  /// Rasterises and positions all glyphs of an already measured run.
+  GlyphRun layout(const TextRun& run,
+                  int size,
+                  FontStyle style = FontStyle::Regular);
+
+  const Stats& getStats() const { return glyphs.getStats(); }
+  const Stats& getRunStats() const { return runs.getStats(); }
+  void resetStats() {
+    glyphs.resetStats();
+    runs.resetStats();
+  }
+
+  size_t size() const { return glyphs.size(); }
+  void clear();
+
+private:
+  struct Key {
+    uint32_t codepoint;
+    int size;
+    uint32_t subpixelOffset; // The bits of the float offset.
+    FontStyle style;
+
+    bool operator==(const Key& other) const {
+      return codepoint == other.codepoint && size == other.size &&
+             subpixelOffset == other.subpixelOffset && style == other.style;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      auto hash = std::hash<uint32_t>{}(key.codepoint);
+      hash = hash * 31 + std::hash<int>{}(key.size);
+      hash = hash * 31 + std::hash<uint32_t>{}(key.subpixelOffset);
+      hash = hash * 31 + std::hash<int>{}(int(key.style));
+      return hash;
+    }
+  };
+
+  struct RunKey {
+    size_t textHash;
+    int size;
+    FontStyle style;
+
+    bool operator==(const RunKey& other) const {
+      return textHash == other.textHash && size == other.size &&
+             style == other.style;
+    }
+  };
+
+  struct RunKeyHash {
+    size_t operator()(const RunKey& key) const {
+      auto hash = key.textHash * 31 + std::hash<int>{}(key.size);
+      return hash * 31 + std::hash<int>{}(int(key.style));
+    }
+  };
+
+  LruCache<Key, std::shared_ptr<const Glyph>, KeyHash> glyphs;
+  LruCache<RunKey, std::shared_ptr<const TextRun>, RunKeyHash> runs;
+};
+
+} // namespace rmlib
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Canvas.h"
+#include "Dither.h"
+#include "LruCache.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace rmlib {
+
+/// Decoded images, scaled to fit a size and dithered for the panel.
+///
+/// Results are kept in memory up to a byte budget, and stored in a cache
+/// directory in the format of \ref ImageCanvas::mapRaw, keyed by path,
+/// modification time, file size and scaled size. So an image is only decoded
+/// again when it changes, also across restarts. The files of older versions
+/// of an image are removed when a new one is written.
+class ImageCache {
+public:
+  static constexpr size_t default_memory_budget = size_t(8) << 20;
+
+  explicit ImageCache(std::filesystem::path directory,
+                      size_t memoryBudget = default_memory_budget,
+                      DitherOptions dither = {});
+
+  /// \returns The image scaled to fit in the size, keeping its aspect ratio.
+  /// Or nullptr if it can't be loaded. The canvas stays valid while the
+  /// pointer is held, also when it's evicted.
+  std::shared_ptr<const Canvas> get(const std::filesystem::path& path,
+                                    Size size);
+
+  const CacheStats& getStats() const { return memory.getStats(); }
+
+  /// Bytes of pixels in memory.
+  size_t memoryUsage() const { return memory.cost(); }
+
+private:
+  struct Key {
+    std::string path;
+    Size size;
+
+    bool operator==(const Key& other) const {
+      return path == other.path && size == other.size;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      auto hash = std::hash<std::string>{}(key.path);
+      hash = hash * 31 + std::hash<int>{}(key.size.width);
+      hash = hash * 31 + std::hash<int>{}(key.size.height);
+      return hash;
+    }
+  };
+
+  struct Entry {
+    std::shared_ptr<const Canvas> canvas;
+    std::filesystem::file_time_type time;
+    uintmax_t fileSize;
+  };
+
+  std::shared_ptr<const Canvas> load(const std::filesystem::path& path,
+                                     Size size,
+                                     std::filesystem::file_time_type time,
+                                     uintmax_t fileSize);
+
+  std::filesystem::path directory;
+  DitherOptions dither;
+  LruCache<Key, Entry, KeyHash> memory;
+};
+
+} // namespace rmlib
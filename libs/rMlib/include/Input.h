@@ -3,10 +3,15 @@
 #include "Error.h"
 #include "MathUtil.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -20,6 +25,7 @@
 #include <linux/input-event-codes.h>
 #endif
 
+struct input_event;
 struct libevdev;
 struct udev;
 struct udev_monitor;
@@ -28,6 +34,10 @@ namespace rmlib::input {
 
 constexpr static auto max_num_slots = 32;
 
+/// The clock of event timestamps. Devices report on CLOCK_MONOTONIC, which
+/// is what the steady clock uses.
+using EventClock = std::chrono::steady_clock;
+
 struct TouchEvent {
   enum { Down, Up, Move } type = Move;
   int id{};
@@ -36,6 +46,9 @@ struct TouchEvent {
   Point location;
   int pressure{};
 
+  /// When the device reported the event.
+  EventClock::time_point time;
+
   constexpr bool isDown() const { return type == Down; }
   constexpr bool isUp() const { return type == Up; }
   constexpr bool isMove() const { return type == Move; }
@@ -51,6 +64,9 @@ struct PenEvent {
 
   int id = pen_id;
 
+  /// When the device reported the event.
+  EventClock::time_point time;
+
   constexpr bool isDown() const { return type == TouchDown; }
   constexpr bool isUp() const { return type == TouchUp; }
   constexpr bool isMove() const { return type == Move; }
@@ -59,6 +75,9 @@ struct PenEvent {
 struct KeyEvent {
   enum { Release = 0, Press = 1, Repeat = 2 } type;
   int keyCode;
+
+  /// When the device reported the event.
+  EventClock::time_point time{};
 };
 
 template<typename T>
@@ -66,6 +85,272 @@ constexpr bool is_pointer_event = !std::is_same_v<std::decay_t<T>, KeyEvent>;
 
 using Event = std::variant<TouchEvent, PenEvent, KeyEvent>;
 
+inline EventClock::time_point
+getTime(const Event& event) {
+  return std::visit([](const auto& ev) { return ev.time; }, event);
+}
+
+/// A fixed capacity queue of events. Devices decode into a ring provided by
+/// the caller, so reading input doesn't allocate. When it's full the oldest
+/// move is dropped, so downs, ups and keys are kept. Only when there are no
+/// moves the oldest event is dropped.
+class EventRing {
+public:
+  static constexpr size_t capacity = 256;
+  static_assert((capacity & (capacity - 1)) == 0);
+
+  bool empty() const { return count == 0; }
+  bool full() const { return count == capacity; }
+  size_t size() const { return count; }
+
+  /// Events dropped because the ring was full.
+  size_t dropped() const { return numDropped; }
+
+  void push(const Event& event) {
+    if (full()) {
+      dropOldest();
+      numDropped++;
+    }
+    events[(head + count) & (capacity - 1)] = event;
+    count++;
+  }
+
+  const Event& front() const {
+    assert(!empty());
+    return events[head];
+  }
+
+  Event pop() {
+    assert(!empty());
+    auto event = events[head];
+    head = (head + 1) & (capacity - 1);
+    count--;
+    return event;
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+  }
+
+private:
+  static constexpr size_t mask = capacity - 1;
+
+  static bool isMove(const Event& event) {
+    return std::visit(
+      [](const auto& ev) {
+        if constexpr (is_pointer_event<decltype(ev)>) {
+          return ev.isMove();
+        } else {
+          return false;
+        }
+      },
+      event);
+  }
+
+  void dropOldest() {
+    for (size_t i = 0; i < count; i++) {
+      if (!isMove(events[(head + i) & mask])) {
+        continue;
+      }
+
+      // Close the gap by moving the older events up.
+      for (size_t j = i; j > 0; j--) {
+        events[(head + j) & mask] = events[(head + j - 1) & mask];
+      }
+      head = (head + 1) & mask;
+      count--;
+      return;
+    }
+    pop();
+  }
+
+  std::array<Event, capacity> events;
+  size_t head = 0;
+  size_t count = 0;
+  size_t numDropped = 0;
+};
+
+/// A fixed capacity queue handing events from the input thread to the UI
+/// thread. Lock free for a single producer and a single consumer. When it's
+/// full new events are dropped, as only the consumer may remove old ones.
+class EventQueue {
+public:
+  using Clock = EventClock;
+
+  static constexpr size_t capacity = 1024;
+  static_assert((capacity & (capacity - 1)) == 0);
+
+  struct Entry {
+    Event event;
+
+    /// When the input thread read the event.
+    Clock::time_point readTime;
+  };
+
+  /// Producer only.
+  /// \returns False if the queue is full and the event was dropped.
+  bool push(const Event& event, Clock::time_point readTime) {
+    const auto pos = tail.load(std::memory_order_relaxed);
+    if (pos - head.load(std::memory_order_acquire) == capacity) {
+      numDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    entries[pos & (capacity - 1)] = Entry{ event, readTime };
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer only.
+  std::optional<Entry> pop() {
+    const auto pos = head.load(std::memory_order_relaxed);
+    if (pos == tail.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+
+    auto entry = entries[pos & (capacity - 1)];
+    head.store(pos + 1, std::memory_order_release);
+    return entry;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t size() const {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_acquire);
+  }
+
+  size_t dropped() const { return numDropped.load(std::memory_order_relaxed); }
+
+private:
+  std::array<Entry, capacity> entries;
+
+  // On separate cache lines, each is written by one thread.
+  alignas(64) std::atomic<size_t> head = 0;
+  alignas(64) std::atomic<size_t> tail = 0;
+  std::atomic<size_t> numDropped = 0;
+};
+
+/// Statistics of the input thread, see \ref InputManager::startThread.
+struct InputStats {
+  /// The most events waiting when the UI thread took them.
+  size_t maxQueueDepth = 0;
+
+  /// Events dropped because the queue was full.
+  size_t dropped = 0;
+
+  /// From reading an event on the input thread until the UI thread takes it
+  /// to handle it.
+  size_t events = 0;
+  std::chrono::microseconds totalLatency{ 0 };
+  std::chrono::microseconds maxLatency{ 0 };
+
+  std::chrono::microseconds averageLatency() const {
+    if (events == 0) {
+      return std::chrono::microseconds(0);
+    }
+    return totalLatency / events;
+  }
+};
+
+/// The start of a recording of a device, followed by its raw input events.
+struct RecordingHeader {
+  static constexpr std::array<char, 8> magic_value = { 'r', 'm', 'i', 'n',
+                                                       'p', 'u', 't', '1' };
+
+  enum Kind : uint32_t { Key, Pen, Touch };
+
+  std::array<char, 8> magic = magic_value;
+  Kind kind = Key;
+
+  /// The size of the recorded `input_event`s, which differs between 32 and
+  /// 64 bit systems.
+  uint32_t eventSize = 0;
+
+  /// The monotonic time the recording started, in microseconds.
+  int64_t startTime = 0;
+
+  Transform transform;
+};
+
+enum class ReplaySpeed {
+  /// Each frame handles the next report of each device.
+  Fast,
+
+  /// Reports are handled at the times they were recorded.
+  RealTime,
+};
+
+/// A raw event of a recording, in the layout of a 64 bit `input_event`.
+/// Events recorded on 32 bit systems are converted when read.
+struct RecordedEvent {
+  int64_t sec = 0;
+  int64_t usec = 0;
+  uint16_t type = 0;
+  uint16_t code = 0;
+  int32_t value = 0;
+
+  EventClock::time_point getTime() const;
+  void setTime(EventClock::time_point time);
+
+  /// \returns True for the `SYN_REPORT` that ends a report.
+  bool isReport() const { return type == 0 && code == 0; }
+};
+
+struct Recording {
+  RecordingHeader header;
+  std::vector<RecordedEvent> events;
+};
+
+/// Reads a recording made by \ref InputDeviceBase::startRecording.
+ErrorOr<Recording>
+readRecording(const std::string& path);
+
+/// Hands out the reports of a recording once they're due, keeping the time
+/// between them.
+class Replay {
+public:
+  /// Moves the event times so the recording starts at \p start.
+  Replay(Recording recording, ReplaySpeed speed, EventClock::time_point start);
+
+  /// Calls \p decode with the events of each report that's due at \p now,
+  /// including the `SYN_REPORT`. Fast replays hand out one report per call.
+  template<typename Fn>
+  void next(EventClock::time_point now, Fn&& decode) {
+    while (nextEvent < events.size()) {
+      const auto& first = events[nextEvent];
+      if (speed == ReplaySpeed::RealTime && first.getTime() > now) {
+        break;
+      }
+
+      const auto end = std::find_if(
+        events.begin() + long(nextEvent), events.end(), [](const auto& ev) {
+          return ev.isReport();
+        });
+      const auto count =
+        std::min(size_t(end - events.begin()) + 1, events.size()) - nextEvent;
+      decode(&events[nextEvent], count);
+      nextEvent += count;
+
+      if (speed == ReplaySpeed::Fast) {
+        break;
+      }
+    }
+  }
+
+  /// \returns The time of the next report, if any are left.
+  std::optional<EventClock::time_point> getNextTime() const;
+
+  bool isDone() const { return nextEvent >= events.size(); }
+  ReplaySpeed getSpeed() const { return speed; }
+
+private:
+  std::vector<RecordedEvent> events;
+  size_t nextEvent = 0;
+  ReplaySpeed speed;
+};
+
 struct InputDeviceBase {
   struct EvDevDeleter {
     void operator()(libevdev* evdev);
@@ -85,9 +370,26 @@ struct InputDeviceBase {
 
   virtual ~InputDeviceBase() = default;
 
-  virtual OptError<> readEvents(std::vector<Event>& out) = 0;
+  /// Reads all pending events of the device into the ring.
+  virtual OptError<> readEvents(EventRing& out) = 0;
+
+  /// Decodes raw events read from the device, or from a recording of it.
+  /// Events are added to the ring when their report ends.
+  virtual void decode(const input_event* events,
+                      size_t count,
+                      EventRing& out) = 0;
+
+  /// Writes the raw events read from now on to the file, after a header.
+  OptError<> startRecording(const std::string& file);
+
+  /// \returns True if this replays a recording, which has events left.
+  virtual bool isReplaying() const { return false; }
 
 protected:
+  virtual RecordingHeader getRecordingHeader() const { return {}; }
+
+  unistdpp::FD recording;
+
   InputDeviceBase(unistdpp::FD fd, EvDevPtr evdev, std::string path)
     : fd(std::move(fd)), evdev(std::move(evdev)), path(std::move(path)) {}
 };
@@ -108,19 +410,61 @@ struct InputManager {
   ///                Will also remove devices when unplugged.
   ErrorOr<BaseDevices> openAll(bool monitor = true);
 
-  InputManager() = default;
-  ~InputManager() = default;
+  InputManager();
+  ~InputManager();
 
-  InputManager(InputManager&& other) = default;
-  InputManager& operator=(InputManager&& other) = default;
+  InputManager(InputManager&& other) noexcept;
+  InputManager& operator=(InputManager&& other) noexcept;
 
   InputManager(const InputManager&) = delete;
   InputManager& operator=(const InputManager&) = delete;
 
-  ErrorOr<std::vector<Event>> waitForInput(
+  /// Records the raw events of all devices, also ones added later, to a file
+  /// per device in the directory.
+  OptError<> startRecording(std::string dir);
+
+  /// Opens the recordings in the directory, made by \ref startRecording,
+  /// instead of the devices. Only the evdev decoders can replay them, not
+  /// the emulator.
+  ErrorOr<BaseDevices> openReplay(std::string_view dir, ReplaySpeed speed);
+
+  /// \returns True while replayed recordings have events left.
+  bool isReplaying();
+
+  /// Reads the devices on a separate thread, so they're drained while the
+  /// UI thread is busy. \ref waitForInput then takes the events it queued.
+  OptError<> startThread();
+
+  /// Stops the input thread, events it still queued are dropped.
+  void stopThread();
+
+  bool hasThread() const { return thread != nullptr; }
+
+  const InputStats& getStats() const { return stats; }
+  void resetStats() { stats = {}; }
+
+  /// Waits for input, for one of the extra fds to become readable or for the
+  /// timeout. Then reads the events of all ready devices into the ring, or
+  /// takes the events queued by the input thread.
+  /// Doesn't allocate, unless devices or extra fds are added.
+  OptError<> waitForInput(
+    EventRing& out,
     std::vector<pollfd>& extraFds,
     std::optional<std::chrono::milliseconds> timeout = std::nullopt);
 
+  ErrorOr<std::vector<Event>> waitForInput(
+    std::vector<pollfd>& extraFds,
+    std::optional<std::chrono::milliseconds> timeout = std::nullopt) {
+    TRY(waitForInput(events, extraFds, timeout));
+
+    std::vector<Event> result;
+    result.reserve(events.size());
+    while (!events.empty()) {
+      result.push_back(events.pop());
+    }
+    return result;
+  }
+
   template<typename... ExtraFds>
   auto waitForInput(std::optional<std::chrono::milliseconds> timeout,
                     const ExtraFds&... extraFds)
@@ -173,10 +517,22 @@ struct InputManager {
       baseDevices.pogoKeyboard = nullptr;
     }
 
+    auto lock = lockDevices();
     devices.erase(it);
+    markDevicesChanged();
   }
 
 private:
+  struct Thread;
+
+  /// Locks the devices while the input thread reads them, if there's one.
+  std::unique_lock<std::mutex> lockDevices();
+
+  /// Called with the devices locked after adding or removing one.
+  void markDevicesChanged();
+
+  void takeEvents(EventRing& out);
+
   /// members
   std::unordered_map<std::string_view, std::unique_ptr<InputDeviceBase>>
     devices;
@@ -184,6 +540,20 @@ private:
   BaseDevices baseDevices;
   unistdpp::FD udevMonitorFd;
 
+  /// Where new devices are recorded, empty if not recording.
+  std::string recordDir;
+
+  /// Kept between calls to \ref waitForInput, so it doesn't allocate.
+  std::vector<InputDeviceBase*> deviceOrder;
+  std::vector<pollfd> pollFds;
+  bool devicesChanged = true;
+
+  /// Events for the overloads returning a vector.
+  EventRing events;
+
+  std::unique_ptr<Thread> thread;
+  InputStats stats;
+
   template<typename T>
   struct UdevDeleter {
     void operator()(T* t);
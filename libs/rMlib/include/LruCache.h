@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace rmlib {
+
+/// Cache hit statistics.
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+
+  float hitRate() const {
+    const auto total = hits + misses;
+    return total == 0 ? 0.0F : float(hits) / float(total);
+  }
+};
+
+/// Map with a bounded size, evicting the least recently used entry first.
+///
+/// Each entry has a cost, 1 by default, and the total cost is kept below the
+/// capacity. So the capacity is either a number of entries or, when the cost
+/// is the size of the value, a memory budget.
+template<typename Key, typename Value, typename Hash>
+class LruCache {
+public:
+  explicit LruCache(size_t capacity) : capacity(capacity) {}
+
+  /// \returns The value for the key, or nullptr if it isn't in the cache.
+  const Value* find(const Key& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+      stats.misses++;
+      return nullptr;
+    }
+
+    stats.hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->value;
+  }
+
+  /// Inserts or replaces the value of the key. An entry that costs more than
+  /// the capacity is kept until the next insert.
+  const Value& insert(const Key& key, Value value, size_t cost = 1) {
+    if (auto it = index.find(key); it != index.end()) {
+      totalCost -= it->second->cost;
+      entries.erase(it->second);
+      index.erase(it);
+    }
+
+    while (!entries.empty() && totalCost + cost > capacity) {
+      totalCost -= entries.back().cost;
+      index.erase(entries.back().key);
+      entries.pop_back();
+      stats.evictions++;
+    }
+
+    entries.push_front(Entry{ key, std::move(value), cost });
+    index.emplace(key, entries.begin());
+    totalCost += cost;
+    return entries.front().value;
+  }
+
+  const CacheStats& getStats() const { return stats; }
+  void resetStats() { stats = {}; }
+
+  size_t size() const { return entries.size(); }
+  size_t cost() const { return totalCost; }
+
+  void clear() {
+    entries.clear();
+    index.clear();
+    totalCost = 0;
+  }
+
+private:
+  struct Entry {
+    Key key;
+    Value value;
+    size_t cost;
+  };
+
+  size_t capacity;
+  size_t totalCost = 0;
+  CacheStats stats;
+
+  /// Most recently used first.
+  std::list<Entry> entries;
+  std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+};
+
+} // namespace rmlib
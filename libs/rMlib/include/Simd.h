@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Vectorised primitives for RGB565 pixel rows. These use NEON on the device
+/// and SSE2, or AVX2 when enabled, on the host. Other targets use the scalar
+/// fallbacks.
+namespace rmlib::simd {
+
+/// `x / 255` without division, exact for `0 <= x <= 255 * 255`.
+constexpr int
+div255(int x) {
+  return (x + 1 + (x >> 8)) >> 8; // NOLINT
+}
+
+/// Sets `count` pixels to the value.
+void
+fill(uint16_t* dst, size_t count, uint16_t value);
+
+/// Blends from the background to the foreground grey level by the coverage,
+/// and writes the result as RGB565.
+void
+blendCoverage(uint16_t* dst,
+              const uint8_t* coverage,
+              size_t count,
+              uint8_t fg,
+              uint8_t bg);
+
+/// Quantises the grey of each pixel to `levels` evenly spaced levels, with
+/// `255 % (levels - 1) == 0`. The level is `(grey * (levels - 1) + bias) /
+/// 255`, where `bias` repeats every 8 pixels and is below 255.
+void
+quantize(uint16_t* dst, size_t count, const uint16_t* bias, int levels);
+
+/// \returns The index of the first pixel that differs, or `count`.
+size_t
+compare(const uint16_t* a, const uint16_t* b, size_t count);
+
+/// Copies a `width` x `height` block of contiguous source rows. Source pixel
+/// (x, y) is written to `dst + x * dstXStep + y * dstYStep`.
+///
+/// One of the steps must be 1 or -1, so this is a plain, mirrored or
+/// transposed copy. Transposes are done in 8x8 blocks in registers.
+void
+copyStrided(uint16_t* dst,
+            std::ptrdiff_t dstXStep,
+            std::ptrdiff_t dstYStep,
+            const uint16_t* src,
+            std::ptrdiff_t srcStride,
+            int width,
+            int height);
+
+} // namespace rmlib::simd
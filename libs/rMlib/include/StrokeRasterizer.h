@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Canvas.h"
+#include "MathUtil.h"
+
+#include <cstdint>
+#include <optional>
+
+namespace rmlib {
+
+/// A sample of a stroke, for example from the pen. The width usually
+/// follows the pressure.
+struct StrokePoint {
+  float x = 0;
+  float y = 0;
+  float width = 1;
+};
+
+/// Rasterises strokes of varying width a scanline span at a time. A segment
+/// is the convex hull of the discs at its end points, so consecutive segments
+/// join without gaps or seams.
+///
+/// With anti-aliasing only the pixels at the edge of each span are blended,
+/// the inside is filled.
+class StrokeRasterizer {
+public:
+  explicit StrokeRasterizer(uint8_t grey = 0, bool antiAlias = true);
+
+  /// Adds a point to the current stroke, drawing the segment from the
+  /// previous point, or a disc for the first point.
+  /// \returns The rect of changed pixels, empty if none changed.
+  Rect addPoint(Canvas& canvas, StrokePoint point);
+
+  /// Ends the current stroke, the next point starts a new one.
+  void end() { lastPoint.reset(); }
+
+  Rect drawDisk(Canvas& canvas, StrokePoint point);
+  Rect drawSegment(Canvas& canvas, StrokePoint from, StrokePoint to);
+
+private:
+  /// Draws the segment, `joined` to the previous one at `from`.
+  Rect draw(Canvas& canvas, StrokePoint from, StrokePoint to, bool joined);
+
+  uint8_t grey;
+  uint16_t color;
+  bool antiAlias;
+
+  std::optional<StrokePoint> lastPoint;
+};
+
+} // namespace rmlib
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Error.h"
+
+#include <string>
+
+/// Traces where the time of a frame goes, as Chrome trace events that can be
+/// opened in Perfetto or chrome://tracing. Only the UI thread is traced.
+namespace rmlib::trace {
+
+namespace details {
+extern bool enabled; // NOLINT
+
+int
+begin(const char* phase, const char* name, int id, const char* reason);
+
+void
+end(int event);
+} // namespace details
+
+/// Starts writing the trace to the file, see \ref AppContext::makeContext.
+OptError<>
+start(const char* path);
+
+void
+stop();
+
+inline bool
+isEnabled() {
+  return details::enabled;
+}
+
+/// Ends the frame, writing its events to the trace.
+/// \returns A summary of the frame: the time of each phase and the render
+/// objects that did work in it, with why. Empty if none did.
+std::string
+endFrame();
+
+/// Traces the time until it's destroyed. Only costs a branch when tracing
+/// is disabled.
+///
+/// A scope with a name is the work of one object, identified by the name
+/// and id, done for the reason. Scopes nested in it of the same phase with
+/// reasons are counted as part of it in the summary.
+class Scope {
+public:
+  Scope() = default;
+
+  explicit Scope(const char* phase,
+                 const char* name = nullptr,
+                 int id = -1,
+                 const char* reason = nullptr)
+    : event(details::enabled ? details::begin(phase, name, id, reason) : -1) {
+  }
+
+  ~Scope() {
+    if (event >= 0) {
+      details::end(event);
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  int event = -1;
+};
+
+} // namespace rmlib::trace
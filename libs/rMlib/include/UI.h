@@ -1,5 +1,6 @@
 #pragma once
 
+#include <UI/Keyed.h>
 #include <UI/RenderObject.h>
 #include <UI/Widget.h>
 
@@ -29,37 +30,27 @@
 //    scene tree.
 namespace rmlib {
 
-namespace details {
-static inline AppContext* currentContext = nullptr; // NOLINT
-
-inline void
-stop(int signal) {
-  currentContext->stop();
-}
-
-} // namespace details
-
 template<typename AppWidget>
 OptError<>
 runApp(AppWidget widget,
        std::optional<Size> size = {},
-       bool clearOnExit = false) {
-  auto context = TRY(AppContext::makeContext(size));
-  details::currentContext = &context;
+       bool clearOnExit = false,
+       std::optional<int> overlay = {}) {
+  auto context = TRY(AppContext::makeContext(size, overlay));
 
   // TODO: fix widget lifetime
   context.setRootRenderObject(widget.createRenderObject());
 
-  std::signal(SIGINT, details::stop);
-  std::signal(SIGTERM, details::stop);
+  context.onSignal(SIGINT, [&context] { context.stop(); });
+  context.onSignal(SIGTERM, [&context] { context.stop(); });
 
   while (!context.shouldStop()) {
     context.step();
   }
 
-  std::signal(SIGINT, SIG_DFL);
-  std::signal(SIGTERM, SIG_DFL);
-  details::currentContext = nullptr;
+  if (context.isReplaying()) {
+    TRY(context.finishReplay());
+  }
 
   if (clearOnExit) {
     context.getFramebuffer().clear();
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace rmlib {
+
+/// A bump allocator, memory is only freed all at once by \ref reset. The
+/// blocks are kept, so once warmed up allocating doesn't touch the heap.
+class Arena {
+public:
+  static constexpr std::size_t default_block_size = 4096;
+
+  explicit Arena(std::size_t blockSize = default_block_size)
+    : blockSize(blockSize) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&&) = default;
+  Arena& operator=(Arena&&) = default;
+
+  void* allocate(std::size_t size, std::size_t align) {
+    while (true) {
+      if (current < blocks.size()) {
+        auto& block = blocks[current];
+        auto space = block.size - used;
+        void* ptr = block.memory.get() + used;
+        if (std::align(align, size, ptr, space) != nullptr) {
+          used = block.size - space + size;
+          return ptr;
+        }
+
+        if (current + 1 < blocks.size()) {
+          current++;
+          used = 0;
+          continue;
+        }
+      }
+
+      const auto newSize = std::max(blockSize, size + align);
+      blocks.emplace_back(
+        Block{ std::make_unique<std::byte[]>(newSize), newSize });
+      current = blocks.size() - 1;
+      used = 0;
+    }
+  }
+
+  /// Frees everything allocated. The objects in it must be destroyed.
+  void reset() {
+    current = 0;
+    used = 0;
+  }
+
+  std::size_t capacity() const {
+    std::size_t result = 0;
+    for (const auto& block : blocks) {
+      result += block.size;
+    }
+    return result;
+  }
+
+  /// The arena of the widgets being built, see \ref Scope.
+  static Arena* getCurrent() { return currentArena; }
+
+  /// Makes the arena current until destroyed.
+  class Scope {
+  public:
+    explicit Scope(Arena& arena) : previous(currentArena) {
+      currentArena = &arena;
+    }
+    ~Scope() { currentArena = previous; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    Arena* previous;
+  };
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> memory; // NOLINT
+    std::size_t size;
+  };
+
+  static inline Arena* currentArena = nullptr; // NOLINT
+
+  std::size_t blockSize;
+  std::vector<Block> blocks;
+  std::size_t current = 0;
+  std::size_t used = 0;
+};
+
+struct PoolStats {
+  /// Memory taken from the heap, which is never given back.
+  std::size_t slabs = 0;
+
+  /// Allocations that aren't freed yet.
+  std::size_t live = 0;
+};
+
+/// Allocates small objects from free lists of a few size classes, so freed
+/// objects are reused by the next ones of about the same size. Only for the
+/// UI thread, which creates and destroys all render objects.
+class Pool {
+public:
+  static constexpr std::size_t granularity = alignof(std::max_align_t);
+  static constexpr std::size_t max_pooled_size = 512;
+  static constexpr std::size_t slab_size = 16384;
+
+  static void* allocate(std::size_t size) {
+    if (size > max_pooled_size) {
+      return ::operator new(size);
+    }
+
+    auto& pool = get();
+    auto& freeList = pool.freeLists[sizeClass(size)];
+    if (freeList == nullptr) {
+      pool.addSlab(sizeClass(size));
+    }
+
+    auto* node = freeList;
+    freeList = node->next;
+    pool.stats.live++;
+    return node;
+  }
+
+  static void deallocate(void* ptr, std::size_t size) noexcept {
+    if (size > max_pooled_size) {
+      ::operator delete(ptr);
+      return;
+    }
+
+    auto& pool = get();
+    auto& freeList = pool.freeLists[sizeClass(size)];
+    freeList = new (ptr) Node{ freeList };
+    pool.stats.live--;
+  }
+
+  static const PoolStats& getStats() { return get().stats; }
+
+private:
+  struct Node {
+    Node* next;
+  };
+
+  static constexpr std::size_t num_classes = max_pooled_size / granularity;
+
+  static constexpr std::size_t sizeClass(std::size_t size) {
+    return (std::max<std::size_t>(size, 1) - 1) / granularity;
+  }
+
+  /// Never destroyed, render objects can outlive static destructors.
+  static Pool& get() {
+    static auto* pool = new Pool(); // NOLINT
+    return *pool;
+  }
+
+  void addSlab(std::size_t index) {
+    const auto size = (index + 1) * granularity;
+    auto* slab = static_cast<std::byte*>(::operator new(slab_size));
+    stats.slabs++;
+
+    for (auto offset = slab_size - slab_size % size; offset >= size;) {
+      offset -= size;
+      freeLists[index] = new (slab + offset) Node{ freeLists[index] };
+    }
+  }
+
+  std::array<Node*, num_classes> freeLists{};
+  PoolStats stats;
+};
+
+} // namespace rmlib
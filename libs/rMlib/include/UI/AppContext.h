@@ -1,19 +1,58 @@
 #pragma once
 
+#include <EventLoop.h>
 #include <Input.h>
+#include <Trace.h>
 #include <UI/RenderObject.h>
 #include <UI/Timer.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <utility>
 #include <vector>
 
 namespace rmlib {
 
 class AppContext {
 public:
-  static ErrorOr<AppContext> makeContext(std::optional<Size> size = {}) {
-    auto fb = TRY(fb::FrameBuffer::open(size));
-    auto ctx = AppContext(std::move(fb));
-    TRY(ctx.inputManager.openAll());
+  /// Creates a context, drawing to the given rm2fb overlay if possible.
+  ///
+  /// The input of all devices is recorded to the directory in
+  /// `RM2STUFF_INPUT_RECORD`. The recordings in `RM2STUFF_INPUT_REPLAY` are
+  /// replayed instead of reading the devices, as fast as frames are drawn,
+  /// or at the recorded times if `RM2STUFF_REPLAY_REALTIME` is set. The app
+  /// stops when the replay ends, see \ref finishReplay.
+  ///
+  /// Frames are traced to the file in `RM2STUFF_TRACE`, see \ref trace.
+  static ErrorOr<AppContext> makeContext(std::optional<Size> size = {},
+                                         std::optional<int> overlay = {}) {
+#ifdef EMULATE
+    if (getenv("RM2STUFF_INPUT_REPLAY") != nullptr) {
+      rmlibDisableWindow = true;
+    }
+#endif
+
+    auto fb = [&]() -> ErrorOr<fb::FrameBuffer> {
+      if (overlay.has_value()) {
+        auto overlayFb = fb::FrameBuffer::openOverlay(*overlay);
+        if (overlayFb.has_value()) {
+          return overlayFb;
+        }
+        std::cerr << "Not using overlay: " << overlayFb.error().msg << "\n";
+      }
+      return fb::FrameBuffer::open(size);
+    }();
+    auto ctx = AppContext(TRY(fb), TRY(EventLoop::create()));
+    TRY(ctx.openInput());
+
+    if (const auto* path = getenv("RM2STUFF_TRACE"); path != nullptr) {
+      if (auto err = trace::start(path); !err.has_value()) {
+        std::cerr << "Not tracing: " << err.error().msg << "\n";
+      }
+    }
     return ctx;
   }
 
@@ -21,38 +60,7 @@ public:
     std::chrono::microseconds duration,
     Callback trigger,
     std::optional<std::chrono::microseconds> repeat = std::nullopt) {
-    auto [timer, handle] =
-      Timer::makeTimer(duration, std::move(trigger), repeat);
-    timers.emplace(std::move(timer));
-    return std::move(handle);
-  }
-
-  std::optional<std::chrono::microseconds> getNextDuration() const {
-    if (timers.empty()) {
-      return std::nullopt;
-    }
-
-    auto duration = timers.top()->getDuration();
-    if (duration < std::chrono::microseconds(0)) {
-      return std::chrono::microseconds(0);
-    }
-    return duration;
-  }
-
-  void checkTimers() {
-    while (!timers.empty()) {
-      std::shared_ptr<Timer> top = timers.top();
-      if (top->check()) {
-        timers.pop();
-
-        if (top->repeats()) {
-          top->reset();
-          timers.emplace(std::move(top));
-        }
-      } else {
-        break;
-      }
-    }
+    return loop.addTimer(duration, std::move(trigger), repeat);
   }
 
   void stop() { mShouldStop = true; }
@@ -60,6 +68,10 @@ public:
   bool shouldStop() const { return mShouldStop; }
 
   void doLater(Callback fn) { doLaters.emplace_back(std::move(fn)); }
+
+  /// Calls the function once the next frame is drawn and its updates are
+  /// sent to the framebuffer.
+  void afterFrame(Callback fn) { afterFrames.emplace_back(std::move(fn)); }
   void doAllLaters() {
     for (const auto& doLater : doLaters) {
       doLater();
@@ -78,51 +90,96 @@ public:
   }
 
   void listenFd(int fd, Callback callback) {
-    extraFds.emplace(fd, std::move(callback));
+    if (auto err = loop.addFd(fd, std::move(callback)); !err.has_value()) {
+      std::cerr << "Error listening to " << fd << ": " << err.error().msg
+                << "\n";
+    }
+  }
+
+  void stopListening(int fd) { loop.removeFd(fd); }
+
+  /// Calls the callback from the loop when the signal is received.
+  void onSignal(int signal, Callback callback) {
+    if (auto err = loop.addSignal(signal, std::move(callback));
+        !err.has_value()) {
+      std::cerr << "Error handling signal " << signal << ": "
+                << err.error().msg << "\n";
+    }
   }
 
-  ErrorOr<std::vector<input::Event>> waitForInput(
-    std::optional<std::chrono::microseconds> durantion) {
+  /// Waits for input, an extra fd, a timer or the duration, and reads the
+  /// input events into \ref getInputEvents. Fd, timer and signal callbacks
+  /// are called from here.
+  OptError<> waitForInput(std::optional<std::chrono::microseconds> durantion) {
 
     const auto milliDuration =
-      [durantion]() -> std::optional<std::chrono::milliseconds> {
-      if (!durantion.has_value()) {
+      [timeout = loop.getTimeout(durantion)]()
+      -> std::optional<std::chrono::milliseconds> {
+      if (!timeout.has_value()) {
         return {};
       }
-      return std::chrono::duration_cast<std::chrono::milliseconds>(*durantion);
+      return std::chrono::ceil<std::chrono::milliseconds>(*timeout);
     }();
 
     std::size_t startDevices = inputManager.numDevices();
-    std::vector<input::Event> result;
 
-    if (!extraFds.empty()) {
-      std::vector<pollfd> pollFds;
-      for (const auto& [fd, _] : extraFds) {
-        pollFds.emplace_back(
-          pollfd{ .fd = fd, .events = POLLIN, .revents = 0 });
+    TRY(inputManager.waitForInput(
+      inputEvents, loop.getPollFds(), milliDuration));
+    TRY(loop.dispatch());
+
+    if (inputManager.numDevices() != startDevices) {
+      for (const auto& onDeviceUpdate : onDeviceUpdates) {
+        onDeviceUpdate();
       }
+    }
 
-      auto evs = TRY(inputManager.waitForInput(pollFds, milliDuration));
+    return {};
+  }
 
-      for (const auto& poll : pollFds) {
-        if (unistdpp::canRead(poll)) {
-          extraFds[poll.fd]();
-        }
-      }
+  input::EventRing& getInputEvents() { return inputEvents; }
+
+  bool isReplaying() const { return replaying; }
+
+  /// Reports the time spent drawing each frame of the replay. If
+  /// `RM2STUFF_REPLAY_GOLDEN` is set, the screen is compared to that image,
+  /// or written to it when it doesn't exist yet.
+  OptError<> finishReplay() {
+    if (!frameTimes.empty()) {
+      std::sort(frameTimes.begin(), frameTimes.end());
+      const auto total = std::accumulate(frameTimes.begin(),
+                                         frameTimes.end(),
+                                         std::chrono::microseconds(0));
+      const auto percentile = [this](int p) {
+        return frameTimes[(frameTimes.size() - 1) * p / 100].count();
+      };
+      std::cout << "Replayed " << frameTimes.size() << " frames, avg "
+                << total.count() / long(frameTimes.size()) << " us, p50 "
+                << percentile(50) << " us, p95 " << percentile(95)
+                << " us, max " << frameTimes.back().count() << " us\n";
+    }
 
-      result = std::move(evs);
-    } else {
-      auto evs = TRY(inputManager.waitForInput(milliDuration));
-      result = std::move(evs);
+    const auto* golden = getenv("RM2STUFF_REPLAY_GOLDEN");
+    if (golden == nullptr) {
+      return {};
     }
 
-    if (inputManager.numDevices() != startDevices) {
-      for (const auto& onDeviceUpdate : onDeviceUpdates) {
-        onDeviceUpdate();
-      }
+    // Compared as written, so the image format doesn't matter.
+    const auto actualPath = std::string(golden) + ".actual.png";
+    TRY(framebuffer.canvas.writeImage(actualPath.c_str()));
+    const auto expected = ImageCanvas::loadRaw(golden);
+    if (!expected.has_value()) {
+      std::rename(actualPath.c_str(), golden);
+      std::cout << "Wrote golden image " << golden << "\n";
+      return {};
     }
 
-    return result;
+    const auto actual = ImageCanvas::loadRaw(actualPath.c_str());
+    if (!actual.has_value() || !actual->canvas.compare(expected->canvas)) {
+      return Error::make("Screen differs from " + std::string(golden) +
+                         ", see " + actualPath);
+    }
+    std::remove(actualPath.c_str());
+    return {};
   }
 
   void setRootRenderObject(std::unique_ptr<RenderObject> obj) {
@@ -132,35 +189,81 @@ public:
   RenderObject& getRootRenderObject() { return *rootRO; }
 
   void step() {
-    rootRO->rebuild(*this, nullptr);
-    rootRO->layout(rootConstraints);
+    const auto frameStart = std::chrono::steady_clock::now();
+    {
+      const auto scope = trace::Scope("rebuild");
+      rootRO->rebuild(*this, nullptr);
+    }
+    {
+      const auto scope = trace::Scope("layout");
+      RenderObject::resetLayoutCount();
+      rootRO->layout(rootConstraints);
+    }
+
+    auto updateRegion = UpdateRegion{};
+    {
+      const auto scope = trace::Scope("cleanup");
+      updateRegion = rootRO->cleanup(framebuffer.canvas);
+    }
+    {
+      const auto scope = trace::Scope("draw");
+      updateRegion |= rootRO->draw(framebuffer.canvas, { 0, 0 });
+    }
+    {
+      const auto scope = trace::Scope("update");
+      for (const auto& rect : updateRegion) {
+        framebuffer.doUpdate(rect.region, rect.waveform, rect.flags);
+      }
+      for (const auto& fn : std::exchange(afterFrames, {})) {
+        fn();
+      }
+    }
 
-    auto updateRegion = rootRO->cleanup(framebuffer.canvas);
-    updateRegion |= rootRO->draw(framebuffer.canvas, { 0, 0 });
+    if (replaying) {
+      frameTimes.emplace_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - frameStart));
 
-    if (!updateRegion.region.empty()) {
-      framebuffer.doUpdate(
-        updateRegion.region, updateRegion.waveform, updateRegion.flags);
+      // The last replayed events are drawn.
+      if (!inputManager.isReplaying()) {
+        stop();
+        return;
+      }
     }
 
-    const auto duration = getNextDuration();
-    const auto evsOrError = waitForInput(duration);
-    checkTimers();
-    doAllLaters();
+    const auto err = [this] {
+      const auto scope = trace::Scope("wait");
+      // Don't wait for input to handle the last moves of a pointer.
+      return waitForInput(
+        RenderObject::hasPendingMoves()
+          ? std::optional<std::chrono::microseconds>(
+              RenderObject::resample_latency)
+          : std::nullopt);
+    }();
+
+    {
+      const auto scope = trace::Scope("input");
+      doAllLaters();
 
-    if (!evsOrError.has_value()) {
-      std::cerr << evsOrError.error().msg << std::endl;
-    } else {
-      for (const auto& ev : *evsOrError) {
-        rootRO->handleInput(ev);
+      if (!err.has_value()) {
+        std::cerr << err.error().msg << std::endl;
       }
+      while (!inputEvents.empty()) {
+        rootRO->handleInput(inputEvents.pop());
+      }
+      RenderObject::handlePendingMoves(input::EventClock::now());
     }
 
     rootRO->reset();
+
+    if (trace::isEnabled()) {
+      std::cout << trace::endFrame();
+    }
   }
 
 protected:
-  AppContext(fb::FrameBuffer fb) : framebuffer(std::move(fb)) {
+  AppContext(fb::FrameBuffer fb, EventLoop loop)
+    : framebuffer(std::move(fb)), loop(std::move(loop)) {
     const auto fbSize =
       Size{ framebuffer.canvas.width(), framebuffer.canvas.height() };
     rootConstraints = Constraints{ fbSize, fbSize };
@@ -169,17 +272,49 @@ protected:
   fb::FrameBuffer framebuffer; // NOLINT (not private)
 
 private:
+  OptError<> openInput() {
+    if (const auto* dir = getenv("RM2STUFF_INPUT_REPLAY"); dir != nullptr) {
+      const auto speed = getenv("RM2STUFF_REPLAY_REALTIME") != nullptr
+                           ? input::ReplaySpeed::RealTime
+                           : input::ReplaySpeed::Fast;
+      TRY(inputManager.openReplay(dir, speed));
+
+      // Without the input thread, so no events are left in its queue when
+      // the replay ends.
+      replaying = true;
+      return {};
+    }
+
+    TRY(inputManager.openAll());
+
+    if (const auto* dir = getenv("RM2STUFF_INPUT_RECORD"); dir != nullptr) {
+      TRY(inputManager.startRecording(dir));
+    }
+
+    // Reading input on its own thread keeps slow frames from delaying it.
+    if (getenv("RM2STUFF_INPUT_THREAD") != nullptr) {
+      if (auto err = inputManager.startThread(); !err.has_value()) {
+        std::cerr << "No input thread: " << err.error().msg << "\n";
+      }
+    }
+    return {};
+  }
+
   input::InputManager inputManager;
+  EventLoop loop;
 
-  TimerQueue timers;
   // TODO: use handles to destroy these
   std::vector<Callback> doLaters;
+  std::vector<Callback> afterFrames;
   std::vector<Callback> onDeviceUpdates;
 
-  std::unordered_map<int, Callback> extraFds;
+  input::EventRing inputEvents;
 
   bool mShouldStop = false;
 
+  bool replaying = false;
+  std::vector<std::chrono::microseconds> frameTimes;
+
   std::unique_ptr<RenderObject> rootRO;
   Constraints rootConstraints{};
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <UI/Keyed.h>
 #include <UI/RenderObject.h>
 #include <UI/TypeID.h>
 
@@ -22,9 +23,25 @@ private:
   struct DynamicWidgetBase {
     virtual std::unique_ptr<RenderObject> createRenderObject() const = 0;
     virtual void update(RenderObject& ro) const = 0;
+    virtual const Key* getKey() const = 0;
     virtual ~DynamicWidgetBase() = default;
   };
 
+  /// Only destroys widgets in an arena, the arena frees them.
+  struct Deleter {
+    bool inArena = false;
+
+    void operator()(DynamicWidgetBase* widget) const {
+      if (inArena) {
+        widget->~DynamicWidgetBase();
+      } else {
+        delete widget;
+      }
+    }
+  };
+
+  using WidgetPtr = std::unique_ptr<DynamicWidgetBase, Deleter>;
+
   template<typename W>
   struct DynamicWidgetImpl : public DynamicWidgetBase {
     DynamicWidgetImpl(W w) : widget(std::move(w)) {}
@@ -42,14 +59,27 @@ private:
       }
     }
 
+    const Key* getKey() const final { return rmlib::getKey(widget); }
+
   private:
     W widget;
   };
 
+  /// Widgets built by a stateful widget are in its arena, see
+  /// \ref StatefulRenderObject.
+  template<typename W>
+  static WidgetPtr makeWidget(W w) {
+    using Impl = DynamicWidgetImpl<W>;
+    if (auto* arena = Arena::getCurrent(); arena != nullptr) {
+      auto* memory = arena->allocate(sizeof(Impl), alignof(Impl));
+      return WidgetPtr(new (memory) Impl(std::move(w)), Deleter{ true });
+    }
+    return WidgetPtr(new Impl(std::move(w)), Deleter{ false });
+  }
+
 public:
   template<typename W>
-  DynamicWidget(W w)
-    : mWidget(std::make_unique<DynamicWidgetImpl<W>>(std::move(w))) {}
+  DynamicWidget(W w) : mWidget(makeWidget(std::move(w))) {}
 
   std::unique_ptr<RenderObject> createRenderObject() const {
     return mWidget->createRenderObject();
@@ -57,9 +87,11 @@ public:
 
   void update(RenderObject& ro) const { mWidget->update(ro); }
 
+  const Key* getKey() const { return mWidget->getKey(); }
+
 private:
   // TODO: shared pointer? A widget should be copyable...
-  std::unique_ptr<DynamicWidgetBase> mWidget;
+  WidgetPtr mWidget;
 };
 
 } // namespace rmlib
@@ -20,13 +20,18 @@ struct Gestures {
   KeyCallback onKeyDownFn;
   KeyCallback onKeyUpFn;
 
+  MovePolicy movePolicy = MovePolicy::Each;
+
   Gestures& onTap(Callback cb) {
     onTapFn = std::move(cb);
     return *this;
   }
 
-  Gestures& onTouchMove(PosCallback cb) {
+  /// Dragging usually only needs the latest position each frame, pass
+  /// \ref MovePolicy::Coalesce to get one move a frame.
+  Gestures& onTouchMove(PosCallback cb, MovePolicy policy = MovePolicy::Each) {
     onTouchMoveFn = std::move(cb);
+    movePolicy = policy;
     return *this;
   }
 
@@ -62,8 +67,10 @@ template<typename Child>
 class GestureRenderObject
   : public SingleChildRenderObject<GestureDetector<Child>> {
 public:
-  using SingleChildRenderObject<
-    GestureDetector<Child>>::SingleChildRenderObject;
+  GestureRenderObject(const GestureDetector<Child>& widget)
+    : SingleChildRenderObject<GestureDetector<Child>>(widget) {
+    this->setMovePolicy(widget.gestures.movePolicy);
+  }
 
   void doHandleInput(const rmlib::input::Event& ev) final {
     if (this->widget->gestures.onAnyFn) {
@@ -92,6 +99,7 @@ public:
 
   void update(const GestureDetector<Child>& newWidget) {
     this->widget = &newWidget;
+    this->setMovePolicy(newWidget.gestures.movePolicy);
     this->widget->child.update(*this->child);
   }
 
@@ -113,7 +121,10 @@ private:
     if (ev.id == currentId) {
       if (ev.isUp()) {
         currentId = -1;
-        if (this->widget->gestures.onTapFn) {
+
+        // Released somewhere else, like at the end of a swipe.
+        if (this->widget->gestures.onTapFn &&
+            this->getLocalRect().contains(ev.location)) {
           this->widget->gestures.onTapFn();
         }
         return true;
@@ -96,9 +96,8 @@ protected:
     const auto& rect = canvas.rect();
     const auto& image = widget->canvas;
 
-    if (image.rect().size() == rect.size() &&
-        image.rotation() == canvas.rotation()) {
-      canvas.copy(image);
+    if (image.rect().size() == rect.size()) {
+      canvas.drawImage(image, rect.topLeft);
       return UpdateRegion{ rect };
     }
 
@@ -121,6 +120,12 @@ protected:
       }
     }
 
+    // Unscaled, but centered in one direction.
+    if (scaleX == 1.0F && scaleY == 1.0F) {
+      canvas.drawImage(image, rect.topLeft + Point{ offsetX, offsetY });
+      return UpdateRegion{ rect };
+    }
+
     canvas.transform(
       [&](int x, int y, int old) {
         auto subY = int(float(y - rect.topLeft.y - offsetY) / scaleY);
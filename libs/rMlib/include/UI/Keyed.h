@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+namespace rmlib {
+
+class RenderObject;
+
+/// Identifies a child among its siblings, so its render object is kept when
+/// children are inserted or removed before it, see \ref Keyed.
+class Key {
+public:
+  Key(long long value) : value(value) {}
+  Key(std::string value) : value(std::move(value)) {}
+  Key(const char* value) : value(std::string(value)) {}
+
+  bool operator==(const Key& other) const { return value == other.value; }
+  bool operator!=(const Key& other) const { return !(*this == other); }
+
+  struct Hash {
+    std::size_t operator()(const Key& key) const {
+      return std::hash<std::variant<long long, std::string>>{}(key.value);
+    }
+  };
+
+private:
+  std::variant<long long, std::string> value;
+};
+
+/// Gives the child a key. The children of multi child widgets are matched to
+/// their render objects by key, and by index if they have none.
+template<typename Child>
+class Keyed {
+public:
+  Keyed(Key key, Child child) : key(std::move(key)), child(std::move(child)) {}
+
+  std::unique_ptr<RenderObject> createRenderObject() const {
+    return child.createRenderObject();
+  }
+
+  void update(RenderObject& ro) const { child.update(ro); }
+
+  const Key* getKey() const { return &key; }
+
+private:
+  Key key;
+  Child child;
+};
+
+namespace details {
+template<typename W, typename = void>
+struct HasKey : std::false_type {};
+
+template<typename W>
+struct HasKey<W, std::void_t<decltype(std::declval<const W&>().getKey())>>
+  : std::true_type {};
+} // namespace details
+
+/// \returns The key of the widget, or null if it has none.
+template<typename W>
+const Key*
+getKey(const W& widget) {
+  if constexpr (details::HasKey<W>::value) {
+    return widget.getKey();
+  } else {
+    return nullptr;
+  }
+}
+
+} // namespace rmlib
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <UI/DynamicWidget.h>
+#include <UI/RenderObject.h>
+#include <UI/Widget.h>
+
+#include <deque>
+#include <functional>
+#include <optional>
+
+namespace rmlib {
+
+/// Builds the item at the index, see \ref ListView and \ref GridView.
+using ItemBuilder = std::function<DynamicWidget(int)>;
+
+/// Shows the items of a list or grid a page at a time. Only the items of the
+/// current page have render objects, and the recent pages in a cache. Items
+/// leaving the cache have their render objects reused by the new ones.
+///
+/// A swipe along the axis goes to the next or previous page. So the view is
+/// refreshed once per page instead of for each step of a scroll.
+template<typename Widget>
+class PagedRenderObject : public MultiChildRenderObject<Widget> {
+public:
+  /// How far a pointer has to move to turn the page.
+  static constexpr int swipe_distance = 100;
+
+  PagedRenderObject(const Widget& widget)
+    : MultiChildRenderObject<Widget>({}), widget(&widget) {
+    this->markNeedsRebuild();
+  }
+
+  void update(const Widget& newWidget) {
+    widget = &newWidget;
+    itemsChanged = true;
+    this->markNeedsLayout();
+  }
+
+  int getPage() const { return page; }
+  int getPageCount() const { return pageCount; }
+
+  void setPage(int newPage) {
+    newPage = std::clamp(newPage, 0, pageCount - 1);
+    if (newPage == page) {
+      return;
+    }
+    page = newPage;
+    this->markNeedsLayout();
+    this->markNeedsDraw();
+  }
+
+  void doHandleInput(const input::Event& ev) override {
+    std::visit(
+      [this](auto ev) {
+        if constexpr (input::is_pointer_event<decltype(ev)>) {
+          handleSwipe(ev);
+        }
+        MultiChildRenderObject<Widget>::doHandleInput(ev);
+      },
+      ev);
+  }
+
+protected:
+  Size doLayout(const Constraints& constraints) override {
+    assert(constraints.isBounded() && "Paged views need a bounded size");
+    const auto size = constraints.max;
+
+    cellSize = widget->getCellSize(size);
+    assert(cellSize.width > 0 && cellSize.height > 0);
+
+    perLine = std::max(1,
+                       isVertical() ? size.width / cellSize.width
+                                    : size.height / cellSize.height);
+    const auto lines = std::max(1,
+                                isVertical() ? size.height / cellSize.height
+                                             : size.width / cellSize.width);
+    pageSize = perLine * lines;
+    pageCount = std::max(1, (widget->itemCount + pageSize - 1) / pageSize);
+    page = std::min(page, pageCount - 1);
+
+    updateItems();
+
+    const auto itemConstraints = widget->getItemConstraints(cellSize);
+    for (const auto& child : this->children) {
+      child->layout(itemConstraints);
+    }
+    return size;
+  }
+
+  UpdateRegion doDraw(Canvas& canvas) override {
+    UpdateRegion result;
+    for (std::size_t i = 0; i < this->children.size(); i++) {
+      const auto& child = this->children[i];
+      const auto cell = getCell(int(i));
+      const auto offset = cell.align(child->getSize(), 0.5, 0.5).topLeft;
+      result |= child->draw(canvas, offset);
+    }
+    return result;
+  }
+
+  void doRebuild(AppContext& context,
+                 const BuildContext& /*buildContext*/) override {
+    this->context = &context;
+  }
+
+private:
+  struct Item {
+    int index;
+    DynamicWidget widget;
+    std::unique_ptr<RenderObject> renderObject;
+
+    /// Built by a previous widget, so it must be built again to be shown.
+    bool stale = false;
+  };
+
+  bool isVertical() const { return widget->axis == Axis::Vertical; }
+
+  Rect getCell(int index) const {
+    const auto line = index / perLine;
+    const auto pos = index % perLine;
+    const auto topLeft =
+      isVertical() ? Point{ pos * cellSize.width, line * cellSize.height }
+                   : Point{ line * cellSize.width, pos * cellSize.height };
+    return Rect{ topLeft, topLeft + cellSize.toPoint() };
+  }
+
+  /// Builds the items of the page. They're built during layout, as the page
+  /// size is only known then, with the context of the last rebuild.
+  void updateItems() {
+    const auto first = page * pageSize;
+    const auto count =
+      std::max(0, std::min(pageSize, widget->itemCount - first));
+    const auto moved =
+      first != firstIndex || count != int(this->children.size());
+    if (!itemsChanged && !moved) {
+      return;
+    }
+
+    // The items of the old page are the most recent in the cache.
+    for (std::size_t i = 0; i < this->children.size(); i++) {
+      cache.push_front(Item{ firstIndex + int(i),
+                             std::move(widgets[i]),
+                             std::move(this->children[i]) });
+    }
+    this->children.clear();
+    widgets.clear();
+    if (itemsChanged) {
+      for (auto& item : cache) {
+        item.stale = true;
+      }
+    }
+
+    // Take the items that are still built first, so they aren't reused.
+    auto items = std::vector<std::optional<Item>>(std::size_t(count));
+    for (int i = 0; i < count; i++) {
+      auto it =
+        std::find_if(cache.begin(), cache.end(), [&](const auto& item) {
+          return item.index == first + i;
+        });
+      if (it != cache.end()) {
+        items[i].emplace(std::move(*it));
+        cache.erase(it);
+      }
+    }
+
+    const auto capacity = std::size_t(widget->cachePages * pageSize);
+    for (int i = 0; i < count; i++) {
+      auto& item = items[i];
+      auto reused = false;
+      if (!item.has_value() && cache.size() > capacity) {
+        item.emplace(std::move(cache.back()));
+        cache.pop_back();
+        item->stale = true;
+        reused = true;
+      }
+
+      if (!item.has_value()) {
+        auto built = widget->builder(first + i);
+        auto ro = built.createRenderObject();
+        item.emplace(Item{ first + i, std::move(built), std::move(ro) });
+      } else if (item->stale) {
+        auto built = widget->builder(first + i);
+        built.update(*item->renderObject);
+        item->widget = std::move(built);
+        item->index = first + i;
+        item->stale = false;
+      }
+
+      if (context != nullptr) {
+        item->renderObject->rebuild(*context, this->getBuildContext());
+      }
+      // Reused for an item in another cell.
+      if (reused) {
+        item->renderObject->markNeedsDraw();
+      }
+    }
+
+    while (cache.size() > capacity) {
+      cache.pop_back();
+    }
+
+    this->children.reserve(count);
+    widgets.reserve(count);
+    for (auto& item : items) {
+      this->children.emplace_back(std::move(item->renderObject));
+      widgets.emplace_back(std::move(item->widget));
+    }
+
+    // Another page, or items were added or removed, so draw all of them.
+    if (moved) {
+      this->markNeedsDraw();
+    }
+    firstIndex = first;
+    itemsChanged = false;
+  }
+
+  template<typename Ev>
+  void handleSwipe(Ev& ev) {
+    if (ev.isDown() && swipeId == -1 &&
+        this->getLocalRect().contains(ev.location)) {
+      swipeId = ev.id;
+      swipeStart = ev.location;
+      return;
+    }
+
+    if (!ev.isUp() || ev.id != swipeId) {
+      return;
+    }
+    swipeId = -1;
+
+    const auto diff = ev.location - swipeStart;
+    const auto along = isVertical() ? diff.y : diff.x;
+    const auto across = isVertical() ? diff.x : diff.y;
+    if (std::abs(along) < swipe_distance ||
+        std::abs(along) < std::abs(across)) {
+      return;
+    }
+
+    setPage(page + (along < 0 ? 1 : -1));
+
+    // Released outside of the items, so the swipe isn't a tap.
+    ev.location = { -1, -1 };
+  }
+
+  const Widget* widget;
+  AppContext* context = nullptr;
+
+  /// The widgets of the children, which refer to them.
+  std::vector<DynamicWidget> widgets;
+  std::deque<Item> cache;
+  bool itemsChanged = false;
+
+  Size cellSize{};
+  int perLine = 1;
+  int pageSize = 1;
+  int pageCount = 1;
+  int page = 0;
+  int firstIndex = -1;
+
+  int swipeId = -1;
+  Point swipeStart;
+};
+
+/// A list of items of the same extent along the axis, which fill the other
+/// axis. Only the page that fits is built, see \ref PagedRenderObject.
+class ListView : public Widget<PagedRenderObject<ListView>> {
+public:
+  ListView(int itemCount,
+           ItemBuilder builder,
+           int itemExtent,
+           Axis axis = Axis::Vertical,
+           int cachePages = 1)
+    : itemCount(itemCount)
+    , builder(std::move(builder))
+    , itemExtent(itemExtent)
+    , axis(axis)
+    , cachePages(cachePages) {}
+
+  std::unique_ptr<RenderObject> createRenderObject() const {
+    return std::make_unique<PagedRenderObject<ListView>>(*this);
+  }
+
+private:
+  friend class PagedRenderObject<ListView>;
+
+  Size getCellSize(Size viewport) const {
+    return axis == Axis::Vertical
+             ? Size{ viewport.width, std::min(itemExtent, viewport.height) }
+             : Size{ std::min(itemExtent, viewport.width), viewport.height };
+  }
+
+  Constraints getItemConstraints(Size cell) const {
+    return axis == Axis::Vertical ? Constraints{ { cell.width, 0 }, cell }
+                                  : Constraints{ { 0, cell.height }, cell };
+  }
+
+  int itemCount;
+  ItemBuilder builder;
+  int itemExtent;
+  Axis axis;
+  int cachePages;
+};
+
+/// A grid of items in cells of the same size, filled line by line across the
+/// axis. Items are centered in their cell.
+class GridView : public Widget<PagedRenderObject<GridView>> {
+public:
+  GridView(int itemCount,
+           ItemBuilder builder,
+           Size cellSize,
+           Axis axis = Axis::Vertical,
+           int cachePages = 1)
+    : itemCount(itemCount)
+    , builder(std::move(builder))
+    , cellSize(cellSize)
+    , axis(axis)
+    , cachePages(cachePages) {}
+
+  std::unique_ptr<RenderObject> createRenderObject() const {
+    return std::make_unique<PagedRenderObject<GridView>>(*this);
+  }
+
+private:
+  friend class PagedRenderObject<GridView>;
+
+  Size getCellSize(Size viewport) const {
+    return Size{ std::min(cellSize.width, viewport.width),
+                 std::min(cellSize.height, viewport.height) };
+  }
+
+  Constraints getItemConstraints(Size cell) const {
+    return Constraints{ { 0, 0 }, cell };
+  }
+
+  int itemCount;
+  ItemBuilder builder;
+  Size cellSize;
+  Axis axis;
+  int cachePages;
+};
+
+} // namespace rmlib
@@ -1,18 +1,38 @@
 #pragma once
 
 #include <Input.h>
+#include <Trace.h>
 
+#include <UI/Allocator.h>
 #include <UI/BuildContext.h>
+#include <UI/Keyed.h>
 #include <UI/TypeID.h>
 #include <UI/Util.h>
 
 #include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
 
 namespace rmlib {
 
 class AppContext;
 class RenderObject;
 
+/// How a render object handles pointer moves.
+enum class MovePolicy {
+  /// Each move as it's read.
+  Each,
+
+  /// Consecutive moves of a pointer in a frame as one, the last. All of
+  /// them are in \ref RenderObject::getMoveHistory while it's handled.
+  Coalesce,
+
+  /// Like Coalesce, but the move is interpolated at a fixed latency before
+  /// the end of the frame, so it follows the frame cadence.
+  Resample,
+};
+
 struct BuildContext {
   const RenderObject& renderObject; // NOLINT (TODO)
   const BuildContext* parent;
@@ -34,32 +54,70 @@ public:
 #endif
   }
 
+  /// Render objects are pooled, a rebuilt tree reuses the memory of the
+  /// objects it replaced.
+  static void* operator new(std::size_t size) { return Pool::allocate(size); }
+  static void operator delete(void* ptr, std::size_t size) {
+    Pool::deallocate(ptr, size);
+  }
+
   virtual ~RenderObject() {
 #ifndef NDEBUG
     std::cout << "free RO: " << mID << "\n";
 #endif
     roCount--;
+
+    std::replace(withPendingMoves.begin(),
+                 withPendingMoves.end(),
+                 this,
+                 static_cast<RenderObject*>(nullptr));
   }
 
+  /// Lays out the object, if it or a descendant needs it or the constraints
+  /// changed.
+  ///
+  /// Only marked objects are laid out again. When just descendants are
+  /// marked, they're laid out in place first, with their last constraints.
+  /// This object only does its layout again if one of their sizes changed,
+  /// so a child with tight constraints or an unchanged size is a relayout
+  /// boundary.
   Size layout(const Constraints& constraints) {
-    if (needsLayout() || constraints != lastConstraints) {
-      lastConstraints = constraints;
+    if (!needsLayout() && constraints == lastConstraints) {
+      return lastSize;
+    }
 
-      const auto result = doLayout(constraints);
-      assert(result.width != Constraints::unbound &&
-             result.height != Constraints::unbound);
-      assert(constraints.contain(result));
+    if (!mNeedsLayout && constraints == lastConstraints && relayoutChildren()) {
+      needsLayoutCache.reset();
+      return lastSize;
+    }
 
-      mNeedsLayout = false;
+    const auto scope = traceScope("layout", getLayoutReason(constraints));
+    lastConstraints = constraints;
+    layoutCount++;
 
-      lastSize = result;
-      return result;
-    }
-    return lastSize;
+    const auto result = doLayout(constraints);
+    assert(result.width != Constraints::unbound &&
+           result.height != Constraints::unbound);
+    assert(constraints.contain(result));
+
+    mNeedsLayout = false;
+    mHasLayout = true;
+
+    // The descendants are laid out now as well.
+    needsLayoutCache.reset();
+
+    lastSize = result;
+    return result;
   }
 
+  /// The number of \ref doLayout calls since \ref resetLayoutCount, reset at
+  /// the start of each frame.
+  static int getLayoutCount() { return layoutCount; }
+  static void resetLayoutCount() { layoutCount = 0; }
+
   virtual UpdateRegion cleanup(rmlib::Canvas& canvas) {
     if (isFullDraw()) {
+      const auto scope = traceScope("cleanup", "full");
       canvas.set(cleanupRect, rmlib::white);
       return UpdateRegion{ cleanupRect, rmlib::fb::Waveform::DU };
     }
@@ -71,24 +129,56 @@ public:
 
     // TODO: do we need to distinguish when cleanup is used?
     if (needsDraw()) {
+      const auto scope = traceScope("draw", getDrawReason());
       const auto rect = Rect{ offset, offset + lastSize.toPoint() };
       this->cleanupRect = rect;
       this->lastOffset = offset;
 
       auto subCanvas = canvas.subCanvas(rect);
       auto subRes = doDraw(subCanvas);
-      subRes.region += offset;
+      subRes += offset;
 
-      assert(subRes.region.empty() || rect.contains(subRes.region));
+      assert(subRes.empty() || rect.contains(subRes.bounds()));
 
       result |= subRes;
 
       mNeedsDraw = No;
+    } else if (movedPixels.has_value()) {
+      const auto rect = Rect{ offset, offset + lastSize.toPoint() };
+      this->cleanupRect = rect;
+      this->lastOffset = offset;
+
+      canvas.drawImage(movedPixels->canvas, offset);
+      result |= UpdateRegion{ rect };
     }
 
+    mMoved = false;
+    movedPixels.reset();
     return result;
   }
 
+  /// Marks the object as moved to another place among its siblings.
+  void markMoved() { mMoved = true; }
+
+  /// Copies the pixels of a moved object that doesn't need drawing, so
+  /// \ref draw copies them to the new place instead of drawing it again.
+  /// A moved object that can't be copied is drawn fully instead, a partial
+  /// draw would lose the unchanged parts.
+  /// Called by the parent in its cleanup, before anything is cleared.
+  /// \returns True if copied, the parent should clear the old place.
+  bool saveMovedPixels(const rmlib::Canvas& canvas) {
+    if (!mMoved) {
+      return false;
+    }
+    if (needsDraw() || !mHasLayout || cleanupRect.size() != lastSize) {
+      // Its own cleanup clears the old place.
+      markNeedsDraw(true);
+      return false;
+    }
+    movedPixels.emplace(canvas, cleanupRect);
+    return true;
+  }
+
   virtual void doHandleInput(const input::Event& ev) {}
   void handleInput(input::Event ev) {
     std::visit(
@@ -98,13 +188,62 @@ public:
         }
       },
       ev);
+
+    if (movePolicy != MovePolicy::Each && holdMove(ev)) {
+      return;
+    }
     doHandleInput(ev);
   }
 
+  void setMovePolicy(MovePolicy policy) { movePolicy = policy; }
+
+  /// The moves coalesced into the one being handled, oldest first. Empty
+  /// when not handling a coalesced move.
+  const std::vector<input::Event>& getMoveHistory() const {
+    return moveHistory;
+  }
+
+  /// Moves are resampled this long before the end of the frame, so there's
+  /// usually a sample after it to interpolate to.
+  static constexpr auto resample_latency = std::chrono::milliseconds(5);
+
+  /// Handles the moves held back by render objects for their policy. Called
+  /// once a frame, after handling the input read for it. Resampled moves
+  /// after the frame time stay pending for the next frame.
+  static void handlePendingMoves(input::EventClock::time_point frameTime) {
+    // Handling moves can hold back new ones, which are handled too.
+    for (std::size_t i = 0; i < withPendingMoves.size(); i++) {
+      auto* ro = withPendingMoves[i];
+      if (ro == nullptr) {
+        continue;
+      }
+      auto pendingMoves = std::exchange(ro->pendingMoves, {});
+      for (auto& pending : pendingMoves) {
+        ro->handleMoves(pending, frameTime);
+        if (!pending.moves.empty()) {
+          ro->pendingMoves.emplace_back(std::move(pending));
+        }
+      }
+    }
+
+    withPendingMoves.erase(
+      std::remove_if(withPendingMoves.begin(),
+                     withPendingMoves.end(),
+                     [](const auto* ro) {
+                       return ro == nullptr || ro->pendingMoves.empty();
+                     }),
+      withPendingMoves.end());
+  }
+
+  /// \returns True if moves are still pending, so the next frame shouldn't
+  /// wait for input before handling them.
+  static bool hasPendingMoves() { return !withPendingMoves.empty(); }
+
   virtual void rebuild(AppContext& context, const BuildContext* parent) {
     buildContext.emplace(*this, parent);
 
     if (mNeedsRebuild) {
+      const auto scope = traceScope("rebuild", "marked");
 #ifndef NDEBUG
       mInRebuild = true;
 #endif
@@ -130,10 +269,12 @@ public:
   Rect getCleanupRect() const { return cleanupRect; }
 
   const Size& getSize() const { return lastSize; }
+  bool hasLayout() const { return mHasLayout; }
 
   virtual void markNeedsLayout() { mNeedsLayout = true; }
   virtual void markNeedsDraw(bool full = true) {
     mNeedsDraw = full ? Full : (mNeedsDraw == No ? Partial : mNeedsDraw);
+    needsDrawCache.reset();
   }
 
   void markNeedsRebuild() {
@@ -148,7 +289,17 @@ public:
 
   type_id::TypeIdT getWidgetTypeID() const { return mTypeID; }
 
-  virtual std::vector<RenderObject*> getChildren() = 0;
+  virtual std::size_t childCount() const = 0;
+  virtual RenderObject& childAt(std::size_t index) = 0;
+
+  /// Calls the function with each child, without allocating.
+  template<typename Fn>
+  void visitChildren(Fn&& fn) {
+    const auto count = childCount();
+    for (std::size_t i = 0; i < count; i++) {
+      fn(childAt(i));
+    }
+  }
 
 protected:
   virtual Size doLayout(const Constraints& constraints) = 0;
@@ -167,6 +318,174 @@ protected:
   }
 
 private:
+  /// Traces the work of this object, tagged with the type of the widget.
+  trace::Scope traceScope(const char* phase, const char* reason) const {
+    if (!trace::isEnabled()) {
+      return {};
+    }
+    return trace::Scope(phase, mTypeID.name(), mID, reason);
+  }
+
+  /// Lays out the children that need it with their last constraints.
+  /// \returns False if a size changed, or a child was never laid out, so
+  /// this object needs to do its layout again.
+  bool relayoutChildren() {
+    const auto count = childCount();
+    for (std::size_t i = 0; i < count; i++) {
+      auto& child = childAt(i);
+      if (!child.needsLayout()) {
+        continue;
+      }
+      if (!child.mHasLayout) {
+        return false;
+      }
+
+      const auto oldSize = child.lastSize;
+      if (child.layout(child.lastConstraints) != oldSize) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* getLayoutReason(const Constraints& constraints) const {
+    if (mNeedsLayout) {
+      return "marked";
+    }
+    if (constraints != lastConstraints) {
+      return "constraints";
+    }
+    return "child";
+  }
+
+  const char* getDrawReason() const {
+    switch (mNeedsDraw) {
+      case Full:
+        return "full";
+      case Partial:
+        return "partial";
+      case No:
+        break;
+    }
+    return "child";
+  }
+
+  /// The moves of a pointer held back in this frame.
+  struct PendingMoves {
+    int id;
+    std::vector<input::Event> moves;
+  };
+
+  /// \returns True if the event is a move that's handled later.
+  bool holdMove(const input::Event& ev) {
+    if (std::holds_alternative<input::KeyEvent>(ev)) {
+      return false;
+    }
+
+    const auto [id, isMove] = std::visit(
+      [](const auto& ev) -> std::pair<int, bool> {
+        if constexpr (input::is_pointer_event<decltype(ev)>) {
+          return { ev.id, ev.isMove() };
+        } else {
+          return { 0, false };
+        }
+      },
+      ev);
+
+    auto it = std::find_if(pendingMoves.begin(),
+                           pendingMoves.end(),
+                           [id = id](const auto& p) { return p.id == id; });
+
+    if (!isMove) {
+      // Keep the order of the pointer's events, handle its moves first.
+      if (it != pendingMoves.end()) {
+        auto pending = std::move(*it);
+        pendingMoves.erase(it);
+        handleMoves(pending, std::nullopt);
+      }
+      return false;
+    }
+
+    if (pendingMoves.empty()) {
+      withPendingMoves.emplace_back(this);
+    }
+    if (it == pendingMoves.end()) {
+      it = pendingMoves.insert(pendingMoves.end(), PendingMoves{ id, {} });
+    }
+    it->moves.emplace_back(ev);
+    return true;
+  }
+
+  /// Handles the moves as one, resampled at the time if the policy asks.
+  /// Moves after the resample time are kept in \p pending, so the last one
+  /// is still handled when the pointer stops.
+  void handleMoves(PendingMoves& pending,
+                   std::optional<input::EventClock::time_point> frameTime) {
+    auto ev = pending.moves.back();
+    auto handled = pending.moves.end();
+    if (movePolicy == MovePolicy::Resample && frameTime.has_value()) {
+      const auto time = *frameTime - resample_latency;
+      ev = resample(pending.moves, time);
+      handled = std::find_if(
+        pending.moves.begin(), pending.moves.end(), [time](const auto& move) {
+          return input::getTime(move) > time;
+        });
+    }
+
+    moveHistory.assign(pending.moves.begin(), handled);
+    pending.moves.erase(pending.moves.begin(), handled);
+    doHandleInput(ev);
+    moveHistory.clear();
+  }
+
+  /// Interpolates the moves at the time, without extrapolating past them.
+  static input::Event resample(const std::vector<input::Event>& moves,
+                               input::EventClock::time_point time) {
+    auto after =
+      std::find_if(moves.begin(), moves.end(), [time](const auto& move) {
+        return input::getTime(move) >= time;
+      });
+    if (after == moves.end()) {
+      return moves.back();
+    }
+    if (after == moves.begin()) {
+      return moves.front();
+    }
+
+    const auto& before = *std::prev(after);
+    const auto t0 = input::getTime(before);
+    const auto t1 = input::getTime(*after);
+    const auto alpha = float((time - t0).count()) / float((t1 - t0).count());
+
+    auto result = *after;
+    std::visit(
+      [&](auto& ev) {
+        using Ev = std::decay_t<decltype(ev)>;
+        const auto* from = std::get_if<Ev>(&before);
+        if constexpr (input::is_pointer_event<Ev>) {
+          if (from == nullptr) {
+            return;
+          }
+          const auto diff = ev.location - from->location;
+          ev.location =
+            from->location + Point{ int(std::lround(float(diff.x) * alpha)),
+                                    int(std::lround(float(diff.y) * alpha)) };
+          ev.time = time;
+        }
+      },
+      result);
+    return result;
+  }
+
+  static inline int layoutCount = 0; // NOLINT
+
+  /// Render objects with pending moves, null once destroyed.
+  static inline std::vector<RenderObject*> withPendingMoves; // NOLINT
+
+  MovePolicy movePolicy = MovePolicy::Each;
+  std::vector<PendingMoves> pendingMoves;
+  std::vector<input::Event> moveHistory;
+
   int mID;
   type_id::TypeIdT mTypeID;
 
@@ -178,11 +497,15 @@ private:
   // TODO: are both needed?
   CachedBool needsLayoutCache;
   bool mNeedsLayout = true;
+  bool mHasLayout = false;
 
   CachedBool needsDrawCache;
   // bool mNeedsDraw = true;
   enum { No, Full, Partial } mNeedsDraw = Full;
 
+  bool mMoved = false;
+  std::optional<MemoryCanvas> movedPixels;
+
   bool mNeedsRebuild = false;
   std::optional<BuildContext> buildContext;
 
@@ -200,7 +523,11 @@ public:
   LeafRenderObject(const Widget& widget)
     : RenderObject(type_id::typeId<Widget>()), widget(&widget) {}
 
-  std::vector<RenderObject*> getChildren() final { return {}; }
+  std::size_t childCount() const final { return 0; }
+  RenderObject& childAt(std::size_t /*index*/) final {
+    assert(false && "No children");
+    return *this;
+  }
   const Widget& getWidget() { return *widget; }
 
 protected:
@@ -244,17 +571,10 @@ public:
 
     auto subCanvas = canvas.subCanvas(getCleanupRect());
     auto subRes = child->cleanup(subCanvas);
-    subRes.region += getCleanupRect().topLeft;
+    subRes += getCleanupRect().topLeft;
     return subRes;
   }
 
-  void markNeedsLayout() override {
-    RenderObject::markNeedsLayout();
-    if (child) {
-      child->markNeedsLayout();
-    }
-  }
-
   void markNeedsDraw(bool full = true) override {
     RenderObject::markNeedsDraw(full);
     if (child) {
@@ -278,7 +598,11 @@ public:
     child->reset();
   }
 
-  std::vector<RenderObject*> getChildren() final { return { child.get() }; }
+  std::size_t childCount() const final { return child != nullptr ? 1 : 0; }
+  RenderObject& childAt(std::size_t index) final {
+    assert(index == 0 && child != nullptr);
+    return *child;
+  }
   const Widget& getWidget() const { return *widget; }
 
 protected:
@@ -334,27 +658,35 @@ public:
 
   UpdateRegion cleanup(rmlib::Canvas& canvas) final {
     if (isFullDraw()) {
+      removedRects.clear();
       return RenderObject::cleanup(canvas);
     }
 
     auto result = UpdateRegion{};
     auto subCanvas = canvas.subCanvas(getCleanupRect());
     const auto offset = getCleanupRect().topLeft;
+
+    // Copy all moved children before clearing, they can take each other's
+    // place.
+    for (const auto& child : children) {
+      if (child->saveMovedPixels(subCanvas)) {
+        removedRects.emplace_back(child->getCleanupRect());
+      }
+    }
+    for (const auto& rect : removedRects) {
+      subCanvas.set(rect, rmlib::white);
+      result |= UpdateRegion{ rect + offset, rmlib::fb::Waveform::DU };
+    }
+    removedRects.clear();
+
     for (const auto& child : children) {
       auto subRes = child->cleanup(subCanvas);
-      subRes.region += offset;
+      subRes += offset;
       result |= subRes;
     }
     return result;
   }
 
-  void markNeedsLayout() override {
-    RenderObject::markNeedsLayout();
-    for (auto& child : children) {
-      child->markNeedsLayout();
-    }
-  }
-
   void markNeedsDraw(bool full = true) override {
     RenderObject::markNeedsDraw(full);
     for (auto& child : children) {
@@ -384,40 +716,67 @@ public:
     }
   }
 
-  std::vector<RenderObject*> getChildren() final {
-    std::vector<RenderObject*> result;
-    result.reserve(children.size());
-    std::transform(children.begin(),
-                   children.end(),
-                   std::back_inserter(result),
-                   [](auto& child) { return child.get(); });
-    return result;
-  }
+  std::size_t childCount() const final { return children.size(); }
+  RenderObject& childAt(std::size_t index) final { return *children[index]; }
 
 protected:
-  // template<typename Widget>
-  void updateChildren(const Widget& widget, const Widget& newWidget) {
-
-    auto updateEnd = children.size();
-
-    if (newWidget.children.size() != children.size()) {
-      // TODO: move the ROs out of tree and reuse?
-      if (newWidget.children.size() < children.size()) {
-        children.resize(newWidget.children.size());
-        updateEnd = newWidget.children.size();
-      } else {
-        children.reserve(newWidget.children.size());
-        std::transform(
-          std::next(newWidget.children.begin(), updateEnd),
-          newWidget.children.end(),
-          std::back_inserter(children),
-          [](const auto& child) { return child.createRenderObject(); });
+  /// Updates the children to the new widgets. A child is matched to its
+  /// render object by key, see \ref Keyed, or by index if it has none.
+  /// Render objects of moved children are kept and marked as moved, those
+  /// of removed ones are cleared in the next cleanup.
+  /// \returns True if children were moved or removed.
+  bool updateChildren(const Widget& widget, const Widget& newWidget) {
+    const auto& oldWidgets = widget.children;
+    const auto& newWidgets = newWidget.children;
+    assert(oldWidgets.size() == children.size());
+
+    std::unordered_map<Key, std::size_t, Key::Hash> keyed;
+    for (std::size_t i = 0; i < oldWidgets.size(); i++) {
+      if (const auto* key = getKey(oldWidgets[i]); key != nullptr) {
+        keyed.emplace(*key, i);
+      }
+    }
+
+    auto changed = false;
+    std::vector<std::unique_ptr<RenderObject>> newChildren;
+    newChildren.reserve(newWidgets.size());
+
+    for (std::size_t i = 0; i < newWidgets.size(); i++) {
+      const auto& child = newWidgets[i];
+
+      auto from = children.size();
+      if (const auto* key = getKey(child); key != nullptr) {
+        if (auto it = keyed.find(*key); it != keyed.end()) {
+          from = it->second;
+        }
+      } else if (i < children.size() && getKey(oldWidgets[i]) == nullptr) {
+        from = i;
+      }
+
+      if (from == children.size() || children[from] == nullptr) {
+        newChildren.emplace_back(child.createRenderObject());
+        continue;
       }
+
+      child.update(*children[from]);
+      if (from != i) {
+        children[from]->markMoved();
+        changed = true;
+      }
+      newChildren.emplace_back(std::move(children[from]));
     }
 
-    for (size_t i = 0; i < updateEnd; i++) {
-      newWidget.children[i].update(*children[i]);
+    for (const auto& child : children) {
+      if (child != nullptr) {
+        if (child->hasLayout()) {
+          removedRects.emplace_back(child->getCleanupRect());
+        }
+        changed = true;
+      }
     }
+
+    children = std::move(newChildren);
+    return changed;
   }
 
   bool getNeedsDraw() const override {
@@ -435,6 +794,10 @@ protected:
   }
 
   std::vector<std::unique_ptr<RenderObject>> children;
+
+private:
+  /// The places of removed and moved children, to clear in cleanup.
+  std::vector<Rect> removedRects;
 };
 
 template<typename RO>
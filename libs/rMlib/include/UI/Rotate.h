@@ -31,7 +31,9 @@ public:
     const auto rot = this->getWidget().rot;
     auto subCanvas = canvas.subCanvas(canvas.rect(), invert(rot));
     auto res = this->child->draw(subCanvas, { 0, 0 });
-    res.region = rotate(subCanvas.rect().size(), invert(rot), res.region);
+    res.transform([&](const Rect& rect) {
+      return rotate(subCanvas.rect().size(), invert(rot), rect);
+    });
     return res;
   }
 
@@ -56,8 +58,10 @@ public:
     const auto rot = this->getWidget().rot;
     auto subCanvas = canvas.subCanvas(this->getCleanupRect(), invert(rot));
     auto subRes = this->child->cleanup(subCanvas);
-    subRes.region = rotate(subCanvas.rect().size(), invert(rot), subRes.region);
-    subRes.region += this->getCleanupRect().topLeft;
+    subRes.transform([&](const Rect& rect) {
+      return rotate(subCanvas.rect().size(), invert(rot), rect);
+    });
+    subRes += this->getCleanupRect().topLeft;
     return subRes;
   }
 };
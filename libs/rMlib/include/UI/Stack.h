@@ -18,8 +18,8 @@ public:
     , widget(&widget) {}
 
   void update(const Stack<Child>& newWidget) {
-    bool needsDraw = newWidget.children.size() < this->children.size();
-    this->updateChildren(*widget, newWidget);
+    // Children overlap, so they're only drawn on top when added.
+    const auto needsDraw = this->updateChildren(*widget, newWidget);
 
     if (needsDraw) {
       this->markNeedsLayout();
@@ -101,7 +101,15 @@ protected:
       hasInitedState = true;
     }
 
-    otherWidget().emplace(std::move(constState().build(context, buildCtx)));
+    // The widget built before the current one isn't used anymore, so its
+    // arena can be reused for the new one.
+    otherWidget().reset();
+    arenas[1 - currentIdx].reset();
+    {
+      const auto scope = Arena::Scope(arenas[1 - currentIdx]);
+      otherWidget().emplace(constState().build(context, buildCtx));
+    }
+
     if (this->child == nullptr) {
       this->child = otherWidget()->createRenderObject();
     } else {
@@ -117,6 +125,9 @@ private:
 
   const StateT& constState() const { return state; }
 
+  /// The transient allocations of each built widget, see \ref DynamicWidget.
+  /// Destroyed after the widgets.
+  std::array<Arena, 2> arenas;
   std::array<std::optional<WidgetT>, 2> buildWidgets;
   StateT state;
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <GlyphCache.h>
 #include <UI/RenderObject.h>
 #include <UI/Widget.h>
 
@@ -33,6 +34,7 @@ public:
         newWidget.text != widget->text) {
       markNeedsDraw();
       markNeedsLayout();
+      textRun.reset();
     }
 
     widget = &newWidget;
@@ -40,8 +42,7 @@ public:
 
 protected:
   Size doLayout(const Constraints& constraints) override {
-    const auto textSize =
-      rmlib::Canvas::getTextSize(widget->text, widget->fontSize);
+    const auto textSize = getTextRun().size;
 
     Size result{};
 
@@ -66,8 +67,8 @@ protected:
 
   UpdateRegion doDraw(rmlib::Canvas& canvas) override {
     const auto rect = canvas.rect();
-    const auto textSize =
-      rmlib::Canvas::getTextSize(widget->text, widget->fontSize);
+    const auto& run = getTextRun();
+    const auto textSize = run.size;
     const auto x = std::max(0, (rect.width() - textSize.width) / 2);
     const auto y = std::max(0, (rect.height() - textSize.height) / 2);
 
@@ -78,16 +79,25 @@ protected:
       rmlib::Rect{ point, point + textSize.toPoint() } & rect;
 
     canvas.set(drawRect, rmlib::white);
-    canvas.drawText(widget->text,
-                    point,
-                    widget->fontSize,
-                    black,
-                    white,
-                    /* clip */ rect);
+    canvas.drawGlyphs(GlyphCache::getInstance().layout(run, widget->fontSize),
+                      point,
+                      black,
+                      white,
+                      /* clip */ rect);
     return UpdateRegion{ drawRect };
   }
 
 private:
+  /// The text is measured once, and kept until it changes.
+  const TextRun& getTextRun() {
+    if (textRun == nullptr) {
+      textRun =
+        GlyphCache::getInstance().measure(widget->text, widget->fontSize);
+    }
+    return *textRun;
+  }
+
+  std::shared_ptr<const TextRun> textRun;
 };
 
 inline std::unique_ptr<RenderObject>
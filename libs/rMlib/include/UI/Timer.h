@@ -26,9 +26,9 @@ private:
 };
 
 class Timer {
+public:
   using Clock = std::chrono::steady_clock;
 
-public:
   static std::pair<std::shared_ptr<Timer>, TimerHandle> makeTimer(
     std::chrono::microseconds duration,
     Callback callback,
@@ -59,6 +59,8 @@ public:
                                                                  Clock::now());
   }
 
+  Clock::time_point getTriggerTime() const { return triggerTime; }
+
   bool repeats() const { return repeat.has_value(); }
 
   void reset() {
@@ -1,11 +1,33 @@
 #pragma once
 
+#include <string>
+#include <string_view>
+
 namespace rmlib::type_id {
+
+/// \returns The name of the type, as written by the compiler.
+template<typename T>
+const char*
+typeName() {
+  static const auto name = [pretty = std::string_view(__PRETTY_FUNCTION__)] {
+    // "... typeName() [with T = name]" or "[T = name]".
+    const auto start = pretty.find("T = ");
+    if (start == std::string_view::npos) {
+      return std::string(pretty);
+    }
+    const auto end = pretty.find_first_of(";]", start);
+    return std::string(pretty.substr(start + 4, end - start - 4));
+  }();
+  return name.c_str();
+}
+
 class TypeIdT {
   using Sig = TypeIdT();
+  using NameSig = const char*();
 
   Sig* id;
-  TypeIdT(Sig* id) : id{ id } {}
+  NameSig* nameFn;
+  TypeIdT(Sig* id, NameSig* nameFn) : id{ id }, nameFn{ nameFn } {}
 
 public:
   template<typename T>
@@ -13,12 +35,14 @@ public:
 
   bool operator==(TypeIdT o) const { return id == o.id; }
   bool operator!=(TypeIdT o) const { return id != o.id; }
+
+  const char* name() const { return nameFn(); }
 };
 
 template<typename T>
 TypeIdT
 typeId() {
-  return &typeId<T>;
+  return { &typeId<T>, &typeName<T> };
 }
 
 } // namespace rmlib::type_id
@@ -2,6 +2,9 @@
 
 #include <FrameBuffer.h>
 #include <MathUtil.h>
+
+#include <algorithm>
+#include <array>
 #include <functional>
 
 namespace rmlib {
@@ -94,44 +97,154 @@ rotate(const Rotation& rotation, const Constraints& c) {
   return { rotate(rotation, c.min), rotate(rotation, c.max) };
 }
 
-struct UpdateRegion {
-  constexpr UpdateRegion() : region(), waveform(fb::Waveform::DU) {}
+/// A damaged rectangle, with the waveform and flags to refresh it with.
+struct UpdateRect {
+  Rect region;
+  fb::Waveform waveform = fb::Waveform::GC16Fast;
+  fb::UpdateFlags flags = fb::UpdateFlags::None;
+};
 
-  constexpr UpdateRegion(Rect region) : region(region) {}
+/// The damage of a frame, as a small set of disjoint rectangles.
+///
+/// Rectangles are only merged when they overlap, or when refreshing their
+/// bounding box is cheaper than refreshing both. So two small changes in
+/// opposite corners stay two small updates, and a DU change next to a GC16
+/// one isn't refreshed with GC16.
+class UpdateRegion {
+public:
+  static constexpr size_t max_rects = 8;
 
-  constexpr UpdateRegion(Rect region, fb::Waveform waveform)
-    : region(region), waveform(waveform) {}
+  /// The fixed cost of an extra update, in pixels.
+  static constexpr int update_cost = 64 * 64;
 
-  constexpr UpdateRegion(Rect region,
-                         fb::Waveform waveform,
-                         fb::UpdateFlags flags)
-    : region(region), waveform(waveform), flags(flags) {}
+  UpdateRegion() = default;
 
-  Rect region = { { 0, 0 }, { 0, 0 } };
-  fb::Waveform waveform = fb::Waveform::GC16Fast;
-  fb::UpdateFlags flags = fb::UpdateFlags::None;
+  UpdateRegion(Rect region,
+               fb::Waveform waveform = fb::Waveform::GC16Fast,
+               fb::UpdateFlags flags = fb::UpdateFlags::None) {
+    add(UpdateRect{ region, waveform, flags });
+  }
+
+  UpdateRegion(const UpdateRect& rect) { add(rect); }
 
-  constexpr UpdateRegion& operator|=(const UpdateRegion& other) {
-    if (other.waveform == fb::Waveform::GC16) {
-      waveform = other.waveform;
-    } else if (other.waveform == fb::Waveform::GC16Fast &&
-               waveform == fb::Waveform::DU) {
-      waveform = other.waveform;
+  void add(UpdateRect rect) {
+    if (rect.region.empty()) {
+      return;
     }
 
-    if (region.empty()) {
-      region = other.region;
-    } else if (!other.region.empty()) {
-      region |= other.region;
+    // Merging can make the rect overlap others, so repeat until nothing
+    // needs to be merged.
+    for (;;) {
+      auto* mergeWith = std::find_if(begin(), end(), [&rect](const auto& r) {
+        return shouldMerge(r, rect);
+      });
+
+      if (mergeWith == end() && numRects == max_rects) {
+        mergeWith = std::min_element(
+          begin(), end(), [&rect](const auto& a, const auto& b) {
+            return mergeCost(a, rect) < mergeCost(b, rect);
+          });
+      }
+
+      if (mergeWith == end()) {
+        break;
+      }
+
+      rect = merge(*mergeWith, rect);
+      *mergeWith = rects[--numRects]; // NOLINT
     }
 
-    flags = static_cast<fb::UpdateFlags>(flags | other.flags);
+    rects[numRects++] = rect; // NOLINT
+  }
 
+  UpdateRegion& operator|=(const UpdateRegion& other) {
+    for (const auto& rect : other) {
+      add(rect);
+    }
     return *this;
   }
+
+  UpdateRegion& operator+=(const Point& offset) {
+    return transform([&offset](Rect rect) { return rect += offset; });
+  }
+
+  /// Maps all rects, the function must keep them disjoint, e.g. a rotation.
+  template<typename Fn>
+  UpdateRegion& transform(Fn&& fn) {
+    for (auto& rect : *this) {
+      rect.region = fn(rect.region);
+    }
+    return *this;
+  }
+
+  /// Uses the waveform for all rects.
+  void setWaveform(fb::Waveform waveform) {
+    for (auto& rect : *this) {
+      rect.waveform = waveform;
+    }
+  }
+
+  bool empty() const { return numRects == 0; }
+  size_t size() const { return numRects; }
+
+  /// \returns The bounding box of all rects.
+  Rect bounds() const {
+    auto result = Rect{};
+    for (const auto& rect : *this) {
+      result |= rect.region;
+    }
+    return result;
+  }
+
+  UpdateRect* begin() { return rects.data(); }
+  UpdateRect* end() { return rects.data() + numRects; } // NOLINT
+  const UpdateRect* begin() const { return rects.data(); }
+  const UpdateRect* end() const { return rects.data() + numRects; } // NOLINT
+
+private:
+  static int area(const Rect& rect) { return rect.width() * rect.height(); }
+
+  static bool overlaps(const Rect& a, const Rect& b) {
+    const auto intersection = a & b;
+    return intersection.width() > 0 && intersection.height() > 0;
+  }
+
+  static fb::Waveform mergeWaveform(fb::Waveform a, fb::Waveform b) {
+    if (a == fb::Waveform::GC16 || b == fb::Waveform::GC16) {
+      return fb::Waveform::GC16;
+    }
+    if (a == fb::Waveform::GC16Fast || b == fb::Waveform::GC16Fast) {
+      return fb::Waveform::GC16Fast;
+    }
+    return a;
+  }
+
+  static UpdateRect merge(const UpdateRect& a, const UpdateRect& b) {
+    return UpdateRect{ a.region | b.region,
+                       mergeWaveform(a.waveform, b.waveform),
+                       static_cast<fb::UpdateFlags>(a.flags | b.flags) };
+  }
+
+  /// The extra pixels refreshed when merging instead of doing two updates.
+  static int mergeCost(const UpdateRect& a, const UpdateRect& b) {
+    return area(a.region | b.region) - area(a.region) - area(b.region) -
+           update_cost;
+  }
+
+  static bool shouldMerge(const UpdateRect& a, const UpdateRect& b) {
+    // Keep the rects disjoint, so no pixel is refreshed twice.
+    if (overlaps(a.region, b.region)) {
+      return true;
+    }
+    return a.waveform == b.waveform && a.flags == b.flags &&
+           mergeCost(a, b) <= 0;
+  }
+
+  std::array<UpdateRect, max_rects> rects;
+  size_t numRects = 0;
 };
 
-constexpr UpdateRegion
+inline UpdateRegion
 operator|(UpdateRegion a, const UpdateRegion& b) {
   a |= b;
   return a;
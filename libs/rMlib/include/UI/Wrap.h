@@ -16,14 +16,19 @@ public:
     , widget(&widget) {}
 
   void update(const Wrap<Child>& newWidget) {
-    bool changed = newWidget.axis != widget->axis ||
-                   newWidget.children.size() != this->children.size();
+    const auto axisChanged = newWidget.axis != widget->axis;
+    const auto oldCount = this->children.size();
+    const auto childrenChanged =
+      this->updateChildren(*widget, newWidget) ||
+      newWidget.children.size() != oldCount;
 
-    this->updateChildren(*widget, newWidget);
-
-    if (changed) {
+    if (axisChanged) {
       this->markNeedsLayout();
       this->markNeedsDraw();
+    } else if (childrenChanged) {
+      // Only new children are drawn, moved ones are copied.
+      this->markNeedsLayout();
+      RenderObject::markNeedsDraw(/* full */ false);
     }
 
     widget = &newWidget;
@@ -43,8 +48,9 @@ protected:
     Size rowSize = { 0, 0 };
     for (const auto& child : this->children) {
       const auto oldSize = child->getSize();
+      const auto hadLayout = child->hasLayout();
       const auto size = child->layout(childConstraints);
-      if (oldSize != size) {
+      if (hadLayout && oldSize != size) {
         this->markNeedsDraw();
       }
 
@@ -83,6 +89,13 @@ protected:
       runSizes.push_back(rowSize.height);
     }
 
+    // The children are centered, so all of them move.
+    if (result != totalSize) {
+      for (const auto& child : this->children) {
+        child->markMoved();
+      }
+      RenderObject::markNeedsDraw(/* full */ false);
+    }
     totalSize = result;
 
     // Align on each axis:
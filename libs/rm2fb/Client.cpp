@@ -78,15 +78,24 @@ waitForInit() {
 
 bool
 sendUpdate(const UpdateParams& params) {
+  static uint32_t sequence = 0;
+
   auto& clientSock = getControlSocket();
   if (!clientSock.sock.isValid()) {
     return false;
   }
 
-  return clientSock.sendto(params)
-    .and_then([&](auto _) {
-      return clientSock.recvfrom<bool>().map(
-        [](auto pair) { return pair.first; });
+  const auto commit = UpdateCommit{ .params = params, .sequence = sequence++ };
+  return clientSock.sendto(commit)
+    .and_then([&](auto _) { return clientSock.recvfrom<UpdateFence>(); })
+    .map([&](auto pair) {
+      const auto& fence = pair.first;
+      if (fence.sequence != commit.sequence) {
+        std::cerr << "Got fence " << fence.sequence << ", expected "
+                  << commit.sequence << "\n";
+        return false;
+      }
+      return fence.ok != 0;
     })
     .or_else([&](auto err) {
       std::cerr << "Error sending: " << unistdpp::to_string(err) << "\n";
@@ -0,0 +1,182 @@
+#include "Compositor.h"
+
+#include <unistdpp/error.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+struct Rect {
+  int x1;
+  int y1;
+  int x2;
+  int y2;
+
+  bool empty() const { return x1 > x2 || y1 > y2; }
+};
+
+Rect
+clip(Rect a, Rect b) {
+  return Rect{ std::max(a.x1, b.x1),
+               std::max(a.y1, b.y1),
+               std::min(a.x2, b.x2),
+               std::min(a.y2, b.y2) };
+}
+
+Rect
+toRect(const UpdateParams& params) {
+  return Rect{ params.x1, params.y1, params.x2, params.y2 };
+}
+
+Rect
+toRect(const OverlaySet& config) {
+  return Rect{ config.x1, config.y1, config.x2, config.y2 };
+}
+
+constexpr Rect screen_rect = { 0, 0, fb_width - 1, fb_height - 1 };
+
+Rect
+visibleRect(const OverlaySet& config) {
+  if (!config.visible) {
+    return Rect{ 0, 0, -1, -1 };
+  }
+  return clip(toRect(config), screen_rect);
+}
+
+void
+copyRect(uint16_t* dst, const uint16_t* src, Rect rect) {
+  const auto rowSize = (rect.x2 - rect.x1 + 1) * sizeof(uint16_t);
+  for (int y = rect.y1; y <= rect.y2; y++) {
+    const auto offset = y * fb_width + rect.x1;
+    memcpy(dst + offset, src + offset, rowSize); // NOLINT
+  }
+}
+
+UpdateParams
+makeUpdate(Rect rect, const OverlaySet& config) {
+  return UpdateParams{
+    .y1 = rect.y1,
+    .x1 = rect.x1,
+    .y2 = rect.y2,
+    .x2 = rect.x2,
+    .flags = config.flags,
+    .waveform = config.waveform,
+    .temperatureOverride = 0,
+    .extraMode = 0,
+  };
+}
+
+} // namespace
+
+void
+Compositor::compose(const UpdateParams& region) {
+  const auto rect = clip(toRect(region), screen_rect);
+  if (rect.empty()) {
+    return;
+  }
+
+  copyRect(scanout, static_cast<const uint16_t*>(fb.getFb()), rect);
+
+  std::array<const Plane*, max_overlays> visible{};
+  auto visibleEnd = visible.begin();
+  for (const auto& plane : planes) {
+    if (plane.config.visible && plane.buffer.has_value()) {
+      *visibleEnd++ = &plane;
+    }
+  }
+  std::stable_sort(visible.begin(), visibleEnd, [](auto* a, auto* b) {
+    return a->config.z < b->config.z;
+  });
+
+  for (auto it = visible.begin(); it != visibleEnd; ++it) {
+    const auto* plane = *it;
+    const auto overlayRect = clip(rect, toRect(plane->config));
+    if (!overlayRect.empty()) {
+      copyRect(scanout,
+               static_cast<const uint16_t*>(plane->buffer->getFb()),
+               overlayRect);
+    }
+  }
+}
+
+std::optional<UpdateParams>
+Compositor::setOverlay(const OverlaySet& msg, int owner) {
+  if (msg.id < 0 || msg.id >= max_overlays) {
+    std::cerr << "Invalid overlay: " << msg.id << "\n";
+    return std::nullopt;
+  }
+
+  auto& plane = planes[msg.id]; // NOLINT
+  if (!plane.buffer.has_value()) {
+    auto buffer = SharedFB::open(getOverlayName(msg.id).c_str(), fb_size);
+    if (!buffer.has_value()) {
+      std::cerr << "Error opening overlay: "
+                << unistdpp::to_string(buffer.error()) << "\n";
+      return std::nullopt;
+    }
+    plane.buffer = std::move(*buffer);
+  }
+
+  const auto oldConfig = plane.config;
+  plane.config = msg;
+  plane.owner = owner;
+
+  const auto oldRect = visibleRect(oldConfig);
+  const auto newRect = visibleRect(msg);
+
+  if (oldRect.empty() && newRect.empty()) {
+    return std::nullopt;
+  }
+  if (oldRect.empty()) {
+    return makeUpdate(newRect, msg);
+  }
+  if (newRect.empty()) {
+    return makeUpdate(oldRect, msg);
+  }
+
+  return makeUpdate(Rect{ std::min(oldRect.x1, newRect.x1),
+                          std::min(oldRect.y1, newRect.y1),
+                          std::max(oldRect.x2, newRect.x2),
+                          std::max(oldRect.y2, newRect.y2) },
+                    msg);
+}
+
+std::optional<UpdateParams>
+Compositor::updateOverlay(const OverlayUpdate& msg) const {
+  if (msg.id < 0 || msg.id >= max_overlays) {
+    std::cerr << "Invalid overlay: " << msg.id << "\n";
+    return std::nullopt;
+  }
+
+  const auto& plane = planes[msg.id]; // NOLINT
+  const auto rect = clip(toRect(msg.params), visibleRect(plane.config));
+  if (rect.empty()) {
+    return std::nullopt;
+  }
+
+  auto params = msg.params;
+  params.x1 = rect.x1;
+  params.y1 = rect.y1;
+  params.x2 = rect.x2;
+  params.y2 = rect.y2;
+  return params;
+}
+
+std::vector<UpdateParams>
+Compositor::removeOwner(int owner) {
+  std::vector<UpdateParams> result;
+  for (auto& plane : planes) {
+    if (plane.owner != owner || !plane.config.visible) {
+      continue;
+    }
+
+    auto config = plane.config;
+    config.visible = false;
+    if (auto update = setOverlay(config, -1)) {
+      result.push_back(*update);
+    }
+  }
+  return result;
+}
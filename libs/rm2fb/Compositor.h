@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Message.h"
+#include "SharedBuffer.h"
+
+#include <array>
+#include <optional>
+#include <vector>
+
+/// Composes the shared framebuffer and the overlay planes into the scanout
+/// buffer, which is read by the SWTCON.
+class Compositor {
+public:
+  Compositor(const SharedFB& fb, uint16_t* scanout)
+    : fb(fb), scanout(scanout) {}
+
+  /// Copies the region of the shared framebuffer to the scanout buffer, and
+  /// draws the visible overlays on top.
+  void compose(const UpdateParams& region);
+
+  /// Applies the overlay config.
+  /// \returns The region that needs to be updated, if any.
+  std::optional<UpdateParams> setOverlay(const OverlaySet& msg, int owner);
+
+  /// \returns The region of the update that's visible, if any.
+  std::optional<UpdateParams> updateOverlay(const OverlayUpdate& msg) const;
+
+  /// Hides all overlays of the owner.
+  /// \returns The regions that need to be updated.
+  std::vector<UpdateParams> removeOwner(int owner);
+
+  const uint16_t* getScanout() const { return scanout; }
+
+private:
+  struct Plane {
+    std::optional<SharedFB> buffer;
+    OverlaySet config;
+    int owner = -1;
+  };
+
+  const SharedFB& fb;
+  uint16_t* scanout;
+
+  std::array<Plane, max_overlays> planes;
+};
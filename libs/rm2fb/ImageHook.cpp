@@ -3,32 +3,58 @@
 #include <dlfcn.h>
 #include <iostream>
 
+namespace {
+
+bool
+replaceImage(void* that, int width, int height, int format, void* buffer) {
+  static bool firstAlloc = true;
+
+  if (width != fb_width || height != fb_height || !firstAlloc) {
+    return false;
+  }
+
+  static const auto q_image_ctor_with_buffer = (void (*)(
+    void*, uint8_t*, int32_t, int32_t, int32_t, int, void (*)(void*), void*))
+    dlsym(RTLD_NEXT, "_ZN6QImageC1EPhiiiNS_6FormatEPFvPvES2_");
+
+  std::cerr << "REPLACING THE IMAGE with shared memory\n";
+  firstAlloc = false;
+
+  q_image_ctor_with_buffer(that,
+                           reinterpret_cast<uint8_t*>(buffer),
+                           fb_width,
+                           fb_height,
+                           fb_width * fb_pixel_size,
+                           format,
+                           nullptr,
+                           nullptr);
+  return true;
+}
+
+} // namespace
+
 void
 qimageHook(void (*orig)(void*, int, int, int),
            void* that,
            int width,
            int height,
            int format) {
-  static bool firstAlloc = true;
+  if (const auto& fb = SharedFB::getInstance();
+      fb.has_value() &&
+      replaceImage(that, width, height, format, fb->mem.get())) {
+    return;
+  }
 
-  if (const auto& fb = SharedFB::getInstance(); width == fb_width &&
-                                                height == fb_height &&
-                                                firstAlloc && fb.has_value()) {
-    static const auto q_image_ctor_with_buffer = (void (*)(
-      void*, uint8_t*, int32_t, int32_t, int32_t, int, void (*)(void*), void*))
-      dlsym(RTLD_NEXT, "_ZN6QImageC1EPhiiiNS_6FormatEPFvPvES2_");
-
-    std::cerr << "REPLACING THE IMAGE with shared memory\n";
-    firstAlloc = false;
-
-    q_image_ctor_with_buffer(that,
-                             reinterpret_cast<uint8_t*>(fb->mem.get()),
-                             fb_width,
-                             fb_height,
-                             fb_width * fb_pixel_size,
-                             format,
-                             nullptr,
-                             nullptr);
+  orig(that, width, height, format);
+}
+
+void
+qimageScanoutHook(void (*orig)(void*, int, int, int),
+                  void* that,
+                  int width,
+                  int height,
+                  int format) {
+  if (replaceImage(that, width, height, format, getScanoutBuffer())) {
     return;
   }
 
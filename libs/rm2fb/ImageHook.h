@@ -8,3 +8,11 @@ qimageHook(void (*orig)(void*, int, int, int),
            int width,
            int height,
            int format);
+
+/// Same as \ref qimageHook, but uses the scanout buffer of the server.
+void
+qimageScanoutHook(void (*orig)(void*, int, int, int),
+                  void* that,
+                  int width,
+                  int height,
+                  int format);
@@ -2,13 +2,25 @@
 
 #include <libevdev/libevdev-uinput.h>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstring>
 #include <iostream>
+#include <optional>
+#include <unistd.h>
 
 namespace {
 constexpr auto screen_width = 1404;
 constexpr auto screen_height = 1872;
 
+constexpr auto wacom_width = 15725;
+constexpr auto wacom_height = 20967;
+
+constexpr auto touch_fake_slot = 1;
+constexpr auto touch_fake_id = 123;
+constexpr auto default_touch_pressure = 110;
+
 void
 writeEvChecked(const struct libevdev_uinput* dev,
                unsigned int type,
@@ -20,6 +32,114 @@ writeEvChecked(const struct libevdev_uinput* dev,
   }
 }
 
+/// The most events added for a single sample, a touch down with a timestamp.
+constexpr size_t max_sample_events = 10;
+
+/// Collects input events, so they can be written using a single syscall.
+/// The kernel sets the event timestamps, so they're left empty.
+/// The events are stored inline, so sending input doesn't allocate.
+template<size_t Samples>
+class EventBuffer {
+public:
+  static constexpr size_t capacity = Samples * max_sample_events;
+
+  void add(unsigned int type, unsigned int code, int value) {
+    assert(count < capacity && "Too many events for the buffer");
+    auto& ev = events[count++]; // NOLINT
+    ev = input_event{};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+  }
+
+  void flush(const libevdev_uinput& dev) {
+    if (count == 0) {
+      return;
+    }
+
+    const auto fd = libevdev_uinput_get_fd(&dev);
+    const auto size = count * sizeof(input_event);
+    auto res = ::write(fd, events.data(), size);
+    if (res < 0) {
+      std::cerr << "Uinput error: " << strerror(errno) << "\n";
+    } else if (size_t(res) != size) {
+      std::cerr << "Uinput error: short write\n";
+    }
+
+    count = 0;
+  }
+
+private:
+  std::array<input_event, capacity> events;
+  size_t count = 0;
+};
+
+using SampleBuffer = EventBuffer<1>;
+using BatchBuffer = EventBuffer<InputBatch::max_samples>;
+
+template<typename Buffer>
+void
+addPen(Buffer& buffer,
+       int32_t screenX,
+       int32_t screenY,
+       Input::Action type,
+       std::optional<int> pressure = std::nullopt) {
+  auto x = int(float(screenX) * wacom_width / screen_width);
+  auto y = int(wacom_height - (float(screenY) * wacom_height / screen_height));
+
+  buffer.add(EV_ABS, ABS_X, y);
+  buffer.add(EV_ABS, ABS_Y, x);
+
+  if (type != Input::Move) {
+    const auto value = type == Input::Down ? 1 : 0;
+    buffer.add(EV_KEY, BTN_TOOL_PEN, value);
+    buffer.add(EV_KEY, BTN_TOUCH, value);
+  }
+
+  if (pressure.has_value()) {
+    buffer.add(EV_ABS, ABS_PRESSURE, type == Input::Up ? 0 : *pressure);
+  }
+}
+
+template<typename Buffer>
+void
+addTouch(Buffer& buffer,
+         int32_t x,
+         int32_t y,
+         Input::Action type,
+         int pressure = default_touch_pressure) {
+  switch (type) {
+    case Input::Move:
+      break;
+    case Input::Down:
+      buffer.add(EV_ABS, ABS_MT_SLOT, touch_fake_slot);
+      buffer.add(EV_ABS, ABS_MT_TRACKING_ID, touch_fake_id);
+      buffer.add(EV_ABS, ABS_MT_PRESSURE, pressure);
+      buffer.add(EV_ABS, ABS_MT_TOUCH_MAJOR, 26);
+      buffer.add(EV_ABS, ABS_MT_TOUCH_MINOR, 26);
+      buffer.add(EV_ABS, ABS_MT_ORIENTATION, 4);
+
+      break;
+    case Input::Up:
+      buffer.add(EV_ABS, ABS_MT_PRESSURE, 0);
+      buffer.add(EV_ABS, ABS_MT_TRACKING_ID, -1);
+      buffer.add(EV_ABS, ABS_MT_SLOT, 0);
+      break;
+  }
+
+  buffer.add(EV_ABS, ABS_MT_POSITION_X, x);
+  buffer.add(EV_ABS, ABS_MT_POSITION_Y, screen_height - y);
+}
+
+template<typename Buffer>
+void
+addSync(Buffer& buffer, std::optional<uint32_t> timestamp) {
+  if (timestamp.has_value()) {
+    buffer.add(EV_MSC, MSC_TIMESTAMP, int(*timestamp));
+  }
+  buffer.add(EV_SYN, SYN_REPORT, 0);
+}
+
 } // namespace
 
 void
@@ -65,6 +185,9 @@ makeWacomDevice() {
   libevdev_enable_event_code(dev, EV_ABS, ABS_TILT_X, &info);
   libevdev_enable_event_code(dev, EV_ABS, ABS_TILT_Y, &info);
 
+  libevdev_enable_event_type(dev, EV_MSC);
+  libevdev_enable_event_code(dev, EV_MSC, MSC_TIMESTAMP, nullptr);
+
   libevdev_uinput* uidev = nullptr;
   auto err = libevdev_uinput_create_from_device(
     dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &uidev);
@@ -137,6 +260,9 @@ makeTouchDevice() {
   info.maximum = 255;
   libevdev_enable_event_code(dev, EV_ABS, ABS_MT_PRESSURE, &info);
 
+  libevdev_enable_event_type(dev, EV_MSC);
+  libevdev_enable_event_code(dev, EV_MSC, MSC_TIMESTAMP, nullptr);
+
   libevdev_enable_property(dev, INPUT_PROP_DIRECT);
 
   libevdev_uinput* uidev = nullptr;
@@ -189,53 +315,18 @@ makeAllDevices() {
 
 void
 sendPen(const Input& input, libevdev_uinput& wacomDevice) {
-  constexpr auto wacom_width = 15725;
-  constexpr auto wacom_height = 20967;
-
-  auto x = int(float(input.x) * wacom_width / screen_width);
-  auto y = int(wacom_height - (float(input.y) * wacom_height / screen_height));
-
-  writeEvChecked(&wacomDevice, EV_ABS, ABS_X, y);
-  writeEvChecked(&wacomDevice, EV_ABS, ABS_Y, x);
-
-  if (input.type != Input::Move) {
-    const auto value = input.type == Input::Down ? 1 : 0;
-    writeEvChecked(&wacomDevice, EV_KEY, BTN_TOOL_PEN, value);
-    writeEvChecked(&wacomDevice, EV_KEY, BTN_TOUCH, value);
-  }
-
-  writeEvChecked(&wacomDevice, EV_SYN, SYN_REPORT, 0);
+  SampleBuffer buffer;
+  addPen(buffer, input.x, input.y, input.type);
+  addSync(buffer, std::nullopt);
+  buffer.flush(wacomDevice);
 }
 
 void
 sendTouch(const Input& input, libevdev_uinput& touchDevice) {
-  constexpr auto fake_slot = 1;
-  constexpr auto fake_id = 123;
-
-  switch (input.type) {
-    case Input::Move:
-      break;
-    case Input::Down:
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_SLOT, fake_slot);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_TRACKING_ID, fake_id);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_PRESSURE, 110);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_TOUCH_MAJOR, 26);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_TOUCH_MINOR, 26);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_ORIENTATION, 4);
-
-      break;
-    case Input::Up:
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_PRESSURE, 0);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_TRACKING_ID, -1);
-      writeEvChecked(&touchDevice, EV_ABS, ABS_MT_SLOT, 0);
-      break;
-  }
-
-  writeEvChecked(&touchDevice, EV_ABS, ABS_MT_POSITION_X, input.x);
-  writeEvChecked(
-    &touchDevice, EV_ABS, ABS_MT_POSITION_Y, screen_height - input.y);
-
-  writeEvChecked(&touchDevice, EV_SYN, SYN_REPORT, 0);
+  SampleBuffer buffer;
+  addTouch(buffer, input.x, input.y, input.type);
+  addSync(buffer, std::nullopt);
+  buffer.flush(touchDevice);
 }
 
 void
@@ -245,3 +336,45 @@ sendButton(bool down, libevdev_uinput& buttonDevice) {
 
   writeEvChecked(&buttonDevice, EV_SYN, SYN_REPORT, 0);
 }
+
+void
+sendInputBatch(const InputBatch& batch, const AllUinputDevices& devices) {
+  BatchBuffer penBuffer;
+  BatchBuffer touchBuffer;
+
+  const auto count = std::min(batch.count, InputBatch::max_samples);
+  for (uint32_t i = 0; i < count; i++) {
+    const auto& sample = batch.samples[i]; // NOLINT
+    const auto type = Input::Action(sample.type);
+
+    if (type != Input::Move && type != Input::Down && type != Input::Up) {
+      std::cerr << "Invalid input sample type: " << int(sample.type) << "\n";
+      continue;
+    }
+
+    // A pressure of zero means the sample doesn't carry pressure info.
+    if (sample.touch != 0) {
+      addTouch(touchBuffer,
+               sample.x,
+               sample.y,
+               type,
+               sample.pressure != 0 ? sample.pressure : default_touch_pressure);
+      addSync(touchBuffer, sample.timestamp);
+    } else {
+      addPen(penBuffer,
+             sample.x,
+             sample.y,
+             type,
+             sample.pressure != 0 ? std::optional<int>(sample.pressure)
+                                  : std::nullopt);
+      addSync(penBuffer, sample.timestamp);
+    }
+  }
+
+  if (devices.wacom) {
+    penBuffer.flush(*devices.wacom);
+  }
+  if (devices.touch) {
+    touchBuffer.flush(*devices.touch);
+  }
+}
@@ -37,3 +37,7 @@ sendTouch(const Input& input, libevdev_uinput& touchDevice);
 
 void
 sendButton(bool down, libevdev_uinput& buttonDevice);
+
+/// Sends all samples in the batch, using a single write per uinput device.
+void
+sendInputBatch(const InputBatch& batch, const AllUinputDevices& devices);
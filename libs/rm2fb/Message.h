@@ -3,10 +3,15 @@
 #include <iomanip>
 #include <unistdpp/unistdpp.h>
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <iostream>
 #include <variant>
 
+/// Port of the TCP listener of rm2fb-server.
+constexpr auto rm2fb_tcp_port = 8888;
+
 struct UpdateParams {
   static constexpr auto ioctl_waveform_flag = 0xf000;
 
@@ -43,6 +48,22 @@ operator<<(std::ostream& stream, const UpdateParams& msg) {
   // clang-format on
 }
 
+/// An update sent over the unix control socket.
+/// The server copies the region to the scanout buffer and replies with the
+/// \ref UpdateFence before sending it to the display. So the client can draw
+/// the next frame while the SWTCON is still busy with this one.
+struct UpdateCommit {
+  UpdateParams params;
+  uint32_t sequence;
+};
+
+/// Releases the commit with the same sequence number, after which the client
+/// can modify the region again.
+struct UpdateFence {
+  uint32_t sequence;
+  uint32_t ok;
+};
+
 struct Input {
   int32_t x = 0;
   int32_t y = 0;
@@ -58,35 +79,189 @@ struct PowerButton {
   bool down;
 };
 
-using ClientMsg = std::variant<Input, GetUpdate, PowerButton>;
+/// A variable number of samples, only the first `count` samples are sent over
+/// the wire.
+template<typename Sample, uint32_t MaxSamples = 64>
+struct SampleBatch {
+  using sample_type = Sample;
+  static constexpr uint32_t max_samples = MaxSamples;
 
-template<typename... T>
+  uint32_t count = 0;
+  std::array<Sample, max_samples> samples;
+
+  bool add(const Sample& sample) {
+    if (count == max_samples) {
+      return false;
+    }
+    samples[count++] = sample; // NOLINT
+    return true;
+  }
+};
+
+/// A single input sample, part of an \ref InputBatch.
+struct InputSample {
+  int32_t x = 0;
+  int32_t y = 0;
+  uint32_t timestamp = 0; // Client time in microseconds.
+  uint16_t pressure = 0;  // 0 - 4095 for pen, 0 - 255 for touch.
+  uint8_t type = Input::Move;
+  uint8_t touch = 0;
+};
+
+static_assert(sizeof(InputSample) == 4 * 4,
+              "Input sample has unexpected size");
+
+/// Multiple input samples, injected using a single write per device.
+struct InputBatch : SampleBatch<InputSample> {};
+
+/// Starts a stroke that is rendered by the server, directly into the
+/// framebuffer. Each client can have a single active stroke.
+/// The widths are clamped to 1 - 64 pixels.
+struct StrokeBegin {
+  uint16_t minWidth = 1; // Width in pixels at zero pressure.
+  uint16_t maxWidth = 4; // Width in pixels at full pressure.
+  uint8_t color = 0;     // Grayscale value, 0 is black.
+};
+
+struct StrokePoint {
+  int32_t x = 0;
+  int32_t y = 0;
+  uint16_t pressure = 0; // 0 - 4095
+};
+
+static_assert(sizeof(StrokePoint) == 3 * 4,
+              "Stroke point has unexpected size");
+
+/// Points appended to the active stroke, they're drawn and sent to the
+/// display using the pen waveform.
+struct StrokePoints : SampleBatch<StrokePoint> {};
+
+/// Ends the active stroke.
+/// Commit keeps the server rendered ink in the framebuffer, the client can
+/// draw its own rendering of the stroke on top afterwards.
+/// Cancel restores the pixels that were under the stroke.
+struct StrokeEnd {
+  enum Action : uint32_t { Commit, Cancel } action = Commit;
+};
+
+/// Configures an overlay plane.
+/// Overlays are drawn on top of the shared framebuffer in increasing z order,
+/// without modifying it. Each overlay has its own shared memory buffer, with
+/// the same size as the framebuffer, see \ref getOverlayName.
+/// Only the part of the buffer inside the rect is shown.
+/// Overlays are owned by the client that last configured them, and are hidden
+/// when that client disconnects.
+struct OverlaySet {
+  int32_t id = 0;
+  int32_t z = 0;
+
+  // Visible part of the overlay, in screen coordinates, inclusive.
+  int32_t x1 = 0;
+  int32_t y1 = 0;
+  int32_t x2 = 0;
+  int32_t y2 = 0;
+
+  // Waveform and flags of the update when the visible region changes.
+  int32_t waveform = 0;
+  int32_t flags = 0;
+
+  bool visible = false;
+};
+
+/// Sends a region of the overlay buffer to the display, if it's visible.
+struct OverlayUpdate {
+  int32_t id = 0;
+  UpdateParams params = {};
+};
+
+/// Controls if the client receives all display updates, which is the
+/// default. Clients that only send messages should disable it.
+struct SetUpdateStream {
+  bool enabled = true;
+};
+
+using ClientMsg = std::variant<Input,
+                               GetUpdate,
+                               PowerButton,
+                               InputBatch,
+                               StrokeBegin,
+                               StrokePoints,
+                               StrokeEnd,
+                               OverlaySet,
+                               OverlayUpdate,
+                               SetUpdateStream>;
+
+namespace details {
+template<typename T, typename = void>
+struct IsSampleBatch : std::false_type {};
+
+template<typename T>
+struct IsSampleBatch<T, std::void_t<typename T::sample_type>>
+  : std::is_base_of<SampleBatch<typename T::sample_type, T::max_samples>, T> {
+};
+
+template<typename T>
 unistdpp::Result<void>
-sendMessage(const unistdpp::FD& fd, const std::variant<T...>& msg) {
-  TRY(fd.writeAll<int32_t>(msg.index()));
-  return std::visit([&](const auto& msg) { return fd.writeAll(msg); }, msg);
+write(const unistdpp::FD& fd, const T& msg) {
+  if constexpr (IsSampleBatch<T>::value) {
+    const auto count = std::min(msg.count, T::max_samples);
+    TRY(fd.writeAll(count));
+    return fd.writeAll(msg.samples.data(),
+                       count * sizeof(typename T::sample_type));
+  } else {
+    return fd.writeAll(msg);
+  }
 }
 
-namespace details {
-template<typename Variant, auto idx = 0>
+template<typename T, typename Reader>
+unistdpp::Result<T>
+readMsg(Reader& reader) {
+  if constexpr (IsSampleBatch<T>::value) {
+    T batch;
+    batch.count = TRY(reader.template readAll<uint32_t>());
+    if (batch.count > T::max_samples) {
+      return tl::unexpected(std::errc::bad_message);
+    }
+
+    const auto size = batch.count * sizeof(typename T::sample_type);
+    if (TRY(reader.readAll(batch.samples.data(), size)) != int(size)) {
+      return tl::unexpected(unistdpp::FD::eof_error);
+    }
+    return batch;
+  } else {
+    return reader.template readAll<T>();
+  }
+}
+
+template<typename Variant, auto idx = 0, typename Reader>
 unistdpp::Result<Variant>
-read(const unistdpp::FD& fd, int32_t index) {
+read(Reader& reader, int32_t index) {
   if constexpr (idx >= std::variant_size_v<Variant>) {
     (void)index;
     return tl::unexpected(std::errc::bad_message);
   } else {
     if (idx == index) {
       using T = std::variant_alternative_t<idx, Variant>;
-      return fd.readAll<T>();
+      return readMsg<T>(reader);
     }
-    return read<Variant, idx + 1>(fd, index);
+    return read<Variant, idx + 1>(reader, index);
   }
 }
 } // namespace details
 
-template<typename Variant>
+template<typename... T>
+unistdpp::Result<void>
+sendMessage(const unistdpp::FD& fd, const std::variant<T...>& msg) {
+  TRY(fd.writeAll<int32_t>(msg.index()));
+  return std::visit([&](const auto& msg) { return details::write(fd, msg); },
+                    msg);
+}
+
+/// Receives a message from the given reader, which can either be a
+/// \ref unistdpp::FD or a \ref unistdpp::BufferedReader.
+template<typename Variant, typename Reader>
 unistdpp::Result<Variant>
-recvMessage(const unistdpp::FD& fd) {
-  auto idx = TRY(fd.readAll<int32_t>());
-  return details::read<Variant>(fd, idx);
+recvMessage(Reader& reader) {
+  auto idx = TRY(reader.template readAll<int32_t>());
+  return details::read<Variant>(reader, idx);
 }
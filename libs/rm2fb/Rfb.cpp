@@ -0,0 +1,842 @@
+#include "Rfb.h"
+
+#include "Compositor.h"
+#include "SharedBuffer.h"
+
+#include <unistdpp/file.h>
+#include <unistdpp/socket.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+using namespace unistdpp;
+
+namespace {
+
+constexpr std::string_view protocol_version = "RFB 003.008\n";
+constexpr std::string_view desktop_name = "reMarkable";
+
+constexpr auto tile_size = 64;
+constexpr auto tiles_x = (fb_width + tile_size - 1) / tile_size;
+constexpr auto tiles_y = (fb_height + tile_size - 1) / tile_size;
+constexpr auto hextile_size = 16;
+static_assert(tile_size % hextile_size == 0);
+
+/// Tiles encoded per update, so a full screen update doesn't stall the
+/// display loop. Viewers request the remaining tiles right after.
+constexpr size_t max_update_tiles = 16;
+/// Hextile tiles with more colors are sent raw, like dithered images.
+constexpr auto max_hextile_colors = 16;
+
+constexpr auto read_size = 4096;
+constexpr auto max_read_size = 64 * 1024;
+constexpr uint32_t max_cut_text = 64 * 1024;
+
+constexpr uint8_t touch_button = 1; // Left mouse button.
+constexpr uint8_t pen_button = 4;   // Right mouse button.
+
+enum TileState : uint8_t {
+  Clean,
+  Dirty, // Changed, but could still match what the client has.
+  Force, // Requested by the client, always sent.
+};
+
+enum MsgType : uint8_t {
+  SetPixelFormat = 0,
+  SetEncodings = 2,
+  FramebufferUpdateRequest = 3,
+  KeyEvent = 4,
+  PointerEvent = 5,
+  ClientCutText = 6,
+};
+
+constexpr int32_t raw_encoding = 0;
+constexpr int32_t hextile_encoding = 5;
+
+enum HextileFlags : uint8_t {
+  HextileRaw = 1,
+  BackgroundSpecified = 2,
+  ForegroundSpecified = 4,
+  AnySubrects = 8,
+  SubrectsColoured = 16,
+};
+
+struct PixelFormat {
+  uint8_t bitsPerPixel;
+  uint8_t depth;
+  uint8_t bigEndian;
+  uint8_t trueColor;
+  uint16_t redMax;
+  uint16_t greenMax;
+  uint16_t blueMax;
+  uint8_t redShift;
+  uint8_t greenShift;
+  uint8_t blueShift;
+};
+
+// RGB565, the format of the framebuffer.
+constexpr PixelFormat server_format = {
+  .bitsPerPixel = 16,
+  .depth = 16,
+  .bigEndian = 0,
+  .trueColor = 1,
+  .redMax = 31,
+  .greenMax = 63,
+  .blueMax = 31,
+  .redShift = 11,
+  .greenShift = 5,
+  .blueShift = 0,
+};
+
+struct Rect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// All RFB values are big endian.
+void
+put8(std::vector<uint8_t>& out, uint8_t value) {
+  out.push_back(value);
+}
+
+void
+put16(std::vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value >> 8);
+  out.push_back(value & 0xff);
+}
+
+void
+put32(std::vector<uint8_t>& out, uint32_t value) {
+  put16(out, value >> 16);
+  put16(out, value & 0xffff);
+}
+
+uint16_t
+get16(const uint8_t* data) {
+  return (uint16_t(data[0]) << 8) | data[1]; // NOLINT
+}
+
+uint32_t
+get32(const uint8_t* data) {
+  return (uint32_t(get16(data)) << 16) | get16(data + 2); // NOLINT
+}
+
+void
+putPixel(std::vector<uint8_t>& out, const RfbClient& client, uint32_t pixel) {
+  switch (client.bytesPerPixel) {
+    case 1:
+      put8(out, pixel);
+      break;
+    case 2:
+      if (client.bigEndian) {
+        put16(out, pixel);
+      } else {
+        put8(out, pixel & 0xff);
+        put8(out, pixel >> 8);
+      }
+      break;
+    default:
+      if (client.bigEndian) {
+        put32(out, pixel);
+      } else {
+        for (int i = 0; i < 4; i++) {
+          put8(out, (pixel >> (8 * i)) & 0xff);
+        }
+      }
+      break;
+  }
+}
+
+void
+putPixelFormat(std::vector<uint8_t>& out, const PixelFormat& format) {
+  put8(out, format.bitsPerPixel);
+  put8(out, format.depth);
+  put8(out, format.bigEndian);
+  put8(out, format.trueColor);
+  put16(out, format.redMax);
+  put16(out, format.greenMax);
+  put16(out, format.blueMax);
+  put8(out, format.redShift);
+  put8(out, format.greenShift);
+  put8(out, format.blueShift);
+  out.insert(out.end(), 3, 0); // padding
+}
+
+PixelFormat
+getPixelFormat(const uint8_t* data) {
+  // NOLINTBEGIN
+  return PixelFormat{
+    .bitsPerPixel = data[0],
+    .depth = data[1],
+    .bigEndian = data[2],
+    .trueColor = data[3],
+    .redMax = get16(data + 4),
+    .greenMax = get16(data + 6),
+    .blueMax = get16(data + 8),
+    .redShift = data[10],
+    .greenShift = data[11],
+    .blueShift = data[12],
+  };
+  // NOLINTEND
+}
+
+void
+setPixelFormat(RfbClient& client, const PixelFormat& format) {
+  client.bytesPerPixel = format.bitsPerPixel / 8;
+  client.bigEndian = format.bigEndian != 0;
+
+  const auto scale = [](uint32_t value, uint32_t from, uint32_t to) {
+    return (value * to + from / 2) / from;
+  };
+
+  client.pixels.resize(UINT16_MAX + 1);
+  for (uint32_t rgb = 0; rgb <= UINT16_MAX; rgb++) {
+    const auto red = scale(rgb >> 11, 31, format.redMax);
+    const auto green = scale((rgb >> 5) & 0x3f, 63, format.greenMax);
+    const auto blue = scale(rgb & 0x1f, 31, format.blueMax);
+    client.pixels[rgb] = (red << format.redShift) |
+                         (green << format.greenShift) |
+                         (blue << format.blueShift);
+  }
+}
+
+Rect
+getTileRect(int index) {
+  const auto x = (index % tiles_x) * tile_size;
+  const auto y = (index / tiles_x) * tile_size;
+  return Rect{ x,
+               y,
+               std::min(tile_size, fb_width - x),
+               std::min(tile_size, fb_height - y) };
+}
+
+void
+markTiles(RfbClient& client, Rect rect, TileState state) {
+  const auto x1 = std::max(0, rect.x) / tile_size;
+  const auto y1 = std::max(0, rect.y) / tile_size;
+  const auto x2 = std::min(fb_width - 1, rect.x + rect.width - 1) / tile_size;
+  const auto y2 = std::min(fb_height - 1, rect.y + rect.height - 1) / tile_size;
+
+  for (int y = y1; y <= y2; y++) {
+    for (int x = x1; x <= x2; x++) {
+      auto& tile = client.tiles[y * tiles_x + x];
+      tile = std::max<uint8_t>(tile, state);
+    }
+  }
+}
+
+/// Copies the tile to the shadow buffer.
+/// \returns False if the client already has the same contents.
+bool
+updateShadow(RfbClient& client, const uint16_t* screen, Rect rect, bool force) {
+  const auto rowSize = rect.width * sizeof(uint16_t);
+
+  bool changed = force;
+  for (int y = rect.y; y < rect.y + rect.height; y++) {
+    const auto offset = y * fb_width + rect.x;
+    auto* shadowRow = &client.shadow[offset];
+    const auto* screenRow = screen + offset; // NOLINT
+    if (changed || memcmp(shadowRow, screenRow, rowSize) != 0) {
+      memcpy(shadowRow, screenRow, rowSize);
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+void
+encodeRaw(std::vector<uint8_t>& out, const RfbClient& client, Rect rect) {
+  for (int y = rect.y; y < rect.y + rect.height; y++) {
+    for (int x = rect.x; x < rect.x + rect.width; x++) {
+      putPixel(out, client, client.pixels[client.shadow[y * fb_width + x]]);
+    }
+  }
+}
+
+/// Background and foreground colors, which carry over between the tiles of
+/// a Hextile rect.
+struct HextileState {
+  std::optional<uint32_t> background;
+  std::optional<uint32_t> foreground;
+};
+
+void
+encodeHextileTile(std::vector<uint8_t>& out,
+                  const RfbClient& client,
+                  Rect rect,
+                  HextileState& state) {
+  std::array<uint32_t, hextile_size * hextile_size> pixels{};
+  const auto size = rect.width * rect.height;
+  for (int y = 0; y < rect.height; y++) {
+    for (int x = 0; x < rect.width; x++) {
+      const auto index = (rect.y + y) * fb_width + rect.x + x;
+      pixels[y * rect.width + x] = client.pixels[client.shadow[index]];
+    }
+  }
+
+  const auto putRaw = [&] {
+    put8(out, HextileRaw);
+    for (int i = 0; i < size; i++) {
+      putPixel(out, client, pixels[i]);
+    }
+    state = {};
+  };
+
+  // Use the most common color as background.
+  std::array<std::pair<uint32_t, int>, max_hextile_colors> colors{};
+  int numColors = 0;
+  for (int i = 0; i < size; i++) {
+    const auto end = colors.begin() + numColors;
+    auto it = std::find_if(colors.begin(), end, [&](const auto& color) {
+      return color.first == pixels[i];
+    });
+    if (it != end) {
+      it->second++;
+    } else if (numColors == max_hextile_colors) {
+      putRaw();
+      return;
+    } else {
+      colors[numColors++] = { pixels[i], 1 };
+    }
+  }
+  const auto background =
+    std::max_element(colors.begin(),
+                     colors.begin() + numColors,
+                     [](const auto& a, const auto& b) {
+                       return a.second < b.second;
+                     })
+      ->first;
+
+  // Cover all other pixels with single color rectangles.
+  struct Subrect {
+    uint32_t color;
+    uint8_t xy;
+    uint8_t wh;
+  };
+  std::array<Subrect, hextile_size * hextile_size> subrects{};
+  std::array<bool, hextile_size * hextile_size> covered{};
+  int numSubrects = 0;
+  std::optional<uint32_t> foreground;
+  bool coloured = false;
+
+  for (int y = 0; y < rect.height; y++) {
+    for (int x = 0; x < rect.width; x++) {
+      const auto index = y * rect.width + x;
+      const auto color = pixels[index];
+      if (covered[index] || color == background) {
+        continue;
+      }
+
+      int width = 1;
+      while (x + width < rect.width && !covered[index + width] &&
+             pixels[index + width] == color) {
+        width++;
+      }
+
+      int height = 1;
+      for (; y + height < rect.height; height++) {
+        const auto rowStart = index + height * rect.width;
+        const auto rowMatches =
+          std::all_of(&pixels[rowStart],
+                      &pixels[rowStart + width],
+                      [&](auto p) { return p == color; }) &&
+          std::none_of(&covered[rowStart],
+                       &covered[rowStart + width],
+                       [](auto c) { return c; });
+        if (!rowMatches) {
+          break;
+        }
+      }
+
+      for (int dy = 0; dy < height; dy++) {
+        std::fill_n(&covered[index + dy * rect.width], width, true);
+      }
+
+      subrects[numSubrects++] = Subrect{
+        color, uint8_t((x << 4) | y), uint8_t(((width - 1) << 4) | (height - 1))
+      };
+      if (!foreground.has_value()) {
+        foreground = color;
+      } else if (*foreground != color) {
+        coloured = true;
+      }
+    }
+  }
+
+  const auto bpp = client.bytesPerPixel;
+  const bool sendBackground = state.background != background;
+  const bool sendForeground =
+    numSubrects != 0 && !coloured && state.foreground != foreground;
+
+  auto encodedSize = 1 + (sendBackground ? bpp : 0);
+  if (numSubrects != 0) {
+    encodedSize += 1 + (sendForeground ? bpp : 0) +
+                   numSubrects * (2 + (coloured ? bpp : 0));
+  }
+
+  if (encodedSize >= 1 + size * bpp) {
+    putRaw();
+    return;
+  }
+
+  uint8_t flags = 0;
+  flags |= sendBackground ? BackgroundSpecified : 0;
+  flags |= sendForeground ? ForegroundSpecified : 0;
+  flags |= numSubrects != 0 ? AnySubrects : 0;
+  flags |= coloured ? SubrectsColoured : 0;
+  put8(out, flags);
+
+  if (sendBackground) {
+    putPixel(out, client, background);
+    state.background = background;
+  }
+  if (sendForeground) {
+    putPixel(out, client, *foreground);
+    state.foreground = foreground;
+  }
+  if (coloured) {
+    state.foreground = std::nullopt;
+  }
+
+  if (numSubrects == 0) {
+    return;
+  }
+
+  put8(out, numSubrects);
+  for (int i = 0; i < numSubrects; i++) {
+    const auto& subrect = subrects[i];
+    if (coloured) {
+      putPixel(out, client, subrect.color);
+    }
+    put8(out, subrect.xy);
+    put8(out, subrect.wh);
+  }
+}
+
+void
+encodeHextile(std::vector<uint8_t>& out, const RfbClient& client, Rect rect) {
+  HextileState state;
+  for (int y = 0; y < rect.height; y += hextile_size) {
+    for (int x = 0; x < rect.width; x += hextile_size) {
+      encodeHextileTile(out,
+                        client,
+                        Rect{ rect.x + x,
+                              rect.y + y,
+                              std::min(hextile_size, rect.width - x),
+                              std::min(hextile_size, rect.height - y) },
+                        state);
+    }
+  }
+}
+
+bool
+wouldBlock(std::errc err) {
+  return err == std::errc::resource_unavailable_try_again ||
+         err == std::errc::operation_would_block;
+}
+
+/// Writes as much of the output as possible, without blocking.
+bool
+flushOutput(RfbClient& client) {
+  while (client.outputOffset < client.output.size()) {
+    auto res = unistdpp::write(client.sock,
+                               &client.output[client.outputOffset],
+                               client.output.size() - client.outputOffset);
+    if (!res) {
+      if (wouldBlock(res.error())) {
+        return true;
+      }
+      std::cerr << "RFB write error: " << to_string(res.error()) << "\n";
+      return false;
+    }
+    client.outputOffset += *res;
+  }
+
+  client.output.clear();
+  client.outputOffset = 0;
+  return true;
+}
+
+} // namespace
+
+RfbClient::RfbClient(unistdpp::FD sock)
+  : sock(std::move(sock)), tiles(tiles_x * tiles_y, Force) {
+  setPixelFormat(*this, server_format);
+}
+
+void
+RfbServer::addPollFds(std::vector<pollfd>& pollfds) {
+  pollfds.emplace_back(waitFor(listenSock, Wait::Read));
+  for (const auto& client : clients) {
+    pollfds.emplace_back(waitFor(
+      client.sock, client.output.empty() ? Wait::Read : Wait::ReadWrite));
+  }
+  numPolledClients = clients.size();
+}
+
+void
+RfbServer::handlePoll(const std::vector<pollfd>& pollfds, size_t offset) {
+  for (size_t i = 0; i < numPolledClients; i++) {
+    const auto& pollFd = pollfds[offset + 1 + i];
+    auto& client = clients[i];
+
+    bool ok = (pollFd.revents & (POLLERR | POLLHUP)) == 0 || canRead(pollFd);
+    if (ok && canRead(pollFd)) {
+      ok = handleInput(client);
+    }
+    if (ok) {
+      ok = flushOutput(client);
+    }
+    if (!ok) {
+      std::cerr << "RFB client disconnected\n";
+      client.sock.close();
+    }
+  }
+
+  if (canRead(pollfds[offset])) {
+    acceptClient();
+  }
+
+  const auto numClients = clients.size();
+  clients.erase(
+    std::remove_if(clients.begin(),
+                   clients.end(),
+                   [](const auto& client) { return !client.sock.isValid(); }),
+    clients.end());
+  if (clients.size() != numClients) {
+    std::cerr << "RFB clients: " << clients.size() << "\n";
+  }
+}
+
+void
+RfbServer::addDamage(const UpdateParams& params) {
+  const auto rect = Rect{ params.x1,
+                          params.y1,
+                          params.x2 - params.x1 + 1,
+                          params.y2 - params.y1 + 1 };
+  if (rect.width <= 0 || rect.height <= 0) {
+    return;
+  }
+
+  for (auto& client : clients) {
+    markTiles(client, rect, Dirty);
+  }
+}
+
+void
+RfbServer::sendUpdates() {
+  for (auto& client : clients) {
+    if (client.state != RfbClient::State::Normal || !client.updateRequested ||
+        !client.output.empty() || !client.sock.isValid()) {
+      continue;
+    }
+
+    sendUpdate(client);
+    if (!flushOutput(client)) {
+      client.sock.close();
+    }
+  }
+}
+
+void
+RfbServer::acceptClient() {
+  auto sock = unistdpp::accept(listenSock, nullptr, nullptr);
+  if (!sock) {
+    std::cerr << "RFB accept error: " << to_string(sock.error()) << "\n";
+    return;
+  }
+
+  if (auto res = setNonBlocking(*sock); !res) {
+    std::cerr << "RFB client error: " << to_string(res.error()) << "\n";
+    return;
+  }
+  addClient(std::move(*sock));
+}
+
+void
+RfbServer::addClient(unistdpp::FD sock) {
+  std::cerr << "New RFB client!\n";
+  auto& client = clients.emplace_back(std::move(sock));
+  client.output.insert(
+    client.output.end(), protocol_version.begin(), protocol_version.end());
+  if (!flushOutput(client)) {
+    client.sock.close();
+  }
+}
+
+bool
+RfbServer::handleInput(RfbClient& client) {
+  std::array<uint8_t, read_size> buffer{};
+  for (int total = 0; total < max_read_size;) {
+    auto res = unistdpp::read(client.sock, buffer.data(), buffer.size());
+    if (!res) {
+      if (wouldBlock(res.error())) {
+        break;
+      }
+      std::cerr << "RFB read error: " << to_string(res.error()) << "\n";
+      return false;
+    }
+    if (*res == 0) {
+      return false;
+    }
+
+    client.input.insert(client.input.end(), buffer.begin(), &buffer[*res]);
+    total += *res;
+  }
+
+  while (client.sock.isValid()) {
+    auto res = parseMessage(client);
+    if (!res) {
+      std::cerr << "RFB protocol error: " << to_string(res.error()) << "\n";
+      return false;
+    }
+    if (*res == 0) {
+      break;
+    }
+
+    client.input.erase(client.input.begin(), client.input.begin() + *res);
+  }
+
+  return true;
+}
+
+Result<size_t>
+RfbServer::parseMessage(RfbClient& client) {
+  const auto* data = client.input.data();
+  const auto size = client.input.size();
+  auto& out = client.output;
+
+  switch (client.state) {
+    case RfbClient::State::Version: {
+      if (size < protocol_version.size()) {
+        return 0;
+      }
+      const auto version =
+        std::string_view(reinterpret_cast<const char*>(data), // NOLINT
+                         protocol_version.size());
+      if (version.substr(0, 8) != protocol_version.substr(0, 8)) {
+        return tl::unexpected(std::errc::protocol_not_supported);
+      }
+
+      // 3.3 only lets the server pick the security type, 3.7 doesn't send a
+      // result for 'None'.
+      int minor = 0;
+      std::from_chars(&version[8], &version[11], minor);
+      client.minorVersion = minor < 7 ? 3 : std::min(minor, 8);
+      if (client.minorVersion == 3) {
+        put32(out, 1); // None
+        client.state = RfbClient::State::Init;
+      } else {
+        put8(out, 1); // Number of security types
+        put8(out, 1); // None
+        client.state = RfbClient::State::Security;
+      }
+      return protocol_version.size();
+    }
+
+    case RfbClient::State::Security:
+      if (size < 1) {
+        return 0;
+      }
+      if (data[0] != 1) {
+        return tl::unexpected(std::errc::permission_denied);
+      }
+      if (client.minorVersion >= 8) {
+        put32(out, 0); // OK
+      }
+      client.state = RfbClient::State::Init;
+      return 1;
+
+    case RfbClient::State::Init:
+      if (size < 1) {
+        return 0;
+      }
+      put16(out, fb_width);
+      put16(out, fb_height);
+      putPixelFormat(out, server_format);
+      put32(out, desktop_name.size());
+      out.insert(out.end(), desktop_name.begin(), desktop_name.end());
+
+      client.shadow.resize(fb_width * fb_height);
+      client.state = RfbClient::State::Normal;
+      return 1;
+
+    case RfbClient::State::Normal:
+      break;
+  }
+
+  if (size < 1) {
+    return 0;
+  }
+
+  // NOLINTBEGIN
+  switch (data[0]) {
+    case SetPixelFormat: {
+      if (size < 20) {
+        return 0;
+      }
+      const auto format = getPixelFormat(data + 4);
+      if (format.trueColor == 0) {
+        std::cerr << "RFB colour maps aren't supported\n";
+        return tl::unexpected(std::errc::not_supported);
+      }
+      if (format.bitsPerPixel != 8 && format.bitsPerPixel != 16 &&
+          format.bitsPerPixel != 32) {
+        return tl::unexpected(std::errc::not_supported);
+      }
+      setPixelFormat(client, format);
+      std::fill(client.tiles.begin(), client.tiles.end(), Force);
+      return 20;
+    }
+
+    case SetEncodings: {
+      if (size < 4) {
+        return 0;
+      }
+      const auto count = get16(data + 2);
+      const auto msgSize = 4 + 4 * size_t(count);
+      if (size < msgSize) {
+        return 0;
+      }
+
+      // Use the first supported encoding, in order of the client preference.
+      client.hextile = false;
+      for (size_t i = 0; i < count; i++) {
+        const auto encoding = int32_t(get32(data + 4 + 4 * i));
+        if (encoding == hextile_encoding || encoding == raw_encoding) {
+          client.hextile = encoding == hextile_encoding;
+          break;
+        }
+      }
+      return msgSize;
+    }
+
+    case FramebufferUpdateRequest: {
+      if (size < 10) {
+        return 0;
+      }
+      const bool incremental = data[1] != 0;
+      if (!incremental) {
+        markTiles(client,
+                  Rect{ get16(data + 2),
+                        get16(data + 4),
+                        get16(data + 6),
+                        get16(data + 8) },
+                  Force);
+      }
+      client.updateRequested = true;
+      return 10;
+    }
+
+    case KeyEvent:
+      return size < 8 ? 0 : 8;
+
+    case PointerEvent:
+      if (size < 6) {
+        return 0;
+      }
+      handlePointer(client, data[1], get16(data + 2), get16(data + 4));
+      return 6;
+
+    case ClientCutText: {
+      if (size < 8) {
+        return 0;
+      }
+      const auto length = get32(data + 4);
+      if (length > max_cut_text) {
+        return tl::unexpected(std::errc::message_size);
+      }
+      return size < 8 + length ? 0 : 8 + length;
+    }
+
+    default:
+      return tl::unexpected(std::errc::bad_message);
+  }
+  // NOLINTEND
+}
+
+void
+RfbServer::handlePointer(RfbClient& client, uint8_t buttons, int x, int y) {
+  x = std::clamp(x, 0, fb_width - 1);
+  y = std::clamp(y, 0, fb_height - 1);
+
+  const auto getInput = [&](uint8_t button) -> std::optional<Input> {
+    const bool wasDown = (client.buttons & button) != 0;
+    const bool isDown = (buttons & button) != 0;
+    if (!wasDown && !isDown) {
+      return std::nullopt;
+    }
+
+    const auto type = !wasDown ? Input::Down : isDown ? Input::Move : Input::Up;
+    return Input{ x, y, type, button == touch_button };
+  };
+
+  if (auto input = getInput(touch_button); input && devs.touch) {
+    sendTouch(*input, *devs.touch);
+  }
+  if (auto input = getInput(pen_button); input && devs.wacom) {
+    sendPen(*input, *devs.wacom);
+  }
+
+  client.buttons = buttons;
+}
+
+void
+RfbServer::sendUpdate(RfbClient& client) {
+  const auto* screen = compositor.getScanout();
+
+  // Continue after the tiles of the last update, so all tiles get their
+  // turn while others keep changing.
+  std::vector<Rect> rects;
+  const auto numTiles = client.tiles.size();
+  const auto firstTile = client.nextTile;
+  for (size_t n = 0; n < numTiles && rects.size() < max_update_tiles; n++) {
+    const auto i = (firstTile + n) % numTiles;
+    auto& tile = client.tiles[i];
+    if (tile == Clean) {
+      continue;
+    }
+
+    const auto rect = getTileRect(int(i));
+    if (updateShadow(client, screen, rect, tile == Force)) {
+      rects.push_back(rect);
+      client.nextTile = i + 1;
+    }
+    tile = Clean;
+  }
+
+  // Wait for the next change.
+  if (rects.empty()) {
+    return;
+  }
+
+  auto& out = client.output;
+  put8(out, 0); // FramebufferUpdate
+  put8(out, 0); // padding
+  put16(out, rects.size());
+
+  for (const auto& rect : rects) {
+    put16(out, rect.x);
+    put16(out, rect.y);
+    put16(out, rect.width);
+    put16(out, rect.height);
+
+    if (client.hextile) {
+      put32(out, hextile_encoding);
+      encodeHextile(out, client, rect);
+    } else {
+      put32(out, raw_encoding);
+      encodeRaw(out, client, rect);
+    }
+  }
+
+  client.updateRequested = false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "InputDevice.h"
+#include "Message.h"
+
+#include <unistdpp/poll.h>
+#include <unistdpp/unistdpp.h>
+
+#include <vector>
+
+class Compositor;
+
+/// A connected VNC viewer.
+struct RfbClient {
+  enum class State { Version, Security, Init, Normal };
+
+  unistdpp::FD sock;
+  State state = State::Version;
+  int minorVersion = 8;
+
+  std::vector<uint8_t> input;
+  std::vector<uint8_t> output;
+  size_t outputOffset = 0;
+
+  /// The client pixel value for each RGB565 pixel.
+  std::vector<uint32_t> pixels;
+  int bytesPerPixel = 2;
+  bool bigEndian = false;
+  bool hextile = false;
+
+  bool updateRequested = false;
+  /// Which tiles need to be sent.
+  std::vector<uint8_t> tiles;
+  /// Where the next update starts looking for tiles to send.
+  size_t nextTile = 0;
+  /// The screen contents as last sent to the client.
+  std::vector<uint16_t> shadow;
+
+  uint8_t buttons = 0;
+
+  explicit RfbClient(unistdpp::FD sock);
+};
+
+/// Serves the display using the RFB (VNC) protocol, so stock VNC viewers can
+/// connect to rm2fb-server.
+///
+/// Changes are tracked per client in tiles. Only tiles that differ from what
+/// the client received last are sent, using the Hextile encoding if the viewer
+/// supports it.
+/// Client sockets are non-blocking, new updates are only encoded once the
+/// previous one is written. So slow viewers get fewer, merged updates instead
+/// of stalling the display. Each update has a bounded number of tiles, large
+/// changes are sent over multiple updates.
+///
+/// The left mouse button is forwarded as touch, the right one as the pen.
+class RfbServer {
+public:
+  RfbServer(unistdpp::FD listenSock,
+            const Compositor& compositor,
+            const AllUinputDevices& devs)
+    : listenSock(std::move(listenSock)), compositor(compositor), devs(devs) {}
+
+  /// Adds the FDs to poll, which should be passed to \ref handlePoll.
+  void addPollFds(std::vector<pollfd>& pollfds);
+
+  /// Handles the results of the FDs added by \ref addPollFds, starting at
+  /// the given offset.
+  void handlePoll(const std::vector<pollfd>& pollfds, size_t offset);
+
+  /// Marks the region as changed.
+  void addDamage(const UpdateParams& params);
+
+  /// Sends the changed tiles to all clients that requested an update and
+  /// aren't still busy with the previous one.
+  void sendUpdates();
+
+  /// Adds a connected, non-blocking client socket.
+  void addClient(unistdpp::FD sock);
+
+private:
+  void acceptClient();
+
+  bool handleInput(RfbClient& client);
+  unistdpp::Result<size_t> parseMessage(RfbClient& client);
+  void handlePointer(RfbClient& client, uint8_t buttons, int x, int y);
+  void sendUpdate(RfbClient& client);
+
+  unistdpp::FD listenSock;
+  const Compositor& compositor;
+  const AllUinputDevices& devs;
+
+  std::vector<RfbClient> clients;
+  size_t numPolledClients = 0;
+};
@@ -1,19 +1,25 @@
+#include "Compositor.h"
 #include "ControlSocket.h"
 #include "InputDevice.h"
 #include "Message.h"
+#include "Rfb.h"
 #include "SharedBuffer.h"
+#include "Stroke.h"
 #include "Versions/Version.h"
 
 #include <unistdpp/file.h>
 #include <unistdpp/poll.h>
+#include <unistdpp/reader.h>
 #include <unistdpp/socket.h>
 #include <unistdpp/unistdpp.h>
 
 #include <algorithm>
 #include <atomic>
+#include <charconv>
 #include <csignal>
 #include <cstring>
 #include <dlfcn.h>
+#include <functional>
 #include <iostream>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -23,8 +29,6 @@
 using namespace unistdpp;
 
 namespace {
-constexpr auto tcp_port = 8888;
-
 std::atomic_bool running = true; // NOLINT
 
 void
@@ -65,6 +69,27 @@ checkDebugMode() {
   return debug_mode;
 }
 
+/// \returns The port of the RFB server, if enabled.
+std::optional<int>
+getRfbPort() {
+  const auto* portEnv = getenv("RM2FB_RFB_PORT");
+  if (portEnv == nullptr) {
+    return std::nullopt;
+  }
+
+  const auto str = std::string_view(portEnv);
+  int port = 0;
+  const auto [end, err] =
+    std::from_chars(str.data(), str.data() + str.size(), port);
+  if (err != std::errc() || end != str.data() + str.size() || port <= 0 ||
+      port > UINT16_MAX) {
+    std::cerr << "Invalid RM2FB_RFB_PORT '" << str
+              << "', not starting the RFB server\n";
+    return std::nullopt;
+  }
+  return port;
+}
+
 struct Sockets {
   std::optional<ControlSocket> controlSock = std::nullopt;
   std::optional<FD> tcpSock = std::nullopt;
@@ -130,7 +155,9 @@ getTcpSocket(int port) {
 }
 
 bool
-doTCPUpdate(unistdpp::FD& fd, const SharedFB& fb, const UpdateParams& params) {
+doTCPUpdate(unistdpp::FD& fd,
+            const uint16_t* screen,
+            const UpdateParams& params) {
   if (auto res = fd.writeAll(params); !res) {
     std::cerr << "Error writing: " << to_string(res.error()) << "\n";
     fd.close();
@@ -146,8 +173,7 @@ doTCPUpdate(unistdpp::FD& fd, const SharedFB& fb, const UpdateParams& params) {
     int fbRow = row + params.y1;
 
     memcpy(&buffer[row * width],
-           // NOLINTNEXTLINE
-           static_cast<uint16_t*>(fb.mem.get()) + fbRow * fb_width + params.x1,
+           screen + fbRow * fb_width + params.x1, // NOLINT
            width * sizeof(uint16_t));
   }
 
@@ -172,11 +198,31 @@ readControlMessage(ControlSocket& serverSock, Fn&& fn) {
     });
 }
 
+struct TcpClient {
+  unistdpp::FD sock;
+  unistdpp::BufferedReader reader;
+  StrokeRenderer stroke;
+
+  int id;
+  bool streamUpdates = true;
+
+  TcpClient(unistdpp::FD fd, int id)
+    : sock(std::move(fd)), reader(sock), id(id) {}
+};
+
+/// State needed to handle messages from TCP clients.
+struct MsgContext {
+  const SharedFB& fb;
+  const AllUinputDevices& devs;
+  TcpClient& client;
+  Compositor& compositor;
+
+  /// Sends the update to the display and all TCP clients.
+  const std::function<bool(const UpdateParams&)>& dispatchUpdate;
+};
+
 void
-handleMsg(const SharedFB& fb,
-          unistdpp::FD& fd,
-          const AllUinputDevices& devs,
-          GetUpdate msg) {
+handleMsg(MsgContext& ctx, GetUpdate msg) {
   UpdateParams params{
     .y1 = 0,
     .x1 = 0,
@@ -187,32 +233,71 @@ handleMsg(const SharedFB& fb,
     .temperatureOverride = 0,
     .extraMode = 0,
   };
-  doTCPUpdate(fd, fb, params);
+  doTCPUpdate(ctx.client.sock, ctx.compositor.getScanout(), params);
+}
+
+void
+handleMsg(MsgContext& ctx, const Input& msg) {
+  if (!msg.touch && ctx.devs.wacom) {
+    sendPen(msg, *ctx.devs.wacom);
+  }
+  if (msg.touch && ctx.devs.touch) {
+    sendTouch(msg, *ctx.devs.touch);
+  }
+}
+
+void
+handleMsg(MsgContext& ctx, const PowerButton& msg) {
+  if (ctx.devs.button) {
+    sendButton(msg.down, *ctx.devs.button);
+  }
+}
+
+void
+handleMsg(MsgContext& ctx, const InputBatch& msg) {
+  sendInputBatch(msg, ctx.devs);
+}
+
+void
+handleMsg(MsgContext& ctx, const StrokeBegin& msg) {
+  // Starting a new stroke commits the previous one, which needs no update.
+  ctx.client.stroke.end(ctx.fb, StrokeEnd{ .action = StrokeEnd::Commit });
+  ctx.client.stroke.begin(msg);
+}
+
+void
+handleMsg(MsgContext& ctx, const StrokePoints& msg) {
+  if (auto update = ctx.client.stroke.addPoints(ctx.fb, msg)) {
+    ctx.dispatchUpdate(*update);
+  }
 }
 
 void
-handleMsg(const SharedFB& fb,
-          unistdpp::FD& fd,
-          const AllUinputDevices& devs,
-          const Input& msg) {
-  if (!msg.touch && devs.wacom) {
-    sendPen(msg, *devs.wacom);
+handleMsg(MsgContext& ctx, const StrokeEnd& msg) {
+  if (auto update = ctx.client.stroke.end(ctx.fb, msg)) {
+    ctx.dispatchUpdate(*update);
   }
-  if (msg.touch && devs.touch) {
-    sendTouch(msg, *devs.touch);
+}
+
+void
+handleMsg(MsgContext& ctx, const OverlaySet& msg) {
+  if (auto update = ctx.compositor.setOverlay(msg, ctx.client.id)) {
+    ctx.dispatchUpdate(*update);
   }
 }
 
 void
-handleMsg(const SharedFB& fb,
-          unistdpp::FD& fd,
-          const AllUinputDevices& devs,
-          const PowerButton& msg) {
-  if (devs.button) {
-    sendButton(msg.down, *devs.button);
+handleMsg(MsgContext& ctx, const OverlayUpdate& msg) {
+  if (auto update = ctx.compositor.updateOverlay(msg)) {
+    ctx.dispatchUpdate(*update);
   }
 }
 
+void
+handleMsg(MsgContext& ctx, const SetUpdateStream& msg) {
+  ctx.client.streamUpdates = msg.enabled;
+}
+
 } // namespace
 
 int
@@ -256,7 +341,7 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
       std::cerr << "Using TCP socket from systemd\n";
       return std::move(*systemdSockets.tcpSock);
     }
-    return getTcpSocket(tcp_port);
+    return getTcpSocket(rm2fb_tcp_port);
   }();
   if (!tcpFd) {
     std::cerr << "Unable to start TCP listener: " << to_string(tcpFd.error())
@@ -264,7 +349,8 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
   }
 
   std::vector<unistdpp::FD> unixClients;
-  std::vector<unistdpp::FD> tcpClients;
+  std::vector<TcpClient> tcpClients;
+  int nextClientId = 0;
 
   // Get addresses
   if (addrs == nullptr) {
@@ -280,25 +366,67 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
   const auto& fb =
     fatalOnError(SharedFB::getInstance(), "Error creating shared FB");
 
+  Compositor compositor(fb, getScanoutBuffer());
+
   // Call the get or create Instance function.
   if (!inQemu) {
     std::cerr << "SWTCON calling init\n";
-
-    // NOLINTNEXTLINE
-    auto copyBuffer = std::make_unique<uint16_t[]>(fb_width * fb_height);
-
-    // The init threads does a memset to 0xff. But if we're activated by a
-    // systemd socket the shared memory already has some content. So make a
-    // backup and preserve it.
-    memcpy(copyBuffer.get(), fb.mem.get(), fb_size);
     addrs->initThreads();
-    memcpy(fb.mem.get(), copyBuffer.get(), fb_size);
-
     std::cerr << "SWTCON initalized!\n";
   } else {
     std::cerr << "In QEMU, not starting SWTCON\n";
   }
 
+  // The SWTCON reads from the scanout buffer, which init clears. If we're
+  // activated by a systemd socket the shared memory already has some content,
+  // so copy it over.
+  compositor.compose(UpdateParams{
+    .y1 = 0,
+    .x1 = 0,
+    .y2 = fb_height - 1,
+    .x2 = fb_width - 1,
+    .flags = 0,
+    .waveform = 0,
+    .temperatureOverride = 0,
+    .extraMode = 0,
+  });
+
+  std::optional<RfbServer> rfbServer;
+  if (auto port = getRfbPort(); port.has_value()) {
+    getTcpSocket(*port)
+      .transform([&](auto sock) {
+        std::cerr << "RFB server listening on " << *port << "\n";
+        rfbServer.emplace(std::move(sock), compositor, devices);
+      })
+      .or_else([](auto err) {
+        std::cerr << "Unable to start RFB server: " << to_string(err) << "\n";
+      });
+  }
+
+  // Sends an update that's already in the scanout buffer to the display and
+  // all TCP clients.
+  const auto presentUpdate = [&](const UpdateParams& msg) {
+    bool res = false;
+    if (!inQemu) {
+      res = addrs->doUpdate(msg);
+    }
+    for (auto& client : tcpClients) {
+      if (client.streamUpdates && client.sock.isValid()) {
+        doTCPUpdate(client.sock, compositor.getScanout(), msg);
+      }
+    }
+    if (rfbServer) {
+      rfbServer->addDamage(msg);
+    }
+    return res;
+  };
+
+  const std::function<bool(const UpdateParams&)> dispatchUpdate =
+    [&](const UpdateParams& msg) {
+      compositor.compose(msg);
+      return presentUpdate(msg);
+    };
+
   const auto numListenFds = 1 + (tcpFd.has_value() ? 1 : 0);
   std::vector<pollfd> pollfds;
 
@@ -326,7 +454,12 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
       tcpClients.begin(),
       tcpClients.end(),
       std::back_inserter(pollfds),
-      [](const auto& client) { return waitFor(client, Wait::Read); });
+      [](const auto& client) { return waitFor(client.sock, Wait::Read); });
+
+    const auto rfbPollOffset = pollfds.size();
+    if (rfbServer) {
+      rfbServer->addPollFds(pollfds);
+    }
 
     if (auto res = unistdpp::poll(pollfds); !res) {
       std::cerr << "Poll error: " << to_string(res.error()) << "\n";
@@ -350,28 +483,32 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
       }
 
       auto& sock = unixClients[i];
-      sock.readAll<UpdateParams>()
-        .and_then([&](auto msg) {
+      sock.readAll<UpdateCommit>()
+        .and_then([&](auto commit) -> Result<void> {
+          const auto& msg = commit.params;
+          auto fence = UpdateFence{ .sequence = commit.sequence, .ok = 1 };
+
           // Emtpy message, just to check init.
           if (msg.x1 == msg.x2 && msg.y1 == msg.y2) {
             std::cerr << "Got init check!\n";
-            return sock.writeAll(true);
+            return sock.writeAll(fence);
           }
 
-          bool res = false;
-          if (!inQemu) {
-            res = addrs->doUpdate(msg);
-          }
-          for (auto& client : tcpClients) {
-            doTCPUpdate(client, fb, msg);
-          }
+          // Once the region is copied to the scanout buffer the client is
+          // free to draw again, so release the fence before the SWTCON
+          // starts working on the update.
+          compositor.compose(msg);
+          TRY(sock.writeAll(fence));
+
+          const bool res = presentUpdate(msg);
 
           // Don't log Stroke updates, unless debug mode is on.
           if (debugMode) {
-            std::cerr << "UPDATE " << msg << ": " << res << "\n";
+            std::cerr << "UPDATE " << commit.sequence << " " << msg << ": "
+                      << res << "\n";
           }
 
-          return sock.writeAll(res);
+          return {};
         })
         .or_else([&](auto err) {
           std::cerr << "Unix read fail: " << to_string(err) << "\n";
@@ -381,17 +518,17 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
         });
     }
 
-    // If we don't have any tcp clients, there are not other FDs to check.
-    if (!tcpFd) {
-      continue;
+    if (rfbServer) {
+      rfbServer->handlePoll(pollfds, rfbPollOffset);
     }
 
-    if (canRead(pollfds[1])) {
+    if (tcpFd && canRead(pollfds[1])) {
       std::cerr << "Accepting new client!\n";
 
       unistdpp::accept(*tcpFd, nullptr, nullptr)
-        .transform(
-          [&](auto client) { tcpClients.emplace_back(std::move(client)); })
+        .transform([&](auto client) {
+          tcpClients.emplace_back(std::move(client), nextClientId++);
+        })
         .or_else([](auto err) {
           std::cerr << "Client accept errror: " << to_string(err) << "\n";
         });
@@ -402,18 +539,29 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
         continue;
       }
 
-      auto& clientSock = tcpClients[i];
-      recvMessage<ClientMsg>(clientSock)
-        .transform([&](const auto& msg) {
-          std::visit([&](auto msg) { handleMsg(fb, clientSock, devices, msg); },
-                     msg);
-        })
-        .or_else([&](auto err) {
-          std::cerr << "Reading input: " << to_string(err) << "\n";
-          if (err == unistdpp::FD::eof_error) {
-            clientSock.close();
-          }
-        });
+      // Handle all buffered messages, so input sent in quick succession
+      // doesn't need a poll and read per message.
+      auto& client = tcpClients[i];
+      MsgContext ctx{ .fb = fb,
+                      .devs = devices,
+                      .client = client,
+                      .compositor = compositor,
+                      .dispatchUpdate = dispatchUpdate };
+      bool ok = true;
+      do {
+        ok = recvMessage<ClientMsg>(client.reader)
+               .transform([&](const auto& msg) {
+                 std::visit([&](const auto& msg) { handleMsg(ctx, msg); },
+                            msg);
+               })
+               .or_else([&](auto err) {
+                 std::cerr << "Reading input: " << to_string(err) << "\n";
+                 if (err == unistdpp::FD::eof_error) {
+                   client.sock.close();
+                 }
+               })
+               .has_value();
+      } while (ok && client.sock.isValid() && client.reader.buffered() != 0);
     }
 
     // Remove closed clients
@@ -423,10 +571,17 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
                      [](const auto& sock) { return !sock.isValid(); }),
       unixClients.end());
 
+    for (const auto& client : tcpClients) {
+      if (!client.sock.isValid()) {
+        for (const auto& update : compositor.removeOwner(client.id)) {
+          dispatchUpdate(update);
+        }
+      }
+    }
     tcpClients.erase(
       std::remove_if(tcpClients.begin(),
                      tcpClients.end(),
-                     [](const auto& sock) { return !sock.isValid(); }),
+                     [](const auto& client) { return !client.sock.isValid(); }),
       tcpClients.end());
 
     // Report number of clients if size changed
@@ -435,6 +590,12 @@ serverMain(char* argv0, const AddressInfoBase* addrs) { // NOLINT
       std::cerr << "Unix clients: " << unixClients.size()
                 << " TCP clients: " << tcpClients.size() << "\n";
     }
+
+    // Encode RFB updates last, after all updates of this iteration reached
+    // the display.
+    if (rfbServer) {
+      rfbServer->sendUpdates();
+    }
   }
 
   return EXIT_SUCCESS;
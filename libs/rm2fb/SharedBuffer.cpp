@@ -3,11 +3,13 @@
 #include <unistdpp/file.h>
 #include <unistdpp/shared_mem.h>
 
+#include <algorithm>
 #include <cstring>
 #include <fcntl.h> /* For O_* constants */
 #include <sys/mman.h>
 #include <sys/stat.h> /* For mode constants */
 #include <unistd.h>
+#include <vector>
 
 using namespace unistdpp;
 
@@ -16,7 +18,7 @@ constexpr mode_t shm_mode = 0666;
 }
 
 Result<SharedFB>
-SharedFB::open(const char* path) {
+SharedFB::open(const char* path, int size) {
   auto fd = unistdpp::shm_open(path, O_RDWR, 0);
 
   bool clear = false;
@@ -33,12 +35,14 @@ SharedFB::open(const char* path) {
     return tl::unexpected(fd.error());
   }
 
-  TRY(unistdpp::ftruncate(*fd, total_size));
+  TRY(unistdpp::ftruncate(*fd, size));
   auto mem =
-    TRY(unistdpp::mmap(nullptr, total_size, PROT_WRITE, MAP_SHARED, *fd, 0));
+    TRY(unistdpp::mmap(nullptr, size, PROT_WRITE, MAP_SHARED, *fd, 0));
   if (clear) {
-    memset(mem.get(), UINT8_MAX, fb_size);
-    memset((char*)mem.get() + fb_size, 0, grayscale_size);
+    memset(mem.get(), UINT8_MAX, std::min(size, fb_size));
+    if (size > fb_size) {
+      memset((char*)mem.get() + fb_size, 0, size - fb_size);
+    }
   }
   return SharedFB{ .fd = std::move(*fd), .mem = std::move(mem) };
 }
@@ -48,3 +52,9 @@ SharedFB::getInstance() {
   static auto instance = SharedFB::open(default_fb_name);
   return instance;
 }
+
+uint16_t*
+getScanoutBuffer() {
+  static std::vector<uint16_t> buffer(fb_width * fb_height, UINT16_MAX);
+  return buffer.data();
+}
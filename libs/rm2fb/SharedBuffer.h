@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 #include <unistdpp/mmap.h>
 #include <unistdpp/unistdpp.h>
@@ -15,6 +16,14 @@ constexpr int total_size = fb_size + grayscale_size;
 
 constexpr auto default_fb_name = "/swtfb.01";
 
+constexpr int max_overlays = 4;
+
+/// \returns The name of the shared memory buffer of the given overlay.
+inline std::string
+getOverlayName(int id) {
+  return "/swtfb.overlay." + std::to_string(id);
+}
+
 struct SharedFB {
   unistdpp::FD fd;
   unistdpp::MmapPtr mem;
@@ -22,7 +31,13 @@ struct SharedFB {
   void* getFb() const { return mem.get(); }
   void* getGrayBuffer() const { return ((char*)mem.get()) + fb_size; }
 
-  static unistdpp::Result<SharedFB> open(const char* path);
+  static unistdpp::Result<SharedFB> open(const char* path,
+                                         int size = total_size);
 
   static const unistdpp::Result<SharedFB>& getInstance();
 };
+
+/// The buffer the SWTCON reads from in the server. Client updates are copied
+/// into it from the shared FB, with any overlays drawn on top.
+uint16_t*
+getScanoutBuffer();
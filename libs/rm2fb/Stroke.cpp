@@ -0,0 +1,239 @@
+#include "Stroke.h"
+
+#include "SharedBuffer.h"
+
+#include <rm2.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr auto max_pressure = 4095;
+
+// Same as the fast draw updates from the rm1 ioctls, see IOCTL.cpp.
+constexpr auto pen_flags = 4;
+
+constexpr uint16_t
+toRGB565(uint8_t gray) {
+  return ((gray >> 3) << 11) | ((gray >> 2) << 5) | (gray >> 3);
+}
+
+/// Clips the part [t1, t2] of the line start + t * delta to [lower, upper].
+/// \returns false if none of it is left.
+bool
+clipLine(double start,
+         double delta,
+         double lower,
+         double upper,
+         double& t1,
+         double& t2) {
+  if (delta == 0) {
+    return lower <= start && start <= upper;
+  }
+
+  auto tLower = (lower - start) / delta;
+  auto tUpper = (upper - start) / delta;
+  if (tLower > tUpper) {
+    std::swap(tLower, tUpper);
+  }
+  t1 = std::max(t1, tLower);
+  t2 = std::min(t2, tUpper);
+  return t1 <= t2;
+}
+
+} // namespace
+
+void
+StrokeRenderer::Bounds::add(int x, int y) {
+  x1 = std::min(x1, x);
+  y1 = std::min(y1, y);
+  x2 = std::max(x2, x);
+  y2 = std::max(y2, y);
+}
+
+void
+StrokeRenderer::begin(const StrokeBegin& params) {
+  this->params = params;
+  this->params.minWidth = std::clamp<uint16_t>(params.minWidth, 1, max_width);
+  this->params.maxWidth =
+    std::clamp(params.maxWidth, this->params.minWidth, max_width);
+  color = toRGB565(params.color);
+  active = true;
+
+  lastPoint = std::nullopt;
+  strokeBounds = {};
+  saved.clear();
+  if (touched.empty()) {
+    touched.resize(fb_width * fb_height);
+  }
+}
+
+std::optional<UpdateParams>
+StrokeRenderer::addPoints(const SharedFB& fb, const StrokePoints& points) {
+  if (!active) {
+    return std::nullopt;
+  }
+
+  auto* mem = static_cast<uint16_t*>(fb.getFb());
+  Bounds damage;
+
+  const auto count = std::min(points.count, StrokePoints::max_samples);
+  for (uint32_t i = 0; i < count; i++) {
+    const auto& point = points.samples[i]; // NOLINT
+    if (lastPoint.has_value()) {
+      drawSegment(mem, *lastPoint, point, damage);
+    } else {
+      drawDisc(mem,
+               float(point.x),
+               float(point.y),
+               getRadius(point.pressure),
+               damage);
+    }
+    lastPoint = point;
+  }
+
+  if (damage.empty()) {
+    return std::nullopt;
+  }
+
+  strokeBounds.add(damage.x1, damage.y1);
+  strokeBounds.add(damage.x2, damage.y2);
+  return makeUpdate(damage, /* pen */ true);
+}
+
+std::optional<UpdateParams>
+StrokeRenderer::end(const SharedFB& fb, const StrokeEnd& msg) {
+  if (!active) {
+    return std::nullopt;
+  }
+  active = false;
+
+  const bool restore = msg.action == StrokeEnd::Cancel;
+  auto* mem = static_cast<uint16_t*>(fb.getFb());
+  for (const auto& [index, pixel] : saved) {
+    if (restore) {
+      mem[index] = pixel; // NOLINT
+    }
+    touched[index] = false;
+  }
+  saved.clear();
+
+  if (!restore || strokeBounds.empty()) {
+    return std::nullopt;
+  }
+
+  return makeUpdate(strokeBounds, /* pen */ false);
+}
+
+void
+StrokeRenderer::drawDisc(uint16_t* mem,
+                         float centerX,
+                         float centerY,
+                         float radius,
+                         Bounds& damage) {
+  // Checked before converting to int, client points can be anywhere.
+  if (centerX + radius < 0 || centerY + radius < 0 ||
+      centerX - radius > float(fb_width - 1) ||
+      centerY - radius > float(fb_height - 1)) {
+    return;
+  }
+
+  const auto x1 = std::max(0, int(std::floor(centerX - radius)));
+  const auto y1 = std::max(0, int(std::floor(centerY - radius)));
+  const auto x2 = std::min(fb_width - 1, int(std::ceil(centerX + radius)));
+  const auto y2 = std::min(fb_height - 1, int(std::ceil(centerY + radius)));
+  if (x1 > x2 || y1 > y2) {
+    return;
+  }
+
+  const auto radius2 = radius * radius;
+  for (int y = y1; y <= y2; y++) {
+    const auto dy = float(y) - centerY;
+    for (int x = x1; x <= x2; x++) {
+      const auto dx = float(x) - centerX;
+      if (dx * dx + dy * dy > radius2) {
+        continue;
+      }
+
+      const auto index = uint32_t(y * fb_width + x);
+      if (!touched[index]) {
+        touched[index] = true;
+        saved.emplace_back(index, mem[index]); // NOLINT
+      }
+      mem[index] = color; // NOLINT
+    }
+  }
+
+  damage.add(x1, y1);
+  damage.add(x2, y2);
+}
+
+void
+StrokeRenderer::drawSegment(uint16_t* mem,
+                            const StrokePoint& from,
+                            const StrokePoint& to,
+                            Bounds& damage) {
+  const auto fromRadius = getRadius(from.pressure);
+  const auto toRadius = getRadius(to.pressure);
+  const auto radius = double(std::max(fromRadius, toRadius));
+
+  const auto x = double(from.x);
+  const auto y = double(from.y);
+  const auto dx = double(to.x) - x;
+  const auto dy = double(to.y) - y;
+
+  // Only step through the part that can touch the framebuffer, the points
+  // are sent by the client and can be arbitrarily far apart.
+  auto t1 = 0.0;
+  auto t2 = 1.0;
+  if (!clipLine(x, dx, -radius, fb_width - 1 + radius, t1, t2) ||
+      !clipLine(y, dy, -radius, fb_height - 1 + radius, t1, t2)) {
+    return;
+  }
+
+  const auto drawAt = [&](double t) {
+    drawDisc(mem,
+             float(x + dx * t),
+             float(y + dy * t),
+             fromRadius + (toRadius - fromRadius) * float(t),
+             damage);
+  };
+
+  // The disc at 'from' was drawn by the previous segment, unless it's clipped.
+  if (t1 > 0) {
+    drawAt(t1);
+  }
+
+  // Stamp discs half their radius apart, close enough to leave no gaps. The
+  // spacing grows with the radius, so wide discs aren't stamped densely.
+  const auto length = std::sqrt(dx * dx + dy * dy);
+  for (auto t = t1; t < t2;) {
+    const auto discRadius = fromRadius + (toRadius - fromRadius) * t;
+    t = std::min(t2, t + std::max(0.5, discRadius / 2) / length);
+    drawAt(t);
+  }
+}
+
+float
+StrokeRenderer::getRadius(uint16_t pressure) const {
+  const auto clamped = std::min<int>(pressure, max_pressure);
+  const auto width =
+    float(params.minWidth) +
+    float(params.maxWidth - params.minWidth) * float(clamped) / max_pressure;
+  return width / 2;
+}
+
+UpdateParams
+StrokeRenderer::makeUpdate(const Bounds& bounds, bool pen) {
+  return UpdateParams{
+    .y1 = bounds.y1,
+    .x1 = bounds.x1,
+    .y2 = bounds.y2,
+    .x2 = bounds.x2,
+    .flags = pen ? pen_flags : 0,
+    .waveform = (pen ? WAVEFORM_MODE_DU : WAVEFORM_MODE_GL16) |
+                UpdateParams::ioctl_waveform_flag,
+    .temperatureOverride = 0,
+    .extraMode = 0,
+  };
+}
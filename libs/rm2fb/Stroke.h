@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Message.h"
+
+#include <optional>
+#include <vector>
+
+struct SharedFB;
+
+/// Rasterises strokes streamed by a client directly into the shared
+/// framebuffer, remembering the original pixels so the stroke can be
+/// cancelled again.
+class StrokeRenderer {
+public:
+  /// Widths are clamped to this, so a client can't make every point cover
+  /// the whole framebuffer.
+  static constexpr uint16_t max_width = 64;
+
+  void begin(const StrokeBegin& params);
+
+  /// Draws the points, connected to the previous points of the stroke.
+  /// \returns The update to send to the display, if any pixels changed.
+  std::optional<UpdateParams> addPoints(const SharedFB& fb,
+                                        const StrokePoints& points);
+
+  /// Ends the stroke, restoring the pixels under it on cancel.
+  /// \returns The update to send to the display, if any pixels changed.
+  std::optional<UpdateParams> end(const SharedFB& fb, const StrokeEnd& msg);
+
+  bool isActive() const { return active; }
+
+private:
+  struct Bounds {
+    int x1 = INT32_MAX;
+    int y1 = INT32_MAX;
+    int x2 = INT32_MIN;
+    int y2 = INT32_MIN;
+
+    void add(int x, int y);
+    bool empty() const { return x1 > x2 || y1 > y2; }
+  };
+
+  void drawDisc(uint16_t* mem,
+                float centerX,
+                float centerY,
+                float radius,
+                Bounds& damage);
+  void drawSegment(uint16_t* mem,
+                   const StrokePoint& from,
+                   const StrokePoint& to,
+                   Bounds& damage);
+  float getRadius(uint16_t pressure) const;
+
+  static UpdateParams makeUpdate(const Bounds& bounds, bool pen);
+
+  StrokeBegin params;
+  uint16_t color = 0;
+  bool active = false;
+
+  std::optional<StrokePoint> lastPoint;
+  Bounds strokeBounds;
+
+  /// Original pixels of the stroke, by framebuffer index.
+  std::vector<std::pair<uint32_t, uint16_t>> saved;
+  /// Marks the pixels stored in \ref saved.
+  std::vector<bool> touched;
+};
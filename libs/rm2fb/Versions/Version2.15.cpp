@@ -56,7 +56,7 @@ struct AddressInfo : public AddressInfoBase {
     // auto* fbMem = static_cast<std::uint8_t*>(fb->getFb());
     // std::vector<std::uint8_t> fbCopy(fbMem, fbMem + fb_size);
 
-    createThreads.call<int, void*>(fb->mem.get());
+    createThreads.call<int, void*>(getScanoutBuffer());
     waitForStart.call<void>();
 
     // std::memcpy(fb->mem.get(), fbCopy.data(), fbCopy.size());
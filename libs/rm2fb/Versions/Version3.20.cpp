@@ -56,10 +56,9 @@ shutdownHook() {
 void*
 mallocHook(void* (*orig)(size_t), size_t size) {
   if (size == 0x503580) {
-    std::cout << "HOOK: malloc redirected to shared FB\n";
-    const auto& fb = unistdpp::fatalOnError(SharedFB::getInstance());
+    std::cout << "HOOK: malloc redirected to scanout buffer\n";
     PreloadHook::getInstance().unhook<PreloadHook::Malloc>();
-    return fb.mem.get();
+    return getScanoutBuffer();
   }
 
   return orig(size);
@@ -29,7 +29,8 @@ struct AddressInfo : public AddressInfoBase {
     : createThreads(createThreads), update(update), shutdownFn(shutdownFn) {}
 
   void initThreads() const final {
-    PreloadHook::getInstance().hook<PreloadHook::QImageCtor>(qimageHook);
+    PreloadHook::getInstance().hook<PreloadHook::QImageCtor>(
+      qimageScanoutHook);
     createThreads.call<void*>();
   }
 
@@ -45,10 +45,9 @@ shutdownHook() {
 void*
 mallocHook(void* (*orig)(size_t), size_t size) {
   if (size == 0x503580) {
-    std::cout << "HOOK: malloc redirected to shared FB\n";
-    const auto& fb = unistdpp::fatalOnError(SharedFB::getInstance());
+    std::cout << "HOOK: malloc redirected to scanout buffer\n";
     PreloadHook::getInstance().unhook<PreloadHook::Malloc>();
-    return fb.mem.get();
+    return getScanoutBuffer();
   }
 
   return orig(size);
@@ -135,10 +134,7 @@ struct AddressInfo : public AddressInfoBase {
 
     ImageInfo info{};
     createThreads.call<void*, ImageInfo*>(&info);
-    assert([&] {
-      const auto& fb = unistdpp::fatalOnError(SharedFB::getInstance());
-      return info.data == fb.mem.get();
-    }() && "Malloc wasn't hooked?");
+    assert(info.data == getScanoutBuffer() && "Malloc wasn't hooked?");
     waitForInit();
   }
 
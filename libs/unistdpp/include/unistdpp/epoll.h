@@ -0,0 +1,33 @@
+#pragma once
+
+#include "unistdpp.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+/// Linux only, epoll and the fds it's usually combined with.
+namespace unistdpp {
+
+constexpr auto epoll_create = FnWrapper<::epoll_create1, Result<FD>(int)>{};
+
+constexpr auto epoll_ctl =
+  FnWrapper<::epoll_ctl, Result<void>(const FD&, int, int, epoll_event*)>{};
+
+constexpr auto epoll_wait =
+  FnWrapper<::epoll_wait, Result<int>(const FD&, epoll_event*, int, int)>{};
+
+constexpr auto timerfd_create =
+  FnWrapper<::timerfd_create, Result<FD>(int, int)>{};
+
+constexpr auto timerfd_settime =
+  FnWrapper<::timerfd_settime,
+            Result<void>(const FD&, int, const itimerspec*, itimerspec*)>{};
+
+constexpr auto eventfd = FnWrapper<::eventfd, Result<FD>(unsigned int, int)>{};
+
+constexpr auto signalfd =
+  FnWrapper<::signalfd, Result<FD>(int, const sigset_t*, int)>{};
+
+} // namespace unistdpp
@@ -8,12 +8,20 @@
 namespace unistdpp {
 
 constexpr auto open = FnWrapper<::open, Result<FD>(const char*, int)>{};
+
+/// \ref open with `O_CREAT`, which takes the mode of the new file.
+constexpr auto create =
+  FnWrapper<::open, Result<FD>(const char*, int, mode_t)>{};
+
 constexpr auto lseek =
   FnWrapper<::lseek, Result<off_t>(const FD&, off_t, int)>{};
 
 constexpr auto read =
   FnWrapper<::read, Result<int>(const FD&, void*, size_t)>{};
 
+constexpr auto write =
+  FnWrapper<::write, Result<int>(const FD&, const void*, size_t)>{};
+
 constexpr auto ftruncate =
   FnWrapper<::ftruncate, Result<void>(const FD&, off_t)>{};
 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "unistdpp.h"
+
+#include <vector>
+
+namespace unistdpp {
+
+/// Buffers reads from a file descriptor, so many small messages can be
+/// read using a single read syscall.
+/// The reader doesn't own the file descriptor, it must outlive the reader.
+class BufferedReader {
+public:
+  static constexpr std::size_t default_capacity = 4096;
+
+  explicit BufferedReader(const FD& fd,
+                          std::size_t capacity = default_capacity)
+    : fd(fd.fd), buffer(capacity) {}
+
+  /// Same semantics as \ref FD::readAll, but only reads from the file
+  /// descriptor when the buffer is empty.
+  [[nodiscard]] Result<int> readAll(void* buf, std::size_t size);
+
+  template<typename T,
+           typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+  [[nodiscard]] Result<T> readAll() {
+    T result{};
+    return readAll(&result, sizeof(T))
+      .and_then([&result](auto size) -> Result<T> {
+        if (size != sizeof(T)) {
+          return tl::unexpected(FD::eof_error);
+        }
+        return std::move(result);
+      });
+  }
+
+  /// \returns The number of bytes that can be read without a syscall.
+  [[nodiscard]] std::size_t buffered() const noexcept { return end - start; }
+
+private:
+  int fd;
+  std::vector<char> buffer;
+  std::size_t start = 0;
+  std::size_t end = 0;
+};
+
+} // namespace unistdpp
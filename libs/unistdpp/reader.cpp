@@ -0,0 +1,45 @@
+#include "unistdpp/reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace unistdpp {
+
+Result<int>
+BufferedReader::readAll(void* buf, std::size_t size) {
+  auto* out = reinterpret_cast<char*>(buf); // NOLINT
+  std::size_t read = 0;
+
+  while (read < size) {
+    if (start == end) {
+      // Reads larger than the buffer don't need to be copied twice.
+      const bool direct = size - read >= buffer.size();
+      auto res = direct ? ::read(fd, out + read, size - read) // NOLINT
+                        : ::read(fd, buffer.data(), buffer.size());
+      if (res == -1) {
+        return tl::unexpected(getErrno());
+      }
+
+      if (res == 0) {
+        break;
+      }
+
+      if (direct) {
+        read += res;
+        continue;
+      }
+
+      start = 0;
+      end = res;
+    }
+
+    const auto count = std::min(end - start, size - read);
+    memcpy(out + read, buffer.data() + start, count); // NOLINT
+    start += count;
+    read += count;
+  }
+
+  return read;
+}
+
+} // namespace unistdpp
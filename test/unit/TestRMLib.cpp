@@ -1,23 +1,46 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers_all.hpp>
 
+#include "TempFiles.h"
 #include "rMLibTestHelper.h"
 
+#include <Dither.h>
+#include <EventLoop.h>
+#include <FontManager.h>
 #include <FrameBuffer.h>
+#include <GlyphCache.h>
+#include <ImageCache.h>
 #include <Input.h>
+#include <Simd.h>
+#include <StrokeRasterizer.h>
+#include <Trace.h>
 
 #include <UI/AppContext.h>
 #include <UI/Button.h>
 #include <UI/DynamicWidget.h>
 #include <UI/Flex.h>
+#include <UI/Gesture.h>
+#include <UI/Keyed.h>
 #include <UI/Layout.h>
+#include <UI/ListView.h>
 #include <UI/Navigator.h>
 #include <UI/StatelessWidget.h>
 #include <UI/Text.h>
+#include <UI/Wrap.h>
+
+#include <unistdpp/file.h>
+#include <unistdpp/pipe.h>
 
 #include <SDL_events.h>
 
+#include <cmath>
+#include <csignal>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <thread>
 
 using namespace rmlib;
 
@@ -56,6 +79,845 @@ TEST_CASE("Init Input", "[rmlib]") {
   REQUIRE(std::holds_alternative<input::PenEvent>(evs->front()));
 }
 
+TEST_CASE("EventRing", "[rmlib]") {
+  input::EventRing ring;
+  REQUIRE(ring.empty());
+
+  for (int i = 0; i < int(input::EventRing::capacity) + 3; i++) {
+    ring.push(input::KeyEvent{ input::KeyEvent::Press, i });
+  }
+
+  // The oldest events are dropped.
+  REQUIRE(ring.full());
+  REQUIRE(ring.dropped() == 3);
+  for (int i = 3; i < int(input::EventRing::capacity) + 3; i++) {
+    REQUIRE(std::get<input::KeyEvent>(ring.pop()).keyCode == i);
+  }
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("EventRing keeps downs and ups", "[rmlib]") {
+  input::EventRing ring;
+
+  const auto touch = [](auto type, int x) {
+    auto ev = input::TouchEvent{};
+    ev.type = type;
+    ev.location = { x, 0 };
+    return ev;
+  };
+
+  // A backlog of moves between a down and an up, more than fit.
+  constexpr int moves = int(input::EventRing::capacity) + 10;
+  ring.push(touch(input::TouchEvent::Down, -1));
+  for (int i = 0; i < moves; i++) {
+    ring.push(touch(input::TouchEvent::Move, i));
+  }
+  ring.push(touch(input::TouchEvent::Up, moves));
+
+  REQUIRE(ring.full());
+  REQUIRE(ring.dropped() == 12);
+
+  // The oldest moves are dropped, the rest stay in order.
+  const auto down = std::get<input::TouchEvent>(ring.pop());
+  REQUIRE(down.isDown());
+  for (int i = 12; i < moves; i++) {
+    const auto move = std::get<input::TouchEvent>(ring.pop());
+    REQUIRE(move.isMove());
+    REQUIRE(move.location.x == i);
+  }
+  const auto up = std::get<input::TouchEvent>(ring.pop());
+  REQUIRE(up.isUp());
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("EventQueue", "[rmlib]") {
+  auto queue = std::make_unique<input::EventQueue>();
+  const auto now = input::EventQueue::Clock::now();
+
+  SECTION("Full") {
+    for (int i = 0; i < int(input::EventQueue::capacity); i++) {
+      REQUIRE(queue->push(input::KeyEvent{ input::KeyEvent::Press, i }, now));
+    }
+
+    // New events are dropped.
+    REQUIRE_FALSE(queue->push(input::KeyEvent{}, now));
+    REQUIRE(queue->dropped() == 1);
+    REQUIRE(queue->size() == input::EventQueue::capacity);
+    REQUIRE(std::get<input::KeyEvent>(queue->pop()->event).keyCode == 0);
+  }
+
+  SECTION("Threads") {
+    constexpr auto count = 100000;
+    std::thread producer([&queue, now] {
+      for (int i = 0; i < count;) {
+        if (queue->push(input::KeyEvent{ input::KeyEvent::Press, i }, now)) {
+          i++;
+        }
+      }
+    });
+
+    // Events arrive complete and in order.
+    int next = 0;
+    while (next < count) {
+      if (auto entry = queue->pop(); entry.has_value()) {
+        REQUIRE(std::get<input::KeyEvent>(entry->event).keyCode == next);
+        REQUIRE(entry->readTime == now);
+        next++;
+      }
+    }
+    producer.join();
+    REQUIRE(queue->empty());
+  }
+}
+
+TEST_CASE("Input recording", "[rmlib]") {
+  using namespace std::chrono_literals;
+  TemporaryDirectory tmp;
+  const auto path = (tmp.dir / "event1.ev").string();
+
+  // Recordings from 32 and 64 bit systems.
+  const auto eventSize = GENERATE(16, 24);
+
+  input::RecordingHeader header;
+  header.kind = input::RecordingHeader::Touch;
+  header.eventSize = eventSize;
+  header.startTime = 10 * 1000000;
+
+  std::string data(sizeof(header), '\0');
+  memcpy(data.data(), &header, sizeof(header));
+  const auto append = [&data](auto value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  const auto addEvent =
+    [&](int64_t sec, int64_t usec, uint16_t type, uint16_t code, int value) {
+      if (eventSize == 16) {
+        append(uint32_t(sec));
+        append(uint32_t(usec));
+      } else {
+        append(sec);
+        append(usec);
+      }
+      append(type);
+      append(code);
+      append(int32_t(value));
+    };
+
+  // Two reports with an absolute position, 0.5s apart.
+  constexpr uint16_t ev_abs = 3;
+  constexpr uint16_t abs_x = 0x35;
+  addEvent(10, 0, ev_abs, abs_x, 100);
+  addEvent(10, 0, 0, 0, 0);
+  addEvent(10, 500000, ev_abs, abs_x, 200);
+  addEvent(10, 500000, 0, 0, 0);
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << data;
+  }
+
+  auto recording = input::readRecording(path);
+  REQUIRE(recording.has_value());
+  REQUIRE(recording->header.kind == input::RecordingHeader::Touch);
+  REQUIRE(recording->events.size() == 4);
+  const auto& event = recording->events[2];
+  REQUIRE(event.sec == 10);
+  REQUIRE(event.usec == 500000);
+  REQUIRE(event.type == ev_abs);
+  REQUIRE(event.code == abs_x);
+  REQUIRE(event.value == 200);
+  REQUIRE(recording->events[3].isReport());
+
+  // Reports are handed out a report at a time, moved to the replay start.
+  const auto start = input::EventClock::time_point(100s);
+  std::vector<std::vector<input::RecordedEvent>> reports;
+  const auto decode = [&reports](const auto* events, size_t count) {
+    reports.emplace_back(events, events + count);
+  };
+  const auto checkReports = [&] {
+    REQUIRE(reports.size() == 2);
+    REQUIRE(reports[0].size() == 2);
+    REQUIRE(reports[0][0].value == 100);
+    REQUIRE(reports[0][0].getTime() == start);
+    REQUIRE(reports[1].size() == 2);
+    REQUIRE(reports[1][0].value == 200);
+    REQUIRE(reports[1][0].getTime() == start + 500ms);
+    REQUIRE(reports[1][1].isReport());
+  };
+
+  SECTION("Fast") {
+    auto replay = input::Replay(*recording, input::ReplaySpeed::Fast, start);
+    replay.next(start, decode);
+    REQUIRE(reports.size() == 1);
+    REQUIRE(!replay.isDone());
+
+    replay.next(start, decode);
+    REQUIRE(replay.isDone());
+    REQUIRE(!replay.getNextTime().has_value());
+    checkReports();
+  }
+
+  SECTION("Real time") {
+    auto replay =
+      input::Replay(*recording, input::ReplaySpeed::RealTime, start);
+    replay.next(start + 100ms, decode);
+    REQUIRE(reports.size() == 1);
+    REQUIRE(replay.getNextTime() == start + 500ms);
+
+    replay.next(start + 500ms, decode);
+    REQUIRE(replay.isDone());
+    checkReports();
+  }
+
+  SECTION("Invalid") {
+    std::ofstream(path) << "garbage";
+    REQUIRE(!input::readRecording(path).has_value());
+  }
+}
+
+TEST_CASE("EventLoop", "[rmlib]") {
+  auto loop = EventLoop::create();
+  REQUIRE(loop.has_value());
+
+  auto pipe = unistdpp::pipe();
+  REQUIRE(pipe.has_value());
+
+  int reads = 0;
+  REQUIRE(loop->addFd(pipe->readPipe.fd, [&] {
+    REQUIRE(pipe->readPipe.readAll<char>().has_value());
+    reads++;
+  }));
+
+  // The registration persists between waits.
+  for (int i = 0; i < 3; i++) {
+    REQUIRE(pipe->writePipe.writeAll('x'));
+    REQUIRE(loop->wait(std::chrono::milliseconds(100)));
+  }
+  REQUIRE(reads == 3);
+
+  int fired = 0;
+  auto handle = loop->addTimer(std::chrono::milliseconds(2), [&] { fired++; });
+  const auto start = std::chrono::steady_clock::now();
+  while (fired == 0 &&
+         std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+    REQUIRE(loop->wait(std::chrono::milliseconds(100)));
+  }
+  REQUIRE(fired == 1);
+  REQUIRE(reads == 3);
+
+  loop->removeFd(pipe->readPipe.fd);
+  REQUIRE(pipe->writePipe.writeAll('x'));
+  REQUIRE(loop->wait(std::chrono::milliseconds(0)));
+  REQUIRE(reads == 3);
+
+  // Signals from any thread are handled by the loop. They aren't blocked,
+  // which child processes would inherit.
+  int signals = 0;
+  REQUIRE(loop->addSignal(SIGUSR1, [&] { signals++; }));
+  std::thread([] { REQUIRE(kill(getpid(), SIGUSR1) == 0); }).join();
+  REQUIRE(loop->wait(std::chrono::milliseconds(100)));
+  REQUIRE(signals == 1);
+
+  sigset_t mask;
+  REQUIRE(pthread_sigmask(SIG_BLOCK, nullptr, &mask) == 0);
+  REQUIRE(sigismember(&mask, SIGUSR1) == 0);
+}
+
+TEST_CASE("GlyphCache", "[rmlib]") {
+  GlyphCache cache(2);
+
+  auto glyphA = cache.get('a', 32, 0);
+  REQUIRE(glyphA->width > 0);
+  REQUIRE(cache.getStats().misses == 1);
+
+  REQUIRE(cache.get('a', 32, 0) == glyphA);
+  REQUIRE(cache.getStats().hits == 1);
+
+  // Size and subpixel offset are part of the key.
+  cache.get('a', 32, 0.5F);
+  REQUIRE(cache.getStats().misses == 2);
+  cache.get('a', 48, 0);
+  REQUIRE(cache.getStats().misses == 3);
+  REQUIRE(cache.getStats().evictions == 1);
+  REQUIRE(cache.size() == 2);
+
+  // The least recently used glyph was evicted.
+  REQUIRE(cache.get('a', 32, 0) != glyphA);
+
+  const auto run = cache.layout("aba", 32);
+  REQUIRE(run.glyphs.size() == 3);
+  REQUIRE(run.glyphs[0].position.x < run.glyphs[1].position.x);
+  REQUIRE(run.glyphs[1].position.x < run.glyphs[2].position.x);
+
+  // Measured runs are cached per text and size.
+  const auto textRun = cache.measure("aba", 32);
+  REQUIRE(textRun->codepoints.size() == 3);
+  REQUIRE(textRun->size.width > 0);
+  REQUIRE(cache.measure("aba", 32) == textRun);
+  REQUIRE(cache.measure("aba", 48) != textRun);
+  REQUIRE(cache.measure("abc", 32)->text == "abc");
+  REQUIRE(cache.getRunStats().hits >= 1);
+}
+
+TEST_CASE("FontManager", "[rmlib]") {
+  FontManager fonts;
+
+  // Missing files are skipped.
+  fonts.addFace(FontStyle::Regular, "/does/not/exist.ttf");
+
+  const auto* regular = fonts.getPrimaryFace(FontStyle::Regular);
+  REQUIRE(regular != nullptr);
+  REQUIRE(fonts.getFace('A') == regular);
+  REQUIRE(fonts.getPrimaryFace(FontStyle::Bold) != nullptr);
+
+  // Without any face for the codepoint, the primary face draws it.
+  REQUIRE(fonts.getFace(0x10FFFF) == regular);
+
+  const auto stats = fonts.getStats();
+  REQUIRE(stats.faces >= 2);
+  REQUIRE(stats.residentBytes <= stats.mappedBytes);
+
+  GlyphCache cache;
+  const auto bold = cache.measure("abc", 32, FontStyle::Bold);
+  REQUIRE(bold->size.width > 0);
+  REQUIRE(cache.measure("abc", 32) != bold);
+}
+
+TEST_CASE("CanvasView", "[rmlib]") {
+  const auto rotation = GENERATE(Rotation::None,
+                                 Rotation::Clockwise,
+                                 Rotation::Inverted,
+                                 Rotation::CounterClockwise);
+
+  MemoryCanvas memCanvas(64, 48, 2);
+  auto canvas = memCanvas.canvas.subCanvas({ { 4, 2 }, { 35, 25 } }, rotation);
+
+  canvas.set(0x1234);
+  canvas.set({ { 2, 3 }, { 12, 9 } }, 0x4321);
+  canvas.transform([](int x, int y, uint16_t pixel) {
+    return uint16_t(pixel + x + (y * 100));
+  });
+
+  // The views must agree with the rotated per pixel access.
+  for (int y = 0; y < canvas.height(); y++) {
+    for (int x = 0; x < canvas.width(); x++) {
+      const auto base = Rect{ { 2, 3 }, { 12, 9 } }.contains(Point{ x, y })
+                          ? 0x4321
+                          : 0x1234;
+      REQUIRE(canvas.getPixel(x, y) == base + x + (y * 100));
+    }
+  }
+
+  canvas.visitRotation<uint16_t>([&](auto view) {
+    REQUIRE(view.getPtr(1, 0) - view.getPtr(0, 0) == view.xStep());
+    REQUIRE(view.getPtr(0, 1) - view.getPtr(0, 0) == view.yStep());
+    REQUIRE(view.getPixel(3, 4) == canvas.getPixel(3, 4));
+  });
+
+  MemoryCanvas copyMem(64, 48, 2);
+  auto copy = copyMem.canvas.subCanvas({ { 4, 2 }, { 35, 25 } }, rotation);
+  copy.copy(canvas);
+  REQUIRE(copyMem.canvas.compare(memCanvas.canvas));
+}
+
+TEST_CASE("Simd", "[rmlib]") {
+  const auto count = GENERATE(1, 8, 15, 16, 37);
+
+  std::vector<uint16_t> pixels(count + 1, 0);
+  simd::fill(pixels.data(), count, 0x1234);
+  REQUIRE(std::count(pixels.begin(), pixels.end(), 0x1234) == count);
+  REQUIRE(pixels.back() == 0);
+
+  auto other = pixels;
+  REQUIRE(simd::compare(pixels.data(), other.data(), count) == size_t(count));
+  other[count - 1] = 0;
+  REQUIRE(simd::compare(pixels.data(), other.data(), count) ==
+          size_t(count - 1));
+
+  std::vector<uint8_t> coverage(count);
+  for (int i = 0; i < count; i++) {
+    coverage[i] = uint8_t(i * 7);
+  }
+  for (const auto [fg, bg] : { std::pair{ 0, 255 }, std::pair{ 200, 17 } }) {
+    simd::blendCoverage(pixels.data(), coverage.data(), count, fg, bg);
+    for (int i = 0; i < count; i++) {
+      const auto grey = bg + (coverage[i] * (fg - bg)) / 255;
+      REQUIRE(pixels[i] == greyToRGB565(grey));
+    }
+  }
+}
+
+TEST_CASE("Rotated copy", "[rmlib]") {
+  const auto srcRotation = GENERATE(Rotation::None,
+                                    Rotation::Clockwise,
+                                    Rotation::Inverted,
+                                    Rotation::CounterClockwise);
+  const auto dstRotation = GENERATE(Rotation::None,
+                                    Rotation::Clockwise,
+                                    Rotation::Inverted,
+                                    Rotation::CounterClockwise);
+
+  // Sizes that aren't a multiple of the 8x8 blocks.
+  const auto size = Size{ 21, 13 };
+
+  MemoryCanvas srcMem(32, 32, 2);
+  auto src = srcMem.canvas.subCanvas(
+    { { 1, 2 }, Point{ 1, 2 } + rotate(srcRotation, size).toPoint() },
+    srcRotation);
+  src.transform(
+    [](int x, int y, uint16_t) { return uint16_t((x * 100) + y + 1); });
+
+  MemoryCanvas dstMem(32, 32, 2);
+  auto dst = dstMem.canvas.subCanvas(
+    { { 3, 4 }, Point{ 3, 4 } + rotate(dstRotation, size).toPoint() },
+    dstRotation);
+  dst.copy(src);
+
+  for (int y = 0; y < size.height; y++) {
+    for (int x = 0; x < size.width; x++) {
+      REQUIRE(dst.getPixel(x, y) == (x * 100) + y + 1);
+    }
+  }
+
+  // Snapshots are unrotated.
+  const auto snapshot = MemoryCanvas(src);
+  REQUIRE(snapshot.canvas.rotation() == Rotation::None);
+  REQUIRE(snapshot.canvas.getPixel(20, 12) == 2013);
+}
+
+TEST_CASE("drawImage", "[rmlib]") {
+  const auto rotation = GENERATE(Rotation::None,
+                                 Rotation::Clockwise,
+                                 Rotation::Inverted,
+                                 Rotation::CounterClockwise);
+
+  MemoryCanvas image(10, 6, 2);
+  image.canvas.transform(
+    [](int x, int y, uint16_t) { return uint16_t((x * 100) + y + 1); });
+
+  MemoryCanvas memCanvas(16, 16, 2);
+  auto canvas = memCanvas.canvas.subCanvas({ { 2, 2 }, { 13, 9 } }, rotation);
+  canvas.set(0);
+
+  // Clipped at the left and bottom.
+  const auto location = Point{ -3, rotation == Rotation::None ||
+                                       rotation == Rotation::Inverted
+                                     ? 4
+                                     : 8 };
+  canvas.drawImage(image.canvas, location);
+
+  for (int y = 0; y < canvas.height(); y++) {
+    for (int x = 0; x < canvas.width(); x++) {
+      const auto p = Point{ x, y } - location;
+      const auto expected =
+        image.canvas.rect().contains(p) ? image.canvas.getPixel(p.x, p.y) : 0;
+      REQUIRE(canvas.getPixel(x, y) == expected);
+    }
+  }
+
+  // Fully outside.
+  canvas.drawImage(image.canvas, { 100, 0 });
+}
+
+namespace {
+/// Distance to the discs swept from `a` to `b`, sampled along the segment.
+float
+sweptDistance(StrokePoint a, StrokePoint b, float x, float y) {
+  constexpr auto samples = 1000;
+  auto result = std::numeric_limits<float>::max();
+  for (int i = 0; i <= samples; i++) {
+    const auto t = float(i) / samples;
+    const auto cx = a.x + t * (b.x - a.x);
+    const auto cy = a.y + t * (b.y - a.y);
+    const auto r = (a.width + t * (b.width - a.width)) / 2;
+    result = std::min(result, std::hypot(x - cx, y - cy) - r);
+  }
+  return result;
+}
+
+/// A few seconds of handwriting, sampled at 200 Hz like the pen.
+std::vector<StrokePoint>
+penTrace() {
+  constexpr auto pi = 3.14159265F;
+  std::vector<StrokePoint> result;
+  for (int i = 0; i < 1000; i++) {
+    const auto t = float(i) / 200;
+    result.push_back({ 100 + (200 * t) + (40 * std::sin(2 * pi * 3 * t)),
+                       300 + (60 * std::cos(2 * pi * 3 * t)),
+                       4 + (2 * std::sin(2 * pi * t)) });
+  }
+  return result;
+}
+} // namespace
+
+TEST_CASE("Stroke", "[rmlib]") {
+  const auto rotation = GENERATE(Rotation::None, Rotation::Clockwise);
+  const auto antiAlias = GENERATE(true, false);
+
+  const auto [from, to] = GENERATE(
+    std::pair{ StrokePoint{ 5.3F, 6.1F, 3 }, StrokePoint{ 25.7F, 18.2F, 9 } },
+    std::pair{ StrokePoint{ 20, 4, 6 }, StrokePoint{ 20, 4, 6 } },
+    std::pair{ StrokePoint{ 10, 10, 16 }, StrokePoint{ 12, 11, 2 } },
+    std::pair{ StrokePoint{ -4, 12, 1 }, StrokePoint{ 40, 13.5F, 0.5F } });
+
+  MemoryCanvas memCanvas(32, 32, 2);
+  auto canvas = memCanvas.canvas.subCanvas(memCanvas.canvas.rect(), rotation);
+  canvas.set(white);
+
+  StrokeRasterizer stroke(0, antiAlias);
+  const auto dirty = stroke.drawSegment(canvas, from, to);
+
+  // Skip pixels too close to the edge for the sampled distance.
+  constexpr auto epsilon = 0.05F;
+  const auto edge = antiAlias ? 0.5F : 0.0F;
+
+  Rect changed;
+  for (int y = 0; y < canvas.height(); y++) {
+    for (int x = 0; x < canvas.width(); x++) {
+      const auto pixel = canvas.getPixel(x, y);
+      if (pixel != white) {
+        changed |= Rect{ { x, y }, { x, y } };
+      }
+
+      const auto distance = sweptDistance(from, to, float(x), float(y));
+      if (distance < -edge - epsilon) {
+        REQUIRE(pixel == black);
+      } else if (distance > edge + epsilon) {
+        REQUIRE(pixel == white);
+      }
+    }
+  }
+
+  REQUIRE(!changed.empty());
+  REQUIRE(dirty.topLeft == changed.topLeft);
+  REQUIRE(dirty.bottomRight == changed.bottomRight);
+}
+
+TEST_CASE("Stroke joints", "[rmlib]") {
+  // A stroke of several segments along a line looks like a single segment,
+  // the joints aren't blended twice.
+  MemoryCanvas memCanvas(64, 32, 2);
+  auto& canvas = memCanvas.canvas;
+  MemoryCanvas expectedCanvas(64, 32, 2);
+  auto& expected = expectedCanvas.canvas;
+  canvas.set(white);
+  expected.set(white);
+
+  StrokeRasterizer stroke;
+  for (const auto x : { 10.0F, 23.5F, 30.0F, 50.0F }) {
+    stroke.addPoint(canvas, StrokePoint{ x, 16.2F, 4.5F });
+  }
+  StrokeRasterizer(0).drawSegment(
+    expected, StrokePoint{ 10, 16.2F, 4.5F }, StrokePoint{ 50, 16.2F, 4.5F });
+
+  // Blending the coverage in two steps rounds twice.
+  constexpr auto tolerance = 8;
+  for (int y = 0; y < canvas.height(); y++) {
+    for (int x = 0; x < canvas.width(); x++) {
+      const auto grey = int(greyFromRGB565(canvas.getPixel(x, y)));
+      const auto expectedGrey = int(greyFromRGB565(expected.getPixel(x, y)));
+      INFO(x << ", " << y);
+      REQUIRE(std::abs(grey - expectedGrey) <= tolerance);
+    }
+  }
+}
+
+TEST_CASE("drawDisk", "[rmlib]") {
+  MemoryCanvas memCanvas(32, 32, 2);
+  memCanvas.canvas.set(white);
+
+  // Clipped at the top.
+  const auto center = Point{ 14, 3 };
+  const auto radius = 7;
+  memCanvas.canvas.drawDisk(center, radius, black);
+
+  for (int y = 0; y < 32; y++) {
+    for (int x = 0; x < 32; x++) {
+      const auto dx = x - center.x;
+      const auto dy = y - center.y;
+      const auto inside = dx >= -radius && dx < radius && dy >= -radius &&
+                          dy < radius && dx * dx + dy * dy < radius * radius;
+      REQUIRE(memCanvas.canvas.getPixel(x, y) == (inside ? black : white));
+    }
+  }
+}
+
+TEST_CASE("Dither", "[rmlib]") {
+  const auto mode = GENERATE(
+    DitherMode::None, DitherMode::Ordered, DitherMode::ErrorDiffusion);
+  const auto bits = GENERATE(1, 4);
+  const auto step = 255 / ((1 << bits) - 1);
+
+  MemoryCanvas memCanvas(37, 21, 2);
+  auto& canvas = memCanvas.canvas;
+  canvas.transform([](int x, int y, uint16_t) {
+    return greyToRGB565(uint8_t((x * 255) / 36));
+  });
+
+  dither(canvas, { bits, mode });
+
+  canvas.forEach([&](int x, int y, uint16_t pixel) {
+    const auto grey = greyFromRGB565(pixel);
+    REQUIRE(pixel == greyToRGB565(grey));
+
+    // Only the 6 green bits of the level are kept.
+    const auto level = (grey + (step / 2)) / step;
+    REQUIRE(grey == ((level * step) & ~3));
+    REQUIRE(std::abs(grey - ((x * 255) / 36)) <= step + 3);
+  });
+
+  // Quantised images don't change.
+  const auto before = MemoryCanvas(canvas);
+  dither(canvas, { bits, mode });
+  REQUIRE(canvas.compare(before.canvas));
+}
+
+TEST_CASE("Dither ordered", "[rmlib]") {
+  MemoryCanvas memCanvas(16, 8, 2);
+  memCanvas.canvas.set(greyToRGB565(128));
+
+  dither(memCanvas.canvas, { 1, DitherMode::Ordered });
+
+  int whites = 0;
+  memCanvas.canvas.forEach([&](int, int, uint16_t pixel) {
+    REQUIRE((pixel == white || pixel == black));
+    whites += pixel == white ? 1 : 0;
+  });
+  // About half, 128 is slightly brighter than the middle.
+  REQUIRE(whites >= 64);
+  REQUIRE(whites <= 68);
+}
+
+TEST_CASE("LruCache", "[rmlib]") {
+  LruCache<int, int, std::hash<int>> cache(10);
+
+  cache.insert(1, 1, 4);
+  cache.insert(2, 2, 4);
+  REQUIRE(cache.cost() == 8);
+
+  // Evicts the least recently used entry until the cost fits.
+  REQUIRE(cache.find(1) != nullptr);
+  cache.insert(3, 3, 4);
+  REQUIRE(cache.cost() == 8);
+  REQUIRE(cache.find(2) == nullptr);
+  REQUIRE(cache.find(1) != nullptr);
+  REQUIRE(cache.getStats().evictions == 1);
+
+  // Replacing updates the cost.
+  cache.insert(1, 10, 1);
+  REQUIRE(cache.cost() == 5);
+  REQUIRE(*cache.find(1) == 10);
+}
+
+TEST_CASE("ImageCache", "[rmlib]") {
+  TemporaryDirectory tmp;
+  const auto imagePath = tmp.dir / "image.png";
+  const auto cacheDir = tmp.dir / "cache";
+
+  MemoryCanvas image(64, 32, 2);
+  image.canvas.transform(
+    [](int x, int, uint16_t) { return greyToRGB565(x < 32 ? 0 : 255); });
+  REQUIRE(image.canvas.writeImage(imagePath.c_str()).has_value());
+
+  SECTION("Raw images") {
+    const auto rawPath = tmp.dir / "image.raw";
+    REQUIRE(image.canvas.writeRaw(rawPath.c_str()).has_value());
+
+    auto mapped = ImageCanvas::mapRaw(rawPath.c_str());
+    REQUIRE(mapped.has_value());
+    REQUIRE(mapped->canvas.size() == image.canvas.size());
+    REQUIRE(mapped->canvas.compare(image.canvas));
+
+    REQUIRE_FALSE(ImageCanvas::mapRaw(imagePath.c_str()).has_value());
+
+    // Sizes that overflow 32 bits are rejected, the header is read from the
+    // file that was just written.
+    const auto writeHeader = [&rawPath](int32_t width,
+                                        int32_t height,
+                                        int32_t components) {
+      std::fstream file(rawPath, std::ios::binary | std::ios::in |
+                                   std::ios::out);
+      file.seekp(4);
+      for (const auto value : { width, height, components }) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+    };
+    writeHeader(65536, 65536, 1);
+    REQUIRE_FALSE(ImageCanvas::mapRaw(rawPath.c_str()).has_value());
+    writeHeader(64, 32, 1 << 30);
+    REQUIRE_FALSE(ImageCanvas::mapRaw(rawPath.c_str()).has_value());
+    writeHeader(64, 32, 2);
+    REQUIRE(ImageCanvas::mapRaw(rawPath.c_str()).has_value());
+  }
+
+  SECTION("Scaled and cached") {
+    ImageCache cache(cacheDir);
+
+    auto icon = cache.get(imagePath, { 16, 16 });
+    REQUIRE(icon != nullptr);
+    REQUIRE(icon->size() == Size{ 16, 8 });
+    REQUIRE(icon->getPixel(0, 0) == black);
+    REQUIRE(icon->getPixel(15, 7) == white);
+    REQUIRE(cache.memoryUsage() == size_t(16 * 8 * 2));
+
+    // In memory.
+    REQUIRE(cache.get(imagePath, { 16, 16 }) == icon);
+    REQUIRE(cache.getStats().hits == 1);
+
+    // On disk, for a new process.
+    REQUIRE(std::distance(std::filesystem::directory_iterator(cacheDir),
+                          std::filesystem::directory_iterator()) == 1);
+    ImageCache otherCache(cacheDir);
+    auto mapped = otherCache.get(imagePath, { 16, 16 });
+    REQUIRE(mapped != nullptr);
+    REQUIRE(mapped->compare(*icon));
+
+    // Evicted images stay valid while in use.
+    ImageCache smallCache(cacheDir, 16 * 8 * 2);
+    auto first = smallCache.get(imagePath, { 16, 16 });
+    auto second = smallCache.get(imagePath, { 32, 32 });
+    REQUIRE(smallCache.getStats().evictions == 1);
+    REQUIRE(first->compare(*icon));
+  }
+
+  SECTION("Stale versions") {
+    const auto countFiles = [&cacheDir] {
+      return std::distance(std::filesystem::directory_iterator(cacheDir),
+                           std::filesystem::directory_iterator());
+    };
+
+    ImageCache cache(cacheDir);
+    REQUIRE(cache.get(imagePath, { 16, 16 }) != nullptr);
+    REQUIRE(cache.get(imagePath, { 32, 32 }) != nullptr);
+    REQUIRE(countFiles() == 2);
+
+    // A new version replaces the files of all sizes of the old one.
+    image.canvas.set(black);
+    REQUIRE(image.canvas.writeImage(imagePath.c_str()).has_value());
+    std::filesystem::last_write_time(
+      imagePath,
+      std::filesystem::last_write_time(imagePath) + std::chrono::seconds(1));
+
+    auto icon = ImageCache(cacheDir).get(imagePath, { 16, 16 });
+    REQUIRE(icon != nullptr);
+    REQUIRE(icon->getPixel(15, 7) == black);
+    REQUIRE(countFiles() == 1);
+  }
+
+  REQUIRE(ImageCache(cacheDir).get(tmp.dir / "missing.png", { 8, 8 }) ==
+          nullptr);
+}
+
+TEST_CASE("CanvasView benchmark", "[rmlib][.benchmark]") {
+  MemoryCanvas memCanvas(1404, 1872, 2);
+  auto canvas =
+    memCanvas.canvas.subCanvas(memCanvas.canvas.rect(), Rotation::Clockwise);
+
+  BENCHMARK("setPixel") {
+    for (int y = 0; y < canvas.height(); y++) {
+      for (int x = 0; x < canvas.width(); x++) {
+        canvas.setPixel({ x, y }, x ^ y);
+      }
+    }
+    return canvas.getPixel(0, 0);
+  };
+
+  BENCHMARK("transform") {
+    canvas.transform([](int x, int y, uint16_t) { return uint16_t(x ^ y); });
+    return canvas.getPixel(0, 0);
+  };
+
+  BENCHMARK("set") {
+    canvas.set(white);
+    return canvas.getPixel(0, 0);
+  };
+
+  BENCHMARK("set unrotated") {
+    memCanvas.canvas.set(white);
+    return memCanvas.canvas.getPixel(0, 0);
+  };
+
+  MemoryCanvas dstMem(1872, 1404, 2);
+  BENCHMARK("rotated copy") {
+    dstMem.canvas.copy(canvas);
+    return dstMem.canvas.getPixel(0, 0);
+  };
+
+  MemoryCanvas image(512, 512, 2);
+  BENCHMARK("rotated drawImage") {
+    canvas.drawImage(image.canvas, { 100, 100 });
+    return canvas.getPixel(100, 100);
+  };
+}
+
+TEST_CASE("Stroke benchmark", "[rmlib][.benchmark]") {
+  MemoryCanvas memCanvas(1404, 1872, 2);
+  auto canvas =
+    memCanvas.canvas.subCanvas(memCanvas.canvas.rect(), Rotation::Clockwise);
+  const auto trace = penTrace();
+
+  // The pen reports at 200 Hz, so a segment has 5 ms.
+  BENCHMARK("pen trace") {
+    StrokeRasterizer stroke;
+    Rect dirty;
+    for (const auto& point : trace) {
+      dirty |= stroke.addPoint(canvas, point);
+    }
+    return dirty;
+  };
+
+  BENCHMARK("pen trace, aliased") {
+    StrokeRasterizer stroke(0, /* antiAlias */ false);
+    Rect dirty;
+    for (const auto& point : trace) {
+      dirty |= stroke.addPoint(canvas, point);
+    }
+    return dirty;
+  };
+
+  BENCHMARK("pen trace, drawLine") {
+    for (size_t i = 1; i < trace.size(); i++) {
+      const auto from = Point{ int(trace[i - 1].x), int(trace[i - 1].y) };
+      const auto to = Point{ int(trace[i].x), int(trace[i].y) };
+      canvas.drawLine(from, to, black, int(trace[i].width));
+    }
+    return canvas.getPixel(0, 0);
+  };
+}
+
+TEST_CASE("UpdateRegion", "[rmlib][ui]") {
+  const auto topLeft = Rect{ { 0, 0 }, { 9, 9 } };
+  const auto bottomRight = Rect{ { 1000, 1000 }, { 1009, 1009 } };
+
+  // Distant rects stay separate.
+  auto region = UpdateRegion{ topLeft, fb::Waveform::DU };
+  region |= UpdateRegion{ bottomRight, fb::Waveform::DU };
+  REQUIRE(region.size() == 2);
+  REQUIRE(region.bounds().bottomRight == bottomRight.bottomRight);
+
+  // Close rects with the same waveform are merged.
+  region |= UpdateRegion{ Rect{ { 12, 0 }, { 21, 9 } }, fb::Waveform::DU };
+  REQUIRE(region.size() == 2);
+
+  // Overlapping rects are always merged, using the worst waveform.
+  region |= UpdateRegion{ Rect{ { 5, 5 }, { 14, 14 } }, fb::Waveform::GC16 };
+  REQUIRE(region.size() == 2);
+  const auto merged = std::find_if(region.begin(), region.end(), [](auto& r) {
+    return r.region.contains(Point{ 0, 0 });
+  });
+  REQUIRE(merged != region.end());
+  REQUIRE(merged->waveform == fb::Waveform::GC16);
+  REQUIRE(merged->region.bottomRight == Point{ 21, 14 });
+
+  // Never more than max_rects.
+  for (int i = 1; i < 20; i++) {
+    const auto pos = Point{ i * 200, i * 200 };
+    region |= UpdateRegion{ Rect{ pos, pos + Point{ 1, 1 } } };
+  }
+  REQUIRE(region.size() == UpdateRegion::max_rects);
+
+  region += Point{ 10, 10 };
+  REQUIRE(region.bounds().topLeft == Point{ 10, 10 });
+}
+
 TEST_CASE("Text", "[rmlib][ui]") {
   auto ctx = TestContext::make();
 
@@ -224,6 +1086,408 @@ TEST_CASE("Button", "[rmlib][ui]") {
   REQUIRE(clicked == 2);
 }
 
+TEST_CASE("MovePolicy", "[rmlib][ui]") {
+  const auto start = input::EventClock::time_point(std::chrono::seconds(1));
+  const auto touch = [start](auto type, int x, int ms) {
+    input::TouchEvent ev;
+    ev.type = type;
+    ev.id = 1;
+    ev.location = { x, 10 };
+    ev.time = start + std::chrono::milliseconds(ms);
+    return ev;
+  };
+
+  const auto policy = GENERATE(
+    MovePolicy::Each, MovePolicy::Coalesce, MovePolicy::Resample);
+
+  std::vector<int> moves;
+  std::vector<size_t> historySizes;
+  RenderObject* ro = nullptr;
+  const auto widget = GestureDetector(Sized(Text(""), 100, 100),
+                                      Gestures().onTouchMove(
+                                        [&](Point pos) {
+                                          moves.push_back(pos.x);
+                                          historySizes.push_back(
+                                            ro->getMoveHistory().size());
+                                        },
+                                        policy));
+  auto renderObject = widget.createRenderObject();
+  ro = renderObject.get();
+  ro->layout(Constraints{ { 0, 0 }, { 100, 100 } });
+
+  ro->handleInput(touch(input::TouchEvent::Down, 10, 0));
+  ro->handleInput(touch(input::TouchEvent::Move, 20, 2));
+  ro->handleInput(touch(input::TouchEvent::Move, 30, 4));
+  ro->handleInput(touch(input::TouchEvent::Move, 40, 6));
+  RenderObject::handlePendingMoves(start + std::chrono::milliseconds(8));
+
+  switch (policy) {
+    case MovePolicy::Each:
+      REQUIRE(moves == std::vector{ 20, 30, 40 });
+      REQUIRE(historySizes == std::vector<size_t>{ 0, 0, 0 });
+      break;
+    case MovePolicy::Coalesce:
+      REQUIRE(moves == std::vector{ 40 });
+      REQUIRE(historySizes == std::vector<size_t>{ 3 });
+      break;
+    case MovePolicy::Resample:
+      // Halfway between the moves at 2 and 4 ms, the later ones are kept.
+      REQUIRE(moves == std::vector{ 25 });
+      REQUIRE(historySizes == std::vector<size_t>{ 1 });
+      REQUIRE(RenderObject::hasPendingMoves());
+      break;
+  }
+
+  // The pointer stopped, the next frame has its last position.
+  RenderObject::handlePendingMoves(start + std::chrono::milliseconds(16));
+  REQUIRE(!RenderObject::hasPendingMoves());
+  REQUIRE(moves.back() == 40);
+  if (policy == MovePolicy::Resample) {
+    REQUIRE(moves == std::vector{ 25, 40 });
+    REQUIRE(historySizes == std::vector<size_t>{ 1, 2 });
+  }
+
+  // Moves are handled before the up of the same pointer.
+  moves.clear();
+  ro->handleInput(touch(input::TouchEvent::Move, 50, 10));
+  ro->handleInput(touch(input::TouchEvent::Up, 50, 12));
+  REQUIRE(moves == std::vector{ 50 });
+
+  RenderObject::handlePendingMoves(start + std::chrono::milliseconds(24));
+  REQUIRE(moves == std::vector{ 50 });
+}
+
+TEST_CASE("Trace", "[rmlib][ui]") {
+  TemporaryDirectory tmp;
+  const auto path = tmp.dir / "trace.json";
+  REQUIRE(trace::start(path.c_str()).has_value());
+
+  REQUIRE(type_id::typeId<Text>().name() == std::string_view("rmlib::Text"));
+
+  const auto widget = Column(Text("a"), Text("b"));
+  auto ro = widget.createRenderObject();
+  MemoryCanvas canvas(100, 100, 2);
+
+  const auto frame = [&] {
+    {
+      const auto scope = trace::Scope("layout");
+      ro->layout(Constraints{ { 0, 0 }, { 100, 100 } });
+    }
+    {
+      const auto scope = trace::Scope("draw");
+      ro->draw(canvas.canvas, { 0, 0 });
+    }
+    ro->reset();
+    return trace::endFrame();
+  };
+
+  // The column is the root of all work at first.
+  auto summary = frame();
+  INFO(summary);
+  REQUIRE_THAT(summary,
+               Catch::Matchers::ContainsSubstring("layout rmlib::Flex<") &&
+                 Catch::Matchers::ContainsSubstring("draw rmlib::Flex<") &&
+                 Catch::Matchers::ContainsSubstring("(full, 2 below)") &&
+                 !Catch::Matchers::ContainsSubstring("draw rmlib::Text#"));
+
+  // Nothing to do.
+  REQUIRE(frame().empty());
+
+  // Only the text is a root, the column draws because of it.
+  ro->childAt(1).markNeedsDraw();
+  summary = frame();
+  INFO(summary);
+  REQUIRE_THAT(summary,
+               Catch::Matchers::ContainsSubstring("draw rmlib::Text#") &&
+                 !Catch::Matchers::ContainsSubstring("rmlib::Flex"));
+
+  trace::stop();
+  const auto json = unistdpp::readFile(path);
+  REQUIRE(json.has_value());
+  REQUIRE_THAT(*json,
+               Catch::Matchers::StartsWith("[\n") &&
+                 Catch::Matchers::ContainsSubstring(
+                   R"("name":"rmlib::Text","cat":"draw","ph":"X")"));
+}
+
+TEST_CASE("Relayout boundary", "[rmlib][ui]") {
+  const auto widget =
+    Column(Row(Text("a"), Text("b")), Sized(Text("c"), 50, 20));
+  auto ro = widget.createRenderObject();
+
+  const auto frame = [&] {
+    RenderObject::resetLayoutCount();
+    ro->layout(Constraints{ { 0, 0 }, { 100, 100 } });
+    ro->reset();
+    return RenderObject::getLayoutCount();
+  };
+
+  REQUIRE(frame() == 6);
+  REQUIRE(frame() == 0);
+
+  auto& row = ro->childAt(0);
+  auto& sized = ro->childAt(1);
+
+  SECTION("Unchanged size") {
+    row.childAt(0).markNeedsLayout();
+    REQUIRE(frame() == 1);
+  }
+
+  SECTION("Tight constraints") {
+    const auto text = Text("longer text");
+    text.update(sized.childAt(0));
+    REQUIRE(frame() == 1);
+    REQUIRE(sized.getSize() == Size{ 50, 20 });
+  }
+
+  SECTION("Changed size") {
+    const auto size = row.getSize();
+    const auto text = Text("longer text");
+    text.update(row.childAt(0));
+
+    // The text, row and column, but not the siblings.
+    REQUIRE(frame() == 3);
+    REQUIRE(row.getSize().width > size.width);
+    REQUIRE(frame() == 0);
+  }
+
+  SECTION("Marked parent") {
+    row.markNeedsLayout();
+    REQUIRE(frame() == 1);
+  }
+}
+
+TEST_CASE("Keyed", "[rmlib][ui]") {
+  const auto makeWrap = [](const std::vector<std::string>& texts) {
+    std::vector<Keyed<Text>> children;
+    for (const auto& text : texts) {
+      children.emplace_back(text, Text(text));
+    }
+    return Wrap(children);
+  };
+
+  const auto constraints = Constraints{ { 200, 100 }, { 200, 100 } };
+  const auto frame = [&](RenderObject& ro, Canvas& canvas) {
+    ro.layout(constraints);
+    ro.cleanup(canvas);
+    ro.draw(canvas, { 0, 0 });
+    ro.reset();
+  };
+
+  MemoryCanvas canvas(200, 100, 2);
+  canvas.canvas.set(white);
+
+  const auto widget = makeWrap({ "b", "c", "d" });
+  auto ro = widget.createRenderObject();
+  frame(*ro, canvas.canvas);
+
+  auto* b = &ro->childAt(0);
+  auto* c = &ro->childAt(1);
+
+  const auto check = [&](const auto& newWidget) {
+    newWidget.update(*ro);
+    ro->layout(constraints);
+    REQUIRE(!b->needsDraw());
+    REQUIRE(!c->needsDraw());
+    ro->reset();
+    frame(*ro, canvas.canvas);
+
+    // Moved children are copied to the same place they'd be drawn.
+    MemoryCanvas expected(200, 100, 2);
+    expected.canvas.set(white);
+    auto expectedRo = newWidget.createRenderObject();
+    frame(*expectedRo, expected.canvas);
+    REQUIRE(canvas.canvas.compare(expected.canvas));
+  };
+
+  SECTION("Insert") {
+    const auto newWidget = makeWrap({ "a", "b", "c", "d" });
+    check(newWidget);
+    REQUIRE(&ro->childAt(1) == b);
+    REQUIRE(&ro->childAt(2) == c);
+  }
+
+  SECTION("Remove") {
+    const auto newWidget = makeWrap({ "c", "b" });
+    check(newWidget);
+    REQUIRE(&ro->childAt(0) == c);
+    REQUIRE(&ro->childAt(1) == b);
+  }
+}
+
+TEST_CASE("Keyed move and modify", "[rmlib][ui]") {
+  // Groups of a key and a value text, keyed by the key.
+  using Group = Wrap<Text>;
+  using Groups = std::vector<std::pair<std::string, std::string>>;
+  const auto makeWrap = [](const Groups& groups) {
+    std::vector<Keyed<Group>> children;
+    for (const auto& [key, value] : groups) {
+      children.emplace_back(key, Group({ Text(key), Text(value) }));
+    }
+    return Wrap(children);
+  };
+
+  const auto constraints = Constraints{ { 200, 100 }, { 200, 100 } };
+  const auto frame = [&](RenderObject& ro, Canvas& canvas) {
+    ro.layout(constraints);
+    ro.cleanup(canvas);
+    ro.draw(canvas, { 0, 0 });
+    ro.reset();
+  };
+
+  MemoryCanvas canvas(200, 100, 2);
+  canvas.canvas.set(white);
+
+  const auto widget = makeWrap({ { "b", "1" }, { "c", "2" } });
+  auto ro = widget.createRenderObject();
+  frame(*ro, canvas.canvas);
+  auto* c = &ro->childAt(1);
+
+  // 'c' moves and only its value is drawn again, its key must be kept.
+  const auto newWidget = makeWrap({ { "a", "0" }, { "b", "1" }, { "c", "3" } });
+  newWidget.update(*ro);
+  frame(*ro, canvas.canvas);
+  REQUIRE(&ro->childAt(2) == c);
+
+  MemoryCanvas expected(200, 100, 2);
+  expected.canvas.set(white);
+  auto expectedRo = newWidget.createRenderObject();
+  frame(*expectedRo, expected.canvas);
+  REQUIRE(canvas.canvas.compare(expected.canvas));
+}
+
+TEST_CASE("ListView", "[rmlib][ui]") {
+  std::vector<int> built;
+  const auto builder = [&built](int index) -> DynamicWidget {
+    built.push_back(index);
+    return Text(std::to_string(index));
+  };
+
+  MemoryCanvas canvas(200, 200, 2);
+  const auto frame = [&](RenderObject& ro) {
+    ro.layout(Constraints{ { 0, 0 }, { 200, 200 } });
+    ro.cleanup(canvas.canvas);
+    ro.draw(canvas.canvas, { 0, 0 });
+    ro.reset();
+  };
+
+  SECTION("Pages") {
+    const auto widget = ListView(100, builder, 40);
+    auto ro = widget.createRenderObject();
+    auto& list = static_cast<PagedRenderObject<ListView>&>(*ro);
+
+    frame(*ro);
+    REQUIRE(built == std::vector{ 0, 1, 2, 3, 4 });
+    REQUIRE(ro->childCount() == 5);
+    REQUIRE(list.getPageCount() == 20);
+    auto* first = &ro->childAt(0);
+
+    list.setPage(1);
+    frame(*ro);
+    REQUIRE(built.size() == 10);
+    REQUIRE(built.back() == 9);
+
+    // The render objects of the first page are reused.
+    list.setPage(2);
+    frame(*ro);
+    REQUIRE(built.size() == 15);
+    REQUIRE(&ro->childAt(0) == first);
+
+    // The previous page is cached.
+    list.setPage(1);
+    frame(*ro);
+    REQUIRE(built.size() == 15);
+  }
+
+  SECTION("Swipe") {
+    const auto widget = ListView(100, builder, 40);
+    auto ro = widget.createRenderObject();
+    auto& list = static_cast<PagedRenderObject<ListView>&>(*ro);
+    frame(*ro);
+
+    const auto touch = [&](auto type, Point location) {
+      auto ev = input::TouchEvent{};
+      ev.type = type;
+      ev.id = 1;
+      ev.location = location;
+      ro->handleInput(ev);
+    };
+
+    touch(input::TouchEvent::Down, { 100, 180 });
+    touch(input::TouchEvent::Up, { 100, 20 });
+    REQUIRE(list.getPage() == 1);
+
+    // Too short.
+    touch(input::TouchEvent::Down, { 100, 20 });
+    touch(input::TouchEvent::Up, { 100, 60 });
+    REQUIRE(list.getPage() == 1);
+
+    touch(input::TouchEvent::Down, { 100, 20 });
+    touch(input::TouchEvent::Up, { 100, 180 });
+    REQUIRE(list.getPage() == 0);
+  }
+
+  SECTION("Grid") {
+    const auto widget = GridView(10, builder, { 60, 60 });
+    auto ro = widget.createRenderObject();
+    auto& grid = static_cast<PagedRenderObject<GridView>&>(*ro);
+
+    frame(*ro);
+    REQUIRE(ro->childCount() == 9);
+    REQUIRE(grid.getPageCount() == 2);
+
+    grid.setPage(1);
+    frame(*ro);
+    REQUIRE(ro->childCount() == 1);
+    REQUIRE(built.back() == 9);
+  }
+}
+
+TEST_CASE("Allocator", "[rmlib][ui]") {
+  SECTION("Arena") {
+    Arena arena(64);
+    auto* a = arena.allocate(40, 8);
+    auto* b = arena.allocate(40, 16);
+    REQUIRE(a != b);
+    REQUIRE(reinterpret_cast<uintptr_t>(b) % 16 == 0);
+    const auto capacity = arena.capacity();
+
+    // The blocks are reused after a reset.
+    arena.reset();
+    REQUIRE(arena.allocate(40, 8) == a);
+    REQUIRE(arena.allocate(40, 16) == b);
+    REQUIRE(arena.capacity() == capacity);
+  }
+
+  SECTION("DynamicWidget") {
+    Arena arena;
+    {
+      const auto scope = Arena::Scope(arena);
+      const auto widget = DynamicWidget(Text("a"));
+    }
+    REQUIRE(arena.capacity() != 0);
+    REQUIRE(Arena::getCurrent() == nullptr);
+  }
+
+  SECTION("Pool") {
+    const auto widget = Column(Text("a"), Text("b"));
+    auto ro = widget.createRenderObject();
+    const auto stats = Pool::getStats();
+
+    size_t count = 0;
+    ro->visitChildren([&count](RenderObject& /*child*/) { count++; });
+    REQUIRE(count == 2);
+
+    // Recreating the tree reuses the memory.
+    for (int i = 0; i < 10; i++) {
+      ro = nullptr;
+      ro = widget.createRenderObject();
+    }
+    REQUIRE(Pool::getStats().slabs == stats.slabs);
+    REQUIRE(Pool::getStats().live == stats.live);
+  }
+}
+
 class CounterTest : public StatefulWidget<CounterTest> {
 public:
   class State : public StateBase<CounterTest> {
@@ -0,0 +1,467 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "Compositor.h"
+#include "Rfb.h"
+#include "SharedBuffer.h"
+#include "Stroke.h"
+
+#include <unistdpp/file.h>
+#include <unistdpp/reader.h>
+
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+SharedFB
+makeSharedFB() {
+  const auto name = "/rm2fb-unit-test." + std::to_string(getpid());
+  auto fb = SharedFB::open(name.c_str(), fb_size);
+  REQUIRE(fb.has_value());
+  shm_unlink(name.c_str());
+  return std::move(*fb);
+}
+
+uint16_t
+pixelAt(const SharedFB& fb, int x, int y) {
+  return static_cast<const uint16_t*>(fb.getFb())[y * fb_width + x]; // NOLINT
+}
+
+/// A VNC viewer, connected to the server over a socket pair.
+class RfbViewer {
+public:
+  explicit RfbViewer(RfbServer& server) : server(server) {
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    sock = unistdpp::FD(fds[0]);
+    auto serverSock = unistdpp::FD(fds[1]);
+    REQUIRE(unistdpp::setNonBlocking(sock).has_value());
+    REQUIRE(unistdpp::setNonBlocking(serverSock).has_value());
+    server.addClient(std::move(serverSock));
+  }
+
+  void send(const std::vector<uint8_t>& msg) {
+    REQUIRE(sock.writeAll(msg.data(), msg.size()).has_value());
+  }
+
+  /// Lets the server handle the sent messages and send its updates.
+  /// \returns Everything received.
+  std::vector<uint8_t> receive() {
+    std::vector<uint8_t> result;
+    for (auto done = false; !done;) {
+      std::vector<pollfd> pollfds;
+      server.addPollFds(pollfds);
+      pollfds.at(1).revents = POLLIN | POLLOUT;
+      server.handlePoll(pollfds, 0);
+      server.sendUpdates();
+
+      done = true;
+      std::array<uint8_t, 4096> buffer{};
+      for (auto res = unistdpp::read(sock, buffer.data(), buffer.size());
+           res.has_value() && *res > 0;
+           res = unistdpp::read(sock, buffer.data(), buffer.size())) {
+        result.insert(result.end(), buffer.begin(), buffer.begin() + *res);
+        done = false;
+      }
+    }
+    return result;
+  }
+
+private:
+  RfbServer& server;
+  unistdpp::FD sock;
+};
+
+UpdateParams
+makeRegion(int x1, int y1, int x2, int y2) {
+  UpdateParams params{};
+  params.x1 = x1;
+  params.y1 = y1;
+  params.x2 = x2;
+  params.y2 = y2;
+  return params;
+}
+
+void
+fill(const SharedFB& fb, uint16_t color) {
+  std::fill_n(static_cast<uint16_t*>(fb.getFb()), fb_width * fb_height, color);
+}
+
+/// The overlay buffers the compositor opens, removed when done.
+struct OverlayBuffers {
+  OverlayBuffers() {
+    for (int id = 0; id < max_overlays; id++) {
+      auto fb = SharedFB::open(getOverlayName(id).c_str(), fb_size);
+      REQUIRE(fb.has_value());
+      buffers.emplace_back(std::move(*fb));
+    }
+  }
+  OverlayBuffers(const OverlayBuffers&) = delete;
+  OverlayBuffers& operator=(const OverlayBuffers&) = delete;
+
+  ~OverlayBuffers() {
+    for (int id = 0; id < max_overlays; id++) {
+      shm_unlink(getOverlayName(id).c_str());
+    }
+  }
+
+  std::vector<SharedFB> buffers;
+};
+
+uint16_t
+get16(const std::vector<uint8_t>& data, size_t offset) {
+  return (uint16_t(data.at(offset)) << 8) | data.at(offset + 1);
+}
+
+} // namespace
+
+TEST_CASE("StrokeRenderer", "[rm2fb]") {
+  auto fb = makeSharedFB();
+
+  StrokeRenderer renderer;
+  renderer.begin(StrokeBegin{ .minWidth = 4, .maxWidth = 4, .color = 0 });
+
+  StrokePoints points;
+
+  SECTION("Segment") {
+    points.add({ .x = 100, .y = 100 });
+    points.add({ .x = 200, .y = 100 });
+
+    auto update = renderer.addPoints(fb, points);
+    REQUIRE(update.has_value());
+    CHECK(update->x1 == 98);
+    CHECK(update->y1 == 98);
+    CHECK(update->x2 == 202);
+    CHECK(update->y2 == 102);
+
+    CHECK(pixelAt(fb, 100, 100) == 0);
+    CHECK(pixelAt(fb, 150, 101) == 0);
+    CHECK(pixelAt(fb, 200, 100) == 0);
+    CHECK(pixelAt(fb, 150, 110) == UINT16_MAX);
+    CHECK(pixelAt(fb, 210, 100) == UINT16_MAX);
+
+    update = renderer.end(fb, StrokeEnd{ StrokeEnd::Cancel });
+    REQUIRE(update.has_value());
+    CHECK(pixelAt(fb, 150, 101) == UINT16_MAX);
+  }
+
+  SECTION("Out of range") {
+    // Crosses the whole framebuffer, only that part is drawn.
+    points.add({ .x = INT32_MIN, .y = 500 });
+    points.add({ .x = INT32_MAX, .y = 500 });
+    // Entirely outside of the framebuffer.
+    points.add({ .x = INT32_MAX, .y = INT32_MIN });
+    points.add({ .x = INT32_MIN, .y = INT32_MIN });
+
+    const auto update = renderer.addPoints(fb, points);
+    REQUIRE(update.has_value());
+    CHECK(update->x1 == 0);
+    CHECK(update->y1 == 498);
+    CHECK(update->x2 == fb_width - 1);
+    CHECK(update->y2 == 502);
+
+    CHECK(pixelAt(fb, 0, 500) == 0);
+    CHECK(pixelAt(fb, fb_width / 2, 500) == 0);
+    CHECK(pixelAt(fb, fb_width - 1, 500) == 0);
+    CHECK(pixelAt(fb, fb_width / 2, 0) == UINT16_MAX);
+  }
+
+  SECTION("Oversized widths") {
+    renderer.begin(StrokeBegin{ .minWidth = 0, .maxWidth = UINT16_MAX });
+
+    points.add({ .x = 700, .y = 900, .pressure = 4095 });
+    auto update = renderer.addPoints(fb, points);
+    REQUIRE(update.has_value());
+    constexpr auto radius = StrokeRenderer::max_width / 2;
+    CHECK(update->x1 == 700 - radius);
+    CHECK(update->y1 == 900 - radius);
+    CHECK(update->x2 == 700 + radius);
+    CHECK(update->y2 == 900 + radius);
+
+    // Alternating between the narrowest and widest discs across the
+    // framebuffer, which has to finish quickly.
+    points = {};
+    for (int i = 0; points.count < StrokePoints::max_samples; i++) {
+      points.add({ .x = i % 2 == 0 ? 0 : fb_width - 1,
+                   .y = i % 2 == 0 ? 0 : fb_height - 1,
+                   .pressure = uint16_t(i % 2 == 0 ? 0 : 4095) });
+    }
+    update = renderer.addPoints(fb, points);
+    REQUIRE(update.has_value());
+    CHECK(pixelAt(fb, fb_width / 2, fb_height / 2) == 0);
+  }
+}
+
+TEST_CASE("RfbServer", "[rm2fb]") {
+  auto fb = makeSharedFB();
+  std::vector<uint16_t> scanout(fb_width * fb_height, UINT16_MAX);
+  scanout[2 * fb_width + 1] = 0;
+  const auto compositor = Compositor(fb, scanout.data());
+  const auto devices = AllUinputDevices{};
+
+  auto server = RfbServer(unistdpp::FD(), compositor, devices);
+  auto viewer = RfbViewer(server);
+
+  const auto version = std::string_view("RFB 003.008\n");
+  REQUIRE(viewer.receive() ==
+          std::vector<uint8_t>(version.begin(), version.end()));
+  viewer.send(std::vector<uint8_t>(version.begin(), version.end()));
+  REQUIRE(viewer.receive() == std::vector<uint8_t>{ 1, 1 });
+  viewer.send({ 1 });
+  REQUIRE(viewer.receive() == std::vector<uint8_t>{ 0, 0, 0, 0 });
+  viewer.send({ 1 });
+  const auto init = viewer.receive();
+  REQUIRE(init.size() == 34);
+  REQUIRE(get16(init, 0) == fb_width);
+  REQUIRE(get16(init, 2) == fb_height);
+
+  const auto hextile = GENERATE(false, true);
+  viewer.send({ 2, 0, 0, 1, 0, 0, 0, uint8_t(hextile ? 5 : 0) });
+
+  // Request all of the 1404x1872 screen.
+  viewer.send({ 3, 0, 0, 0, 0, 0, 0x05, 0x7c, 0x07, 0x50 });
+  const auto update = viewer.receive();
+  REQUIRE(update.size() > 4);
+  REQUIRE(update[0] == 0);
+
+  // The update is split over multiple requests.
+  const auto numRects = get16(update, 2);
+  REQUIRE(numRects > 0);
+  REQUIRE(numRects < (fb_width / 64) * (fb_height / 64));
+
+  // The first rect is the top left tile.
+  REQUIRE(get16(update, 4) == 0);
+  REQUIRE(get16(update, 6) == 0);
+  REQUIRE(get16(update, 8) == 64);
+  REQUIRE(get16(update, 10) == 64);
+  const auto encoding = std::vector(update.begin() + 12, update.begin() + 16);
+  const auto data = std::vector(update.begin() + 16, update.end());
+
+  if (!hextile) {
+    REQUIRE(encoding == std::vector<uint8_t>{ 0, 0, 0, 0 });
+    // Little endian RGB565, white except for the black pixel at 1, 2.
+    auto expected = std::vector<uint8_t>(64 * 64 * 2, 0xff);
+    expected[(2 * 64 + 1) * 2] = 0;
+    expected[(2 * 64 + 1) * 2 + 1] = 0;
+    REQUIRE(data.size() >= expected.size());
+    REQUIRE(std::vector(data.begin(), data.begin() + expected.size()) ==
+            expected);
+  } else {
+    REQUIRE(encoding == std::vector<uint8_t>{ 0, 0, 0, 5 });
+
+    // White background and a black subrect at 1, 2.
+    const auto expected = std::vector<uint8_t>{
+      2 | 4 | 8, 0xff, 0xff, 0, 0, 1, 0x12, 0x00,
+    };
+    REQUIRE(std::vector(data.begin(), data.begin() + 8) == expected);
+    // The other 15 tiles are white as well.
+    for (int i = 0; i < 15; i++) {
+      REQUIRE(data.at(8 + i) == 0);
+    }
+    // Followed by the next tile.
+    REQUIRE(get16(data, 23) == 64);
+    REQUIRE(get16(data, 25) == 0);
+  }
+
+  // Request the rest of the screen, until there are no more changes.
+  auto totalRects = int(numRects);
+  for (int i = 0; i < 1000; i++) {
+    viewer.send({ 3, 1, 0, 0, 0, 0, 0x05, 0x7c, 0x07, 0x50 });
+    const auto next = viewer.receive();
+    if (next.empty()) {
+      break;
+    }
+    totalRects += get16(next, 2);
+  }
+  const auto tilesX = (fb_width + 63) / 64;
+  const auto tilesY = (fb_height + 63) / 64;
+  REQUIRE(totalRects == tilesX * tilesY);
+}
+
+TEST_CASE("Compositor", "[rm2fb]") {
+  constexpr uint16_t fb_color = 0x1111;
+  constexpr uint16_t overlay0_color = 0x2222;
+  constexpr uint16_t overlay1_color = 0x3333;
+
+  auto fb = makeSharedFB();
+  fill(fb, fb_color);
+  OverlayBuffers overlays;
+  fill(overlays.buffers[0], overlay0_color);
+  fill(overlays.buffers[1], overlay1_color);
+
+  std::vector<uint16_t> scanout(fb_width * fb_height, 0);
+  Compositor compositor(fb, scanout.data());
+  const auto scanoutAt = [&scanout](int x, int y) {
+    return scanout.at(y * fb_width + x);
+  };
+  const auto screen = makeRegion(0, 0, fb_width - 1, fb_height - 1);
+  const auto composeAll = [&] { compositor.compose(screen); };
+
+  constexpr int owner = 7;
+  auto config0 = OverlaySet{
+    .id = 0, .z = 1, .x1 = 100, .y1 = 100, .x2 = 299, .y2 = 299
+  };
+  auto config1 = OverlaySet{
+    .id = 1, .z = 0, .x1 = 200, .y1 = 200, .x2 = 399, .y2 = 399
+  };
+
+  SECTION("Hidden") {
+    REQUIRE(!compositor.setOverlay(config0, owner).has_value());
+    const auto update = OverlayUpdate{ .id = 0, .params = screen };
+    REQUIRE(!compositor.updateOverlay(update).has_value());
+    composeAll();
+    REQUIRE(scanoutAt(150, 150) == fb_color);
+  }
+
+  SECTION("Visible") {
+    config0.visible = true;
+    const auto update = compositor.setOverlay(config0, owner);
+    REQUIRE(update.has_value());
+    REQUIRE(update->x1 == 100);
+    REQUIRE(update->y1 == 100);
+    REQUIRE(update->x2 == 299);
+    REQUIRE(update->y2 == 299);
+
+    // Updates are clipped to the visible part.
+    const auto overlayUpdate = compositor.updateOverlay(
+      OverlayUpdate{ .id = 0, .params = makeRegion(250, 250, 350, 350) });
+    REQUIRE(overlayUpdate.has_value());
+    REQUIRE(overlayUpdate->x2 == 299);
+    REQUIRE(overlayUpdate->y2 == 299);
+
+    composeAll();
+    REQUIRE(scanoutAt(99, 100) == fb_color);
+    REQUIRE(scanoutAt(100, 100) == overlay0_color);
+    REQUIRE(scanoutAt(299, 299) == overlay0_color);
+    REQUIRE(scanoutAt(300, 299) == fb_color);
+
+    // Hiding it updates the same region, which shows the framebuffer again.
+    config0.visible = false;
+    const auto hideUpdate = compositor.setOverlay(config0, owner);
+    REQUIRE(hideUpdate.has_value());
+    REQUIRE(hideUpdate->x1 == 100);
+    REQUIRE(hideUpdate->x2 == 299);
+    compositor.compose(*hideUpdate);
+    REQUIRE(scanoutAt(150, 150) == fb_color);
+  }
+
+  SECTION("Z order") {
+    config0.visible = true;
+    config1.visible = true;
+    REQUIRE(compositor.setOverlay(config0, owner).has_value());
+    REQUIRE(compositor.setOverlay(config1, owner).has_value());
+
+    composeAll();
+    REQUIRE(scanoutAt(150, 150) == overlay0_color);
+    REQUIRE(scanoutAt(250, 250) == overlay0_color);
+    REQUIRE(scanoutAt(350, 350) == overlay1_color);
+
+    config1.z = 2;
+    REQUIRE(compositor.setOverlay(config1, owner).has_value());
+    composeAll();
+    REQUIRE(scanoutAt(150, 150) == overlay0_color);
+    REQUIRE(scanoutAt(250, 250) == overlay1_color);
+  }
+
+  SECTION("Remove owner") {
+    config0.visible = true;
+    config1.visible = true;
+    REQUIRE(compositor.setOverlay(config0, owner).has_value());
+    REQUIRE(compositor.setOverlay(config1, owner + 1).has_value());
+
+    const auto updates = compositor.removeOwner(owner);
+    REQUIRE(updates.size() == 1);
+    REQUIRE(updates.front().x1 == 100);
+
+    composeAll();
+    REQUIRE(scanoutAt(150, 150) == fb_color);
+    REQUIRE(scanoutAt(250, 250) == overlay1_color);
+  }
+
+  SECTION("Invalid") {
+    config0.id = max_overlays;
+    config0.visible = true;
+    REQUIRE(!compositor.setOverlay(config0, owner).has_value());
+  }
+}
+
+TEST_CASE("InputBatch", "[rm2fb]") {
+  std::array<int, 2> fds{};
+  REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+  const auto writer = unistdpp::FD(fds[0]);
+  const auto readerFd = unistdpp::FD(fds[1]);
+
+  InputBatch batch;
+  REQUIRE(batch.add(InputSample{ .x = 10,
+                                 .y = 20,
+                                 .timestamp = 1000,
+                                 .pressure = 4095,
+                                 .type = Input::Down }));
+  REQUIRE(batch.add(InputSample{
+    .x = 11, .y = 21, .timestamp = 2000, .pressure = 2000 }));
+  REQUIRE(batch.add(InputSample{ .x = 300,
+                                 .y = 400,
+                                 .timestamp = 3000,
+                                 .type = Input::Up,
+                                 .touch = 1 }));
+
+  const auto checkBatch = [&batch](const ClientMsg& msg) {
+    REQUIRE(std::holds_alternative<InputBatch>(msg));
+    const auto& received = std::get<InputBatch>(msg);
+    REQUIRE(received.count == batch.count);
+    for (uint32_t i = 0; i < batch.count; i++) {
+      const auto& a = received.samples.at(i);
+      const auto& b = batch.samples.at(i);
+      REQUIRE(a.x == b.x);
+      REQUIRE(a.y == b.y);
+      REQUIRE(a.timestamp == b.timestamp);
+      REQUIRE(a.pressure == b.pressure);
+      REQUIRE(a.type == b.type);
+      REQUIRE(a.touch == b.touch);
+    }
+  };
+
+  SECTION("Only the used samples are sent") {
+    REQUIRE(sendMessage(writer, ClientMsg(batch)).has_value());
+
+    std::array<uint8_t, sizeof(ClientMsg)> buffer{};
+    const auto size = unistdpp::read(readerFd, buffer.data(), buffer.size());
+    REQUIRE(size.has_value());
+    REQUIRE(*size == 2 * sizeof(uint32_t) + 3 * sizeof(InputSample));
+  }
+
+  SECTION("Read") {
+    REQUIRE(sendMessage(writer, ClientMsg(batch)).has_value());
+    auto msg = recvMessage<ClientMsg>(readerFd);
+    REQUIRE(msg.has_value());
+    checkBatch(*msg);
+  }
+
+  SECTION("Buffered read") {
+    // Both messages are read with one syscall.
+    REQUIRE(sendMessage(writer, ClientMsg(batch)).has_value());
+    REQUIRE(sendMessage(writer, ClientMsg(batch)).has_value());
+    auto reader = unistdpp::BufferedReader(readerFd);
+    auto first = recvMessage<ClientMsg>(reader);
+    REQUIRE(first.has_value());
+    checkBatch(*first);
+    REQUIRE(reader.buffered() > 0);
+    auto second = recvMessage<ClientMsg>(reader);
+    REQUIRE(second.has_value());
+    checkBatch(*second);
+    REQUIRE(reader.buffered() == 0);
+  }
+
+  SECTION("Too many samples") {
+    const auto index = int32_t(ClientMsg(InputBatch{}).index());
+    REQUIRE(writer.writeAll(index).has_value());
+    REQUIRE(writer.writeAll(InputBatch::max_samples + 1).has_value());
+    auto msg = recvMessage<ClientMsg>(readerFd);
+    REQUIRE(!msg.has_value());
+    REQUIRE(msg.error() == std::errc::bad_message);
+  }
+}
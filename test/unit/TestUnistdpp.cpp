@@ -6,9 +6,11 @@
 #include <unistdpp/file.h>
 #include <unistdpp/pipe.h>
 #include <unistdpp/poll.h>
+#include <unistdpp/reader.h>
 #include <unistdpp/socket.h>
 #include <unistdpp/unistdpp.h>
 
+#include <array>
 #include <iostream>
 
 using namespace unistdpp;
@@ -118,6 +120,42 @@ TEST_CASE("pipe", "[unistdpp]") {
   REQUIRE(res->b == 1.2f);
 }
 
+TEST_CASE("BufferedReader", "[unistdpp]") {
+  auto pipe = unistdpp::pipe();
+  REQUIRE(pipe.has_value());
+
+  auto [readFd, writeFd] = std::move(*pipe);
+  unistdpp::BufferedReader reader(readFd, 16);
+
+  for (int i = 0; i < 3; i++) {
+    REQUIRE(writeFd.writeAll(i).has_value());
+  }
+
+  // A single read buffers all available data.
+  auto first = reader.readAll<int>();
+  REQUIRE(first.has_value());
+  REQUIRE(*first == 0);
+  REQUIRE(reader.buffered() == 2 * sizeof(int));
+
+  REQUIRE(*reader.readAll<int>() == 1);
+  REQUIRE(*reader.readAll<int>() == 2);
+  REQUIRE(reader.buffered() == 0);
+
+  // Large reads bypass the buffer.
+  std::array<char, 32> data{};
+  data.fill('a');
+  REQUIRE(writeFd.writeAll(data.data(), data.size()).has_value());
+  std::array<char, 32> result{};
+  REQUIRE(reader.readAll(result.data(), result.size()) == int(data.size()));
+  REQUIRE(result == data);
+  REQUIRE(reader.buffered() == 0);
+
+  writeFd.close();
+  auto eof = reader.readAll<int>();
+  REQUIRE_FALSE(eof.has_value());
+  REQUIRE(eof.error() == unistdpp::FD::eof_error);
+}
+
 TEST_CASE("poll", "[unistdpp]") {
   auto pipe1 = unistdpp::pipe();
   auto pipe2 = unistdpp::pipe();
@@ -110,8 +110,8 @@ struct TestContext : rmlib::AppContext {
     result.emplace_back(
       FindResult<>{ obj, [obj]() { return obj->getCleanupRect(); } });
 
-    for (auto* child : obj->getChildren()) {
-      auto childNodes = getAllNodes(child);
+    obj->visitChildren([&](rmlib::RenderObject& child) {
+      auto childNodes = getAllNodes(&child);
       std::transform(
         childNodes.begin(),
         childNodes.end(),
@@ -122,7 +122,7 @@ struct TestContext : rmlib::AppContext {
                               } };
         });
       // result.insert(result.end(), childNodes.begin(), childNodes.end());
-    }
+    });
     return result;
   }
 
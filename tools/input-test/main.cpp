@@ -1,9 +1,18 @@
 #include <Device.h>
 #include <Input.h>
 
+#include <unistdpp/file.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <libudev.h>
+#include <linux/input.h>
 
 using namespace rmlib;
 using namespace rmlib::input;
@@ -147,8 +156,173 @@ printEvent(const KeyEvent& ev) {
   std::cout << ev.keyCode << std::endl;
 }
 
+/// Writes the raw events of the device to the file, until interrupted.
+int
+record(const char* devicePath, const char* outPath) {
+  auto device = unistdpp::open(devicePath, O_RDONLY);
+  if (!device.has_value()) {
+    std::cerr << "Opening " << devicePath << ": "
+              << unistdpp::to_string(device.error()) << "\n";
+    return -1;
+  }
+
+  std::ofstream out(outPath, std::ios::binary);
+  if (!out.is_open()) {
+    std::cerr << "Opening " << outPath << " failed\n";
+    return -1;
+  }
+
+  std::array<input_event, 64> buffer{};
+  size_t total = 0;
+  while (true) {
+    auto size = unistdpp::read(*device, buffer.data(), sizeof(buffer));
+    if (!size.has_value()) {
+      std::cerr << "Reading: " << unistdpp::to_string(size.error()) << "\n";
+      return -1;
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), *size);
+    out.flush();
+
+    total += *size / sizeof(input_event);
+    std::cout << "\rRecorded " << total << " events" << std::flush;
+  }
+}
+
+/// Decodes a recording of the device, as made by `record`.
+int
+bench(const char* devicePath, const char* tracePath) {
+  auto trace = unistdpp::readFile(tracePath);
+  if (!trace.has_value()) {
+    std::cerr << "Reading " << tracePath << ": "
+              << unistdpp::to_string(trace.error()) << "\n";
+    return -1;
+  }
+  std::vector<input_event> events(trace->size() / sizeof(input_event));
+  memcpy(events.data(), trace->data(), events.size() * sizeof(input_event));
+
+  InputManager input;
+  auto device = input.open(devicePath);
+  if (!device.has_value()) {
+    std::cerr << device.error().msg << "\n";
+    return -1;
+  }
+
+  // Decode in batches like reads from the device would.
+  constexpr auto batch_size = 64;
+  constexpr auto iterations = 100;
+
+  EventRing ring;
+  size_t decoded = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    for (size_t offset = 0; offset < events.size(); offset += batch_size) {
+      const auto count = std::min<size_t>(batch_size, events.size() - offset);
+      (*device)->decode(&events[offset], count, ring);
+      while (!ring.empty()) {
+        ring.pop();
+        decoded++;
+      }
+    }
+  }
+  const auto time = std::chrono::steady_clock::now() - start;
+
+  const auto ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+  const auto rawEvents = events.size() * iterations;
+  std::cout << rawEvents << " raw events to " << decoded << " events in "
+            << ns / 1000000 << " ms, " << ns / std::max<size_t>(1, rawEvents)
+            << " ns per raw event\n";
+  return 0;
+}
+
+/// Prints the events of recordings made with `RM2STUFF_INPUT_RECORD`.
+int
+replay(const char* dir, ReplaySpeed speed) {
+  InputManager input;
+  if (auto err = input.openReplay(dir, speed); !err.has_value()) {
+    std::cerr << err.error().msg << std::endl;
+    return -1;
+  }
+
+  while (input.isReplaying()) {
+    auto events = input.waitForInput(std::nullopt);
+    if (!events.has_value()) {
+      std::cerr << "Reading input error: " << events.error().msg << "\n";
+      return -1;
+    }
+
+    for (auto& event : *events) {
+      std::visit([](auto& e) { printEvent(e); }, event);
+    }
+  }
+  return 0;
+}
+
+/// Reads all devices on the input thread, while pretending to render slow
+/// frames, and reports the queue depth and latency every second.
 int
-main() {
+thread(std::chrono::milliseconds frameTime) {
+  InputManager input;
+  if (auto err = input.openAll(); !err.has_value()) {
+    std::cerr << err.error().msg << std::endl;
+    return -1;
+  }
+  if (auto err = input.startThread(); !err.has_value()) {
+    std::cerr << err.error().msg << std::endl;
+    return -1;
+  }
+
+  std::vector<pollfd> extraFds;
+  EventRing events;
+  auto lastReport = std::chrono::steady_clock::now();
+  while (true) {
+    auto err = input.waitForInput(events, extraFds, std::chrono::seconds(1));
+    if (!err.has_value()) {
+      std::cerr << "Reading input error: " << err.error().msg << "\n";
+      continue;
+    }
+    events.clear();
+    std::this_thread::sleep_for(frameTime);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastReport < std::chrono::seconds(1)) {
+      continue;
+    }
+    lastReport = now;
+
+    const auto& stats = input.getStats();
+    std::cout << stats.events << " events, max queue depth "
+              << stats.maxQueueDepth << ", dropped " << stats.dropped
+              << ", latency avg " << stats.averageLatency().count()
+              << " us max " << stats.maxLatency.count() << " us\n";
+    input.resetStats();
+  }
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc == 4 && std::string_view(argv[1]) == "record") {
+    return record(argv[2], argv[3]);
+  }
+  if (argc == 4 && std::string_view(argv[1]) == "bench") {
+    return bench(argv[2], argv[3]);
+  }
+  if ((argc == 3 || argc == 4) && std::string_view(argv[1]) == "replay") {
+    return replay(argv[2],
+                  argc == 4 && std::string_view(argv[3]) == "realtime"
+                    ? ReplaySpeed::RealTime
+                    : ReplaySpeed::Fast);
+  }
+  if (argc == 3 && std::string_view(argv[1]) == "thread") {
+    return thread(std::chrono::milliseconds(std::atoi(argv[2])));
+  }
+  if (argc != 1) {
+    std::cerr << "Usage: " << argv[0]
+              << " [record|bench <device> <file>] [thread <frame-ms>]"
+                 " [replay <dir> [realtime]]\n";
+    return -1;
+  }
+
   struct udev* udev = udev_new();
   if (!udev) {
     fprintf(stderr, "udev_new() failed\n");
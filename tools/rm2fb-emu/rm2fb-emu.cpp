@@ -41,7 +41,7 @@ getType(const PenEvent& touchEv) {
 }
 
 struct UpdateMsg {
-  rmlib::UpdateRegion updateRegion;
+  rmlib::UpdateRect updateRegion;
   rmlib::MemoryCanvas memCanvas;
 };
 
@@ -59,9 +59,9 @@ readUpdate(const FD& sock) {
 
   TRY(sock.readAll(memCanvas.memory.get(), memCanvas.canvas.totalSize()));
 
-  return UpdateMsg{ rmlib::UpdateRegion(region,
-                                        (rmlib::fb::Waveform)msg.waveform,
-                                        (rmlib::fb::UpdateFlags)msg.flags),
+  return UpdateMsg{ rmlib::UpdateRect{ region,
+                                       (rmlib::fb::Waveform)msg.waveform,
+                                       (rmlib::fb::UpdateFlags)msg.flags },
                     std::move(memCanvas) };
 }
 
@@ -112,6 +112,76 @@ doPen(unistdpp::FD& sock, std::vector<std::string_view> args) {
   return doInput(sock, atoi(args[0].data()), atoi(args[1].data()), false);
 }
 
+bool
+doStroke(unistdpp::FD& sock, std::vector<std::string_view> args) {
+  if (args.size() != 4) {
+    std::cerr << "Stroke requires 4 args, x1 y1 x2 y2\n";
+    return false;
+  }
+
+  const auto x1 = atoi(args[0].data());
+  const auto y1 = atoi(args[1].data());
+  const auto x2 = atoi(args[2].data());
+  const auto y2 = atoi(args[3].data());
+
+  // Send the whole stroke as a single batch, with a sample every 2ms.
+  constexpr auto sample_time = 2000; // us
+  constexpr auto steps = int(InputBatch::max_samples) - 1;
+
+  InputBatch batch;
+  for (int i = 0; i <= steps; i++) {
+    const auto type = i == 0 ? Input::Down
+                      : i == steps ? Input::Up
+                                   : Input::Move;
+    batch.add(InputSample{
+      .x = x1 + (x2 - x1) * i / steps,
+      .y = y1 + (y2 - y1) * i / steps,
+      .timestamp = uint32_t(i * sample_time),
+      .pressure = 2048,
+      .type = uint8_t(type),
+      .touch = 0,
+    });
+  }
+
+  fatalOnError(sendMessage(sock, ClientMsg(batch)));
+  usleep(tap_wait);
+
+  return true;
+}
+
+bool
+doInk(unistdpp::FD& sock, std::vector<std::string_view> args) {
+  if (args.size() != 4 && args.size() != 5) {
+    std::cerr << "Ink requires 4 args, x1 y1 x2 y2, and optionally 'cancel'\n";
+    return false;
+  }
+
+  const auto x1 = atoi(args[0].data());
+  const auto y1 = atoi(args[1].data());
+  const auto x2 = atoi(args[2].data());
+  const auto y2 = atoi(args[3].data());
+  const bool cancel = args.size() == 5 && args[4] == "cancel";
+
+  fatalOnError(sendMessage(sock, ClientMsg(StrokeBegin{})));
+
+  constexpr auto steps = int(StrokePoints::max_samples) - 1;
+  StrokePoints points;
+  for (int i = 0; i <= steps; i++) {
+    points.add(StrokePoint{
+      .x = x1 + (x2 - x1) * i / steps,
+      .y = y1 + (y2 - y1) * i / steps,
+      .pressure = uint16_t(4095 * i / steps),
+    });
+  }
+  fatalOnError(sendMessage(sock, ClientMsg(points)));
+
+  const auto action = cancel ? StrokeEnd::Cancel : StrokeEnd::Commit;
+  fatalOnError(sendMessage(sock, ClientMsg(StrokeEnd{ .action = action })));
+  usleep(tap_wait);
+
+  return true;
+}
+
 bool
 doPower(unistdpp::FD& sock, std::vector<std::string_view> args) {
   auto input = PowerButton{ .down = true };
@@ -133,6 +203,8 @@ const std::unordered_map<std::string_view, decltype(&doScreenshot)> actions = {
     { "pen", doPen },
     { "power", doPower },
     { "move", doMovePen },
+    { "stroke", doStroke },
+    { "ink", doInk },
   }
 };
 } // namespace
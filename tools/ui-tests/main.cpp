@@ -9,6 +9,7 @@
 #include <Canvas.h>
 #include <FrameBuffer.h>
 #include <Input.h>
+#include <StrokeRasterizer.h>
 
 #include <UI.h>
 #include <UI/Navigator.h>
@@ -232,35 +233,23 @@ protected:
   }
 
   rmlib::UpdateRegion doDraw(rmlib::Canvas& canvas) final {
-    if (points.size() < 2) {
-      return {};
-    }
-
-    UpdateRegion result;
-    result.waveform = rmlib::fb::Waveform::DU;
-    result.flags = fb::UpdateFlags::Priority;
-
-    auto lastPoint = points.front();
-    result.region |= Rect{ lastPoint, lastPoint };
+    auto region = Rect{};
     for (const auto& point : points) {
-      if (point == lastPoint) {
-        continue;
-      }
-
-      canvas.drawLine(lastPoint, point, black, thickness);
-      canvas.drawDisk(point, thickness, black);
-
-      lastPoint = point;
-      result.region |= Rect{ lastPoint, lastPoint };
+      region |= stroke.addPoint(
+        canvas, { float(point.x), float(point.y), float(2 * thickness) });
     }
-
     points.clear();
-    if (down) {
-      points.push_back(lastPoint);
+
+    if (!down) {
+      stroke.end();
     }
 
-    result.region = Insets::all(-thickness).shrink(result.region);
-    return result;
+    if (region.empty()) {
+      return {};
+    }
+    return UpdateRegion{ region,
+                         rmlib::fb::Waveform::DU,
+                         fb::UpdateFlags::Priority };
   }
 
   void doHandleInput(const rmlib::input::Event& ev) final {
@@ -285,13 +274,14 @@ protected:
 
     if (penEv.isUp()) {
       down = false;
-      points.clear();
+      markNeedsDraw(false);
     }
   }
 
 private:
   bool down = false;
   std::vector<Point> points;
+  StrokeRasterizer stroke;
 };
 
 std::unique_ptr<rmlib::RenderObject>